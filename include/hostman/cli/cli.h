@@ -18,7 +18,11 @@ typedef enum
     CMD_IMPORT_HOST,
     CMD_HELP,
     CMD_LIST_PRESETS,
-    CMD_ADD_PRESET
+    CMD_ADD_PRESET,
+    CMD_STATS,
+    CMD_DAEMON,
+    CMD_WATCH,
+    CMD_FLUSH
 } command_type_t;
 
 typedef enum
@@ -37,21 +41,40 @@ typedef struct
     char **file_paths;
     int file_count;
     char *directory;
+    bool recursive;
+    char *files_from;
+    bool null_separated;
+    int resume_batch;
+    char **include_patterns;
+    int include_count;
+    char **exclude_patterns;
+    int exclude_count;
+    int debounce_ms;
     bool continue_on_error;
     bool no_clipboard;
     bool insecure;
     bool from_clipboard;
+    bool from_stdin;
+    bool dedupe;
+    bool queue_on_failure;
+    bool flush_all;
+    char *stdin_name;
     char *clipboard_temp_file;
-    int throttle_ms;
+    int jobs;
+    long long limit_rate;
     int page;
     int limit;
+    int before_id;
+    long long before_timestamp;
+    bool latency;
     bool config_get;
     char *config_key;
     char *config_value;
     char *command_name;
     char *import_file;
     char *preset_name;
-    int upload_id;
+    int *upload_ids;
+    int upload_id_count;
     output_mode_t output_mode;
 } command_args_t;
 
@@ -64,6 +87,18 @@ run_setup_wizard(void);
 void
 free_command_args(command_args_t *args);
 void
+cli_set_resident(bool resident);
+void
+cli_request_interrupt(void);
+void
 print_command_help(const char *command);
+void
+print_section_header(const char *text);
+void
+print_success(const char *format, ...);
+void
+print_error(const char *format, ...);
+void
+print_info(const char *format, ...);
 
 #endif
@@ -0,0 +1,16 @@
+#ifndef HOSTMAN_DAEMON_H
+#define HOSTMAN_DAEMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool
+daemon_socket_path(char *buffer, size_t size);
+bool
+daemon_can_forward(int argc, char *argv[]);
+bool
+daemon_forward(int argc, char *argv[], int *exit_code);
+int
+daemon_run(void);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HOSTMAN_WATCH_H
+#define HOSTMAN_WATCH_H
+
+#include "hostman/cli/cli.h"
+#include "hostman/core/config.h"
+#include <stdbool.h>
+
+#define WATCH_DEFAULT_DEBOUNCE_MS 500
+
+bool
+watch_directory(const command_args_t *args, hostman_config_t *config, host_config_t *host);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef HOSTMAN_CONFIG_H
 #define HOSTMAN_CONFIG_H
 
+#include "hostman/core/jsonpath.h"
 #include <stdbool.h>
 
 typedef struct
@@ -11,9 +12,18 @@ typedef struct
     char *api_key_name;
     char *api_key;
     char *request_body_format;
+    char *request_method;
+    char *upload_source;
+    char *limit_rate;
+    char *max_response_size;
+    char *chunk_size;
+    char *region;
+    int part_concurrency;
     char *file_form_field;
     char *response_url_json_path;
     char *response_deletion_url_json_path;
+    json_path_t response_url_path;
+    json_path_t response_deletion_url_path;
     char **static_field_names;
     char **static_field_values;
     int static_field_count;
@@ -27,6 +37,8 @@ typedef struct
     char *log_file;
     bool copy_to_clipboard;
     char *clipboard_manager;
+    char *db_mmap_size;
+    char *db_cache_size;
     host_config_t **hosts;
     int host_count;
 } hostman_config_t;
@@ -53,6 +65,12 @@ config_get_default_host(void);
 host_config_t *
 config_get_host(const char *host_name);
 void
+config_compile_host_paths(host_config_t *host);
+void
+config_set_resident(bool resident);
+bool
+config_reload_if_changed(void);
+void
 config_free(hostman_config_t *config);
 
 #endif
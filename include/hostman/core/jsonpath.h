@@ -0,0 +1,45 @@
+#ifndef HOSTMAN_JSONPATH_H
+#define HOSTMAN_JSONPATH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JSON_PATH_MAX_LENGTH 256
+#define JSON_PATH_MAX_SEGMENTS 16
+#define JSON_PATH_MAX_MATCHES 32
+
+/* A dotted path such as "data.files[0].url", tokenized once so lookups only compare bytes */
+typedef struct
+{
+    unsigned short offset;
+    unsigned short length;
+    int index;
+} json_path_segment_t;
+
+typedef struct
+{
+    bool valid;
+    char expression[JSON_PATH_MAX_LENGTH];
+    json_path_segment_t segments[JSON_PATH_MAX_SEGMENTS];
+    int segment_count;
+} json_path_t;
+
+/* value points at the raw, still-escaped string contents inside the scanned document */
+typedef struct
+{
+    const json_path_t *path;
+    const char *value;
+    size_t length;
+    bool found;
+} json_path_match_t;
+
+bool
+json_path_compile(json_path_t *path, const char *expression);
+bool
+json_path_is_compiled_from(const json_path_t *path, const char *expression);
+bool
+json_path_extract(const char *json, size_t length, json_path_match_t *matches, int count);
+char *
+json_path_match_dup(const json_path_match_t *match);
+
+#endif
@@ -14,6 +14,8 @@ char *
 get_filename_from_path(const char *path);
 void
 format_file_size(size_t size, char *buffer, size_t buffer_size);
+bool
+parse_byte_size(const char *text, long long *bytes);
 char *
 get_config_dir(void);
 char *
@@ -0,0 +1,49 @@
+#ifndef HOSTMAN_WALK_H
+#define HOSTMAN_WALK_H
+
+#include "hostman/crypto/hash.h"
+#include <stdbool.h>
+
+#define DIR_WALK_THREADS 4
+#define DIR_WALK_QUEUE_SIZE 1024
+
+typedef struct
+{
+    bool recursive;
+    /* Hash each file on the walker threads so the consumer never blocks on file contents */
+    bool hash_contents;
+    int threads;
+    char **include_patterns;
+    int include_count;
+    char **exclude_patterns;
+    int exclude_count;
+} dir_walk_options_t;
+
+typedef struct
+{
+    char *path;
+    bool hashed;
+    char content_hash[CONTENT_HASH_HEX_LEN + 1];
+} dir_walk_entry_t;
+
+typedef struct dir_walk dir_walk_t;
+
+bool
+walk_name_matches(const char *name,
+                  char **include_patterns,
+                  int include_count,
+                  char **exclude_patterns,
+                  int exclude_count);
+
+dir_walk_t *
+dir_walk_start(const char *root, const dir_walk_options_t *options);
+dir_walk_t *
+dir_walk_list(int fd, char delimiter, const dir_walk_options_t *options);
+int
+dir_walk_list_error(dir_walk_t *walk);
+bool
+dir_walk_next(dir_walk_t *walk, dir_walk_entry_t *entry);
+void
+dir_walk_free(dir_walk_t *walk);
+
+#endif
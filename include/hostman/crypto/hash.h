@@ -0,0 +1,25 @@
+#ifndef HOSTMAN_HASH_H
+#define HOSTMAN_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CONTENT_HASH_HEX_LEN 64
+
+typedef struct content_hash content_hash_t;
+
+content_hash_t *
+content_hash_create(void);
+bool
+content_hash_update(content_hash_t *hash, const void *data, size_t size);
+bool
+content_hash_reset(content_hash_t *hash);
+bool
+content_hash_final(content_hash_t *hash, char *hex_out);
+void
+content_hash_free(content_hash_t *hash);
+
+bool
+content_hash_file(const char *path, char *hex_out);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HOSTMAN_BODY_H
+#define HOSTMAN_BODY_H
+
+#include "hostman/core/config.h"
+#include "hostman/network/source.h"
+#include <curl/curl.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    REQUEST_BODY_MULTIPART,
+    REQUEST_BODY_BINARY,
+    REQUEST_BODY_JSON,
+    REQUEST_BODY_TUS,
+    REQUEST_BODY_S3,
+    REQUEST_BODY_UNKNOWN
+} request_body_format_t;
+
+typedef struct upload_body upload_body_t;
+
+request_body_format_t
+request_body_format_from_string(const char *format);
+
+upload_body_t *
+upload_body_create(request_body_format_t format, host_config_t *host, upload_source_t *source);
+curl_off_t
+upload_body_size(const upload_body_t *body);
+bool
+upload_body_rewind(upload_body_t *body);
+bool
+upload_body_set_range(upload_body_t *body, curl_off_t offset, curl_off_t length);
+size_t
+upload_body_read_callback(char *buffer, size_t size, size_t nitems, void *userdata);
+const char *
+upload_body_content_type(const upload_body_t *body, const char *file_path);
+bool
+upload_body_is_paused(const upload_body_t *body);
+void
+upload_body_resume(upload_body_t *body);
+int
+upload_body_seek_callback(void *userdata, curl_off_t offset, int origin);
+void
+upload_body_free(upload_body_t *body);
+
+#endif
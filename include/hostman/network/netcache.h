@@ -0,0 +1,25 @@
+#ifndef HOSTMAN_NETCACHE_H
+#define HOSTMAN_NETCACHE_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+
+#define NETCACHE_DNS_TTL_SECONDS 300
+#define NETCACHE_MAX_ENTRIES 64
+
+void
+netcache_load(void);
+void
+netcache_save(void);
+
+bool
+netcache_tls_supported(void);
+CURLcode
+netcache_ssl_ctx_callback(CURL *curl, void *ssl_ctx, void *userptr);
+
+struct curl_slist *
+netcache_resolve_list(const char *url);
+bool
+netcache_record_transfer(CURL *curl, const char *url, CURLcode result);
+
+#endif
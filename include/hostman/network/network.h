@@ -2,18 +2,25 @@
 #define HOSTMAN_NETWORK_H
 
 #include "hostman/core/config.h"
+#include "hostman/crypto/hash.h"
+#include "hostman/network/retry.h"
+#include "hostman/network/source.h"
+#include "hostman/network/timing.h"
 #include <curl/curl.h>
 #include <stdbool.h>
 
 #define DEFAULT_TIMEOUT_SECONDS 30
 #define DEFAULT_MAX_RETRIES 3
 #define DEFAULT_RETRY_DELAY_MS 1000
+#define DEFAULT_CHUNK_SIZE (8L * 1024 * 1024)
+#define DEFAULT_MAX_RETRY_DELAY_MS 30000
 
 typedef struct
 {
     long timeout_seconds;
     int max_retries;
     long retry_delay_ms;
+    long max_retry_delay_ms;
     bool enable_http2;
     char *proxy_url;
     bool verbose;
@@ -24,27 +31,92 @@ typedef struct
     double last_percent;
     curl_off_t last_bytes;
     time_t last_time;
+    /* Set when a request sends only part of the file, so the bar shows the whole upload */
+    curl_off_t offset;
+    curl_off_t size;
 } progress_data_t;
 
+typedef struct
+{
+    CURLcode curl_code;
+    long http_code;
+    retry_class_t retry_class;
+    long delay_ms;
+    char reason[256];
+} upload_attempt_t;
+
 typedef struct
 {
     bool success;
+    bool deduplicated;
     char *url;
     char *deletion_url;
     char *error_message;
     double request_time_ms;
     int retry_count;
     long http_code;
+    upload_attempt_t *attempts;
+    int attempt_count;
+    curl_off_t bytes_sent;
+    char content_hash[CONTENT_HASH_HEX_LEN + 1];
+    transfer_timing_t timing;
 } upload_response_t;
 
+typedef struct network_session network_session_t;
+
+/* Settings for one upload call; NULL takes the defaults */
+typedef struct
+{
+    /* Directory the files were found under. Object stores key each file by its path below it,
+     * and by the path as given otherwise. */
+    const char *root;
+    /* Reads a file again for its content hash when the upload did not send it in one pass
+     * (multipart and resumed uploads); otherwise those uploads report no hash */
+    bool hash_contents;
+    /* Draws a progress bar for each transfer; only for batches that send one file at a time */
+    bool show_progress;
+} network_upload_options_t;
+
+typedef const char *(*network_batch_next_fn)(void *userdata, int *index);
+typedef bool (*network_batch_done_fn)(void *userdata,
+                                      int index,
+                                      const char *file_path,
+                                      upload_response_t *response);
+
 bool
 network_init(void);
 void
 network_set_config(network_config_t *config);
 void
 network_set_insecure(bool insecure);
+void
+network_set_resident(bool resident);
+network_session_t *
+network_session_create(void);
+void
+network_session_free(network_session_t *session);
+bool
+network_max_response_size(const host_config_t *host, size_t *max_size);
+bool
+network_chunk_size(const host_config_t *host, curl_off_t *chunk_size);
+upload_response_t *
+network_upload_file(network_session_t *session,
+                    const char *file_path,
+                    host_config_t *host,
+                    const network_upload_options_t *options);
 upload_response_t *
-network_upload_file(const char *file_path, host_config_t *host);
+network_upload_source(network_session_t *session,
+                      upload_source_t *source,
+                      const char *name,
+                      host_config_t *host);
+bool
+network_upload_batch(network_session_t *session,
+                     host_config_t *host,
+                     int max_jobs,
+                     const network_upload_options_t *options,
+                     network_batch_next_fn next,
+                     network_batch_done_fn done,
+                     void *userdata);
 void
 network_free_response(upload_response_t *response);
 void
@@ -0,0 +1,21 @@
+#ifndef HOSTMAN_RATELIMIT_H
+#define HOSTMAN_RATELIMIT_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+bool
+rate_limit_parse(const char *text, curl_off_t *bytes_per_second);
+void
+rate_limit_set(curl_off_t bytes_per_second);
+curl_off_t
+rate_limit_get(void);
+size_t
+rate_limit_acquire(size_t want);
+long
+rate_limit_wait_ms(void);
+void
+rate_limit_refund(size_t unused);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef HOSTMAN_RESPONSE_H
+#define HOSTMAN_RESPONSE_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DEFAULT_MAX_RESPONSE_SIZE (8L * 1024 * 1024)
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t max_size;
+    bool overflowed;
+    CURL *curl;
+} response_buffer_t;
+
+void
+response_buffer_init(response_buffer_t *buffer, size_t max_size);
+void
+response_buffer_attach(response_buffer_t *buffer, CURL *curl);
+void
+response_buffer_reset(response_buffer_t *buffer);
+bool
+response_buffer_exceeded(const response_buffer_t *buffer, CURLcode res);
+bool
+response_header_value(const char *line,
+                      size_t length,
+                      const char *name,
+                      const char **value,
+                      size_t *size);
+void
+response_buffer_free(response_buffer_t *buffer);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HOSTMAN_RETRY_H
+#define HOSTMAN_RETRY_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    RETRY_CLASS_NONE,
+    RETRY_CLASS_TRANSIENT,
+    RETRY_CLASS_RATE_LIMITED,
+    RETRY_CLASS_FATAL
+} retry_class_t;
+
+typedef struct
+{
+    int max_attempts;
+    long base_delay_ms;
+    long max_delay_ms;
+} retry_policy_t;
+
+retry_class_t
+retry_classify(CURLcode code, long http_code);
+bool
+retry_is_retryable(retry_class_t retry_class);
+const char *
+retry_class_name(retry_class_t retry_class);
+/* Returns -1 when the server's Retry-After exceeds the policy's max_delay_ms */
+long
+retry_backoff_ms(const retry_policy_t *policy, int attempt, long retry_after_ms);
+void
+retry_sleep_ms(long ms);
+
+#endif
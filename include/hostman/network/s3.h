@@ -0,0 +1,55 @@
+#ifndef HOSTMAN_S3_H
+#define HOSTMAN_S3_H
+
+#include "hostman/core/config.h"
+#include "hostman/crypto/hash.h"
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define S3_DEFAULT_REGION "us-east-1"
+#define S3_DEFAULT_PART_CONCURRENCY 4
+#define S3_MAX_PART_CONCURRENCY 32
+#define S3_MAX_PARTS 10000
+#define S3_UNSIGNED_PAYLOAD "UNSIGNED-PAYLOAD"
+
+/* Files larger than one part are sent as a multipart upload: the upload is created, its parts
+ * are PUT concurrently and then listed in a completion request */
+typedef enum
+{
+    S3_STAGE_NONE,
+    S3_STAGE_PUT,
+    S3_STAGE_CREATE,
+    S3_STAGE_PART,
+    S3_STAGE_COMPLETE,
+    S3_STAGE_ABORT
+} s3_stage_t;
+
+typedef struct s3_key_set s3_key_set_t;
+
+char *
+s3_object_key(const char *file_path, const char *root);
+char *
+s3_object_url(const char *endpoint, const char *key);
+s3_key_set_t *
+s3_key_set_create(void);
+void
+s3_key_set_free(s3_key_set_t *set);
+const char *
+s3_key_set_claim(s3_key_set_t *set, const char *key, const char *file_path);
+bool
+s3_payload_hash(const char *data, size_t length, char *hex_out);
+bool
+s3_sign(struct curl_slist **headers,
+        const host_config_t *host,
+        const char *method,
+        const char *url,
+        const char *payload_hash,
+        time_t now);
+char *
+s3_xml_value(const char *xml, size_t length, const char *tag);
+char *
+s3_complete_body(char **etags, int count);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef HOSTMAN_SOURCE_H
+#define HOSTMAN_SOURCE_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define UPLOAD_SOURCE_ERROR ((size_t)-1)
+
+typedef enum
+{
+    UPLOAD_SOURCE_AUTO,
+    UPLOAD_SOURCE_MMAP,
+    UPLOAD_SOURCE_READ,
+    UPLOAD_SOURCE_UNKNOWN
+} upload_source_mode_t;
+
+typedef struct upload_source upload_source_t;
+
+upload_source_mode_t
+upload_source_mode_from_string(const char *mode);
+upload_source_t *
+upload_source_open_file(const char *path, upload_source_mode_t mode);
+upload_source_t *
+upload_source_open_fd(int fd);
+size_t
+upload_source_read(upload_source_t *source, char *buffer, size_t size);
+bool
+upload_source_rewind(upload_source_t *source);
+bool
+upload_source_seek(upload_source_t *source, curl_off_t offset);
+curl_off_t
+upload_source_size(const upload_source_t *source);
+curl_off_t
+upload_source_bytes_read(const upload_source_t *source);
+const char *
+upload_source_digest(upload_source_t *source);
+void
+upload_source_close(upload_source_t *source);
+
+#endif
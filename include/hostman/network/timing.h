@@ -0,0 +1,35 @@
+#ifndef HOSTMAN_TIMING_H
+#define HOSTMAN_TIMING_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    TIMING_PHASE_DNS,
+    TIMING_PHASE_CONNECT,
+    TIMING_PHASE_TLS,
+    TIMING_PHASE_PRETRANSFER,
+    TIMING_PHASE_TTFB,
+    TIMING_PHASE_TOTAL,
+    TIMING_PHASE_COUNT
+} timing_phase_t;
+
+/* Phase durations are in microseconds and do not overlap, except TOTAL */
+typedef struct
+{
+    bool valid;
+    long long phase_us[TIMING_PHASE_COUNT];
+    long long upload_speed;
+    char http_version[8];
+    char remote_ip[64];
+} transfer_timing_t;
+
+void
+transfer_timing_capture(CURL *curl, long long since_first_byte_us, transfer_timing_t *timing);
+const char *
+timing_phase_name(timing_phase_t phase);
+long long
+timing_percentile(const long long *sorted, int count, int percent);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOSTMAN_TUS_H
+#define HOSTMAN_TUS_H
+
+#include <curl/curl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TUS_VERSION "1.0.0"
+#define TUS_MAX_RESTARTS 3
+
+/* A tus upload is created once, then sent as PATCH chunks; a failed chunk is followed by a
+ * HEAD asking the server how much it kept, so only the lost bytes are sent again */
+typedef enum
+{
+    TUS_STAGE_NONE,
+    TUS_STAGE_CREATE,
+    TUS_STAGE_HEAD,
+    TUS_STAGE_PATCH
+} tus_stage_t;
+
+struct curl_slist *
+tus_append_metadata(struct curl_slist *headers, const char *file_path, const char *content_type);
+void
+tus_parse_header(const char *line, size_t length, char **location, curl_off_t *offset);
+char *
+tus_resolve_url(const char *endpoint, const char *location);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef HOSTMAN_DATABASE_H
 #define HOSTMAN_DATABASE_H
 
+#include "hostman/network/timing.h"
 #include <sqlite3.h>
 #include <stdbool.h>
 #include <time.h>
@@ -15,8 +16,55 @@ typedef struct
     char *deletion_url;
     char *filename;
     size_t size;
+    char *content_hash;
 } upload_record_t;
 
+typedef struct
+{
+    char *host_name;
+    int upload_count;
+    long long total_bytes;
+    time_t last_upload;
+} host_upload_stats_t;
+
+/* An upload that failed with a retryable error, waiting for `hostman flush` */
+typedef struct
+{
+    int id;
+    char *local_path;
+    char *host_name;
+    size_t size;
+    int attempts;
+    time_t next_attempt;
+    char *last_error;
+} queue_entry_t;
+
+/* A write waiting on another process's lock backs off from 1 ms up to 100 ms between tries and
+ * gives up after the timeout */
+#define DB_BUSY_TIMEOUT_MS 10000
+#define DB_BUSY_MIN_DELAY_MS 1
+#define DB_BUSY_MAX_DELAY_MS 100
+
+#define DB_DEFAULT_MMAP_SIZE (64LL * 1024 * 1024)
+#define DB_DEFAULT_CACHE_SIZE (8LL * 1024 * 1024)
+
+/* Batched writes are committed in groups of this many rows, or once this much time has passed */
+#define DB_BATCH_COMMIT_ROWS 64
+#define DB_BATCH_COMMIT_MS 1000
+
+/* A batch runs alongside its transfers, so it waits only this long for the write lock and
+ * retries deferred writes on a later tick */
+#define DB_BATCH_BUSY_TIMEOUT_MS 20
+
+/* Per-file state of a batch upload, journaled so an interrupted batch can be resumed */
+typedef enum
+{
+    JOURNAL_PENDING,
+    JOURNAL_IN_FLIGHT,
+    JOURNAL_DONE,
+    JOURNAL_FAILED
+} journal_state_t;
+
 bool
 db_init(void);
 
@@ -26,16 +74,104 @@ db_add_upload(const char *host_name,
               const char *remote_url,
               const char *deletion_url,
               const char *filename,
-              size_t size);
+              size_t size,
+              const char *content_hash,
+              const transfer_timing_t *timing);
 
 upload_record_t **
 db_get_uploads(const char *host_name, int page, int limit, int *count);
+/* Uploads older than the cursor, the timestamp and ID of the last upload already listed; a
+ * before_id of 0 starts from the newest */
+upload_record_t **
+db_get_uploads_after(const char *host_name,
+                     time_t before_ts,
+                     int before_id,
+                     int limit,
+                     int *count);
+upload_record_t *
+db_get_upload_by_id(int id);
+upload_record_t **
+db_get_uploads_by_ids(const int *ids, int id_count, int *count);
 
+void
+db_free_record(upload_record_t *record);
 void
 db_free_records(upload_record_t **records, int count);
 
+upload_record_t *
+db_find_upload_by_hash(const char *host_name, const char *content_hash);
+
+bool
+db_get_host_stats(host_upload_stats_t **stats, int *count);
+void
+db_free_host_stats(host_upload_stats_t *stats, int count);
+
+long long *
+db_get_timing_samples(const char *host_name, timing_phase_t phase, int *count);
+long long *
+db_get_speed_samples(const char *host_name, int *count);
+
+bool
+db_delete_uploads(const int *ids, int count);
+
+bool
+db_queue_add(const char *local_path,
+             const char *host_name,
+             size_t size,
+             time_t next_attempt,
+             const char *error);
+queue_entry_t *
+db_queue_get(bool due_only, time_t now, int *count);
+bool
+db_queue_defer(int id, time_t next_attempt, const char *error);
+bool
+db_queue_remove(int id);
+void
+db_free_queue_entries(queue_entry_t *entries, int count);
+
+bool
+db_journal_begin(const char *host_name, int *batch_id);
+bool
+db_journal_resume(int batch_id, char **host_name);
+bool
+db_journal_add(const char *local_path);
+bool
+db_journal_set(const char *local_path,
+               journal_state_t state,
+               const char *remote_url,
+               const char *error);
+bool
+db_journal_lookup(const char *local_path, journal_state_t *state, char **remote_url);
+char **
+db_journal_get_unfinished(int *count);
+bool
+db_journal_end(bool discard);
+
+bool
+db_batch_begin(void);
+bool
+db_batch_sync(void);
+void
+db_batch_tick(void);
+bool
+db_batch_end(void);
+
+bool
+db_tus_find(const char *local_path,
+            const char *host_name,
+            long long size,
+            long long mtime,
+            char **upload_url,
+            long long *offset);
+bool
+db_tus_save(const char *local_path,
+            const char *host_name,
+            long long size,
+            long long mtime,
+            const char *upload_url,
+            long long offset);
 bool
-db_delete_upload(int id);
+db_tus_remove(const char *local_path, const char *host_name);
 
 void
 db_close(void);
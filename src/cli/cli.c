@@ -1,14 +1,24 @@
 #include "hostman/cli/cli.h"
+#include "hostman/cli/daemon.h"
 #include "hostman/cli/tui.h"
+#include "hostman/cli/watch.h"
 #include "hostman/core/config.h"
 #include "hostman/core/logging.h"
 #include "hostman/core/notification.h"
 #include "hostman/core/utils.h"
+#include "hostman/core/walk.h"
+#include "hostman/crypto/hash.h"
+#include "hostman/network/body.h"
 #include "hostman/network/hosts.h"
 #include "hostman/network/network.h"
+#include "hostman/network/ratelimit.h"
+#include "hostman/network/response.h"
 #include "hostman/storage/database.h"
 #include <dirent.h>
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,6 +28,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <cJSON.h>
+
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
 #define EXIT_INVALID_ARGS 2
@@ -25,37 +37,74 @@
 #define EXIT_FILE_ERROR 4
 #define EXIT_CONFIG_ERROR 5
 
+#define MAX_UPLOAD_JOBS 64
+#define BATCH_LIST_LIMIT 1000
+#define MAX_UPLOAD_IDS 10000
+
 #define OPT_GLOBAL_JSON 1000
 #define OPT_GLOBAL_VERBOSE 1001
 #define OPT_GLOBAL_NO_COLOR 1002
+#define OPT_UPLOAD_STDIN_NAME 1100
+#define OPT_UPLOAD_DEDUPE 1101
+#define OPT_UPLOAD_LIMIT_RATE 1102
+#define OPT_UPLOAD_QUEUE_ON_FAILURE 1103
+#define OPT_UPLOAD_FILES_FROM 1104
+#define OPT_UPLOAD_RESUME 1105
+#define OPT_STATS_LATENCY 1200
+#define OPT_LIST_BEFORE 1210
+#define OPT_LIST_CURSOR 1211
+#define OPT_FILTER_INCLUDE 1300
+#define OPT_FILTER_EXCLUDE 1301
+#define OPT_WATCH_DEBOUNCE 1302
+#define OPT_FLUSH_ALL 1400
+
+/* Backoff between `hostman flush` attempts of a queued upload */
+#define QUEUE_RETRY_DELAY_MS (60 * 1000)
+#define QUEUE_MAX_RETRY_DELAY_MS (60 * 60 * 1000)
 
 static bool use_color = true;
 static output_mode_t current_output_mode = OUTPUT_NORMAL;
+static volatile sig_atomic_t batch_interrupted = 0;
+static bool cli_resident = false;
 
-typedef struct
+static void
+request_command_help(command_args_t *args, const char *command)
 {
-    char *data;
-    size_t size;
-} response_data_t;
+    args->type = CMD_HELP;
+    free(args->command_name);
+    args->command_name = strdup(command);
+}
 
-static size_t
-write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+static void
+parse_limit_rate_option(command_args_t *args, const char *value)
 {
-    size_t real_size = size * nmemb;
-    response_data_t *resp = (response_data_t *)userp;
-
-    char *ptr = realloc(resp->data, resp->size + real_size + 1);
-    if (!ptr)
+    curl_off_t rate = 0;
+    if (!rate_limit_parse(value, &rate))
     {
-        return 0;
+        print_error("Error: Invalid --limit-rate value '%s'\n", value);
+        args->type = CMD_UNKNOWN;
+        return;
     }
+    args->limit_rate = (long long)rate;
+}
 
-    resp->data = ptr;
-    memcpy(&(resp->data[resp->size]), contents, real_size);
-    resp->size += real_size;
-    resp->data[resp->size] = 0;
+static bool
+append_pattern(char ***patterns, int *count, const char *pattern)
+{
+    char **grown = realloc(*patterns, (*count + 1) * sizeof(char *));
+    if (!grown)
+    {
+        return false;
+    }
+    *patterns = grown;
 
-    return real_size;
+    grown[*count] = strdup(pattern);
+    if (!grown[*count])
+    {
+        return false;
+    }
+    (*count)++;
+    return true;
 }
 
 static bool
@@ -206,6 +255,13 @@ print_command_help(const char *command)
         print_command_syntax("upload", "<file_path> [file_path...]"),
           printf("   Upload one or more files\n");
         print_command_syntax("list-hosts", ""), printf("   List configured hosts\n");
+        print_command_syntax("stats", "[--latency] [--host <name>]"),
+          printf("   Summarize upload history and transfer latency\n");
+        print_command_syntax("daemon", ""), printf("   Serve uploads from a background process\n");
+        print_command_syntax("watch", "<directory>"),
+          printf("   Upload new files as they appear in a directory\n");
+        print_command_syntax("flush", "[--jobs <n>] [--limit-rate <rate>]"),
+          printf("   Retry uploads queued by --queue-on-failure\n");
         print_command_syntax("add-host", ""), printf("   Add a new host configuration\n");
         print_command_syntax("config", "<get|set> <key> [value]"),
           printf("   View or modify configuration\n");
@@ -221,7 +277,10 @@ print_command_help(const char *command)
         print_section_header("USAGE");
         printf("  hostman upload [options] <file_path> [file_path...]\n");
         printf("  hostman upload [options] --directory <path>\n");
-        printf("  hostman upload [options] --clipboard\n\n");
+        printf("  hostman upload [options] --files-from <file> [--null]\n");
+        printf("  hostman upload [options] --resume <batch-id> [source]\n");
+        printf("  hostman upload [options] --clipboard\n");
+        printf("  hostman upload [options] [--stdin-name <name>] -\n\n");
         printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
                "after the command.\n\n");
 
@@ -229,10 +288,24 @@ print_command_help(const char *command)
         print_option("--host <name>",
                      "Specify which host to use. If not provided, the default host will be used");
         print_option("--directory, -d <path>", "Upload all files from a directory");
+        print_option("--recursive, -r", "Also upload files in subdirectories (with --directory)");
+        print_option("--include <glob>",
+                     "Only upload file names matching the glob (with --directory, repeatable)");
+        print_option("--exclude <glob>",
+                     "Skip file names matching the glob (with --directory, repeatable)");
+        print_option("--files-from <file>", "Read paths to upload from a file, or stdin for -");
+        print_option("--null, -0", "Paths in --files-from are NUL-separated (find -print0)");
+        print_option("--resume <batch-id>",
+                     "Continue an interrupted batch, skipping files already uploaded");
         print_option("--clipboard, -p", "Upload an image directly from the clipboard");
+        print_option("--stdin-name <name>", "Stream the upload from stdin under this file name");
+        print_option("--dedupe", "Reuse the URL of an identical file already uploaded to the host");
         print_option("--continue-on-error, -c", "Continue uploading if a file fails (batch mode)");
-        print_option("--throttle, -t <ms>",
-                     "Delay between uploads in ms (batch mode, avoids rate limits)");
+        print_option("--jobs, -j <n>", "Upload up to n files concurrently (batch mode, max 64)");
+        print_option("--limit-rate <rate>",
+                     "Cap total upload bandwidth, e.g. 500K or 20M (bytes per second)");
+        print_option("--queue-on-failure",
+                     "Queue files that fail with a retryable error for 'hostman flush'");
         print_option("--no-clipboard, -n", "Do not copy URL(s) to clipboard");
         print_option("--insecure, -k", "Skip TLS certificate verification");
         print_option("--help", "Show this help message");
@@ -242,8 +315,12 @@ print_command_help(const char *command)
         printf("  hostman upload file1.png file2.jpg file3.gif\n");
         printf("  hostman upload --directory ./screenshots/\n");
         printf("  hostman upload --clipboard\n");
+        printf("  grim - | hostman upload --stdin-name screenshot.png -\n");
         printf("  hostman upload -d ./images/ --continue-on-error\n");
-        printf("  hostman upload -d ./images/ --throttle 1000\n");
+        printf("  hostman upload -d ./photos/ -r --include '*.jpg' --jobs 8\n");
+        printf("  hostman upload -d ./screenshots/ --jobs 8 --continue-on-error\n");
+        printf("  hostman upload -d ./videos/ --jobs 4 --limit-rate 20M\n");
+        printf("  find . -name '*.png' -print0 | hostman upload --null --files-from - -j 8\n");
         return;
     }
 
@@ -261,6 +338,102 @@ print_command_help(const char *command)
         print_option("--host <name>", "Filter uploads by host");
         print_option("--page <number>", "Page number for pagination (default: 1)");
         print_option("--limit <count>", "Number of records per page (default: 20)");
+        print_option("--before <id>", "List uploads older than the upload with this ID");
+        print_option("--cursor <cursor>", "Continue from a next_cursor value of --json output");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "stats") == 0)
+    {
+        print_section_header("STATS");
+        printf("Summarize upload history\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman stats [options]\n\n");
+        printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
+               "after the command.\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>", "Only include uploads to this host");
+        print_option("--latency", "Report p50/p90/p99 for each transfer phase");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "daemon") == 0)
+    {
+        print_section_header("DAEMON");
+        printf("Run hostman as a background upload daemon\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman daemon\n\n");
+
+        print_section_header("DESCRIPTION");
+        printf("  Listens on $XDG_RUNTIME_DIR/hostman.sock and keeps the configuration and\n");
+        printf("  network connections warm between invocations. While it runs, upload,\n");
+        printf("  list-uploads, delete-upload, delete-file and stats are forwarded to it and\n");
+        printf("  handled one at a time; a command that finds the daemon busy runs directly.\n");
+        printf("  Set HOSTMAN_NO_DAEMON=1 to always run commands in-process.\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--help", "Show this help message");
+        return;
+    }
+
+    if (strcmp(command, "watch") == 0)
+    {
+        print_section_header("WATCH");
+        printf("Upload new files as they appear in a directory\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman watch [options] <directory>\n\n");
+        printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
+               "after the command.\n\n");
+
+        print_section_header("DESCRIPTION");
+        printf("  Waits for files to be written or moved into the directory and uploads\n");
+        printf("  each one once it has been quiet for the debounce window. Hidden files\n");
+        printf("  are ignored.\n");
+        printf("  Runs until interrupted.\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--host <name>",
+                     "Specify which host to use. If not provided, the default host will be used");
+        print_option("--include <glob>", "Only upload file names matching the glob (repeatable)");
+        print_option("--exclude <glob>", "Skip file names matching the glob (repeatable)");
+        print_option("--debounce <ms>", "Wait this long after the last write (default: 500)");
+        print_option("--no-clipboard, -n", "Do not copy URLs to clipboard");
+        print_option("--insecure, -k", "Skip TLS certificate verification");
+        print_option("--help", "Show this help message");
+
+        print_section_header("EXAMPLES");
+        printf("  hostman watch ~/Screenshots\n");
+        printf("  hostman watch --include '*.png' --exclude '*.part' ~/Downloads\n");
+        return;
+    }
+
+    if (strcmp(command, "flush") == 0)
+    {
+        print_section_header("FLUSH");
+        printf("Retry uploads queued by --queue-on-failure\n\n");
+
+        print_section_header("USAGE");
+        printf("  hostman flush [options]\n\n");
+        printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
+               "after the command.\n\n");
+
+        print_section_header("DESCRIPTION");
+        printf("  Uploads every queued file whose backoff has expired, concurrently per host.\n");
+        printf("  Files that fail again stay queued with a longer backoff; files that no\n");
+        printf("  longer exist are dropped from the queue.\n\n");
+
+        print_section_header("OPTIONS");
+        print_option("--jobs, -j <n>", "Upload up to n files concurrently (max 64)");
+        print_option("--all", "Also retry files whose backoff has not expired yet");
+        print_option("--limit-rate <rate>",
+                     "Cap total upload bandwidth, e.g. 500K or 20M (bytes per second)");
+        print_option("--insecure, -k", "Skip TLS certificate verification");
         print_option("--help", "Show this help message");
         return;
     }
@@ -268,10 +441,12 @@ print_command_help(const char *command)
     if (strcmp(command, "delete-upload") == 0)
     {
         print_section_header("DELETE-UPLOAD");
-        printf("Delete an upload record by ID\n\n");
+        printf("Delete upload records by ID\n\n");
 
         print_section_header("USAGE");
-        printf("  hostman delete-upload <id>\n\n");
+        printf("  hostman delete-upload <id>...\n\n");
+        printf("  IDs can be listed and given as ranges, e.g. '3 7-9,12'; all of them are\n"
+               "  confirmed at once.\n\n");
         printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
                "after the command.\n\n");
 
@@ -283,10 +458,12 @@ print_command_help(const char *command)
     if (strcmp(command, "delete-file") == 0)
     {
         print_section_header("DELETE-FILE");
-        printf("Delete a file from the remote host using the deletion URL\n\n");
+        printf("Delete files from the remote host using their deletion URLs\n\n");
 
         print_section_header("USAGE");
-        printf("  hostman delete-file <id>\n\n");
+        printf("  hostman delete-file <id>...\n\n");
+        printf("  IDs can be listed and given as ranges, e.g. '3 7-9,12'; all of them are\n"
+               "  confirmed at once.\n\n");
         printf("  Global options like --quiet/--json/--verbose/--no-color can be used before or "
                "after the command.\n\n");
 
@@ -442,6 +619,8 @@ print_command_help(const char *command)
         print_option("log_file", "Path to log file");
         print_option("copy_to_clipboard", "Copy uploaded URL to clipboard (true/false)");
         print_option("default_host", "Default host for uploads");
+        print_option("db_mmap_size", "History database memory map size (default 64M, 0 disables)");
+        print_option("db_cache_size", "History database page cache size (default 8M)");
         print_option("hosts.<name>.<prop>", "Host-specific settings");
 
         print_section_header("EXAMPLES");
@@ -456,6 +635,122 @@ print_command_help(const char *command)
     printf("Run 'hostman help' for a list of available commands.\n");
 }
 
+/* A list cursor is "<timestamp>:<id>", the position of the last upload already listed */
+static bool
+parse_list_cursor(const char *text, long long *timestamp, int *id)
+{
+    char *end = NULL;
+    errno = 0;
+    long long ts = strtoll(text, &end, 10);
+    if (errno != 0 || end == text || *end != ':' || ts < 0)
+    {
+        return false;
+    }
+
+    const char *id_text = end + 1;
+    long value = strtol(id_text, &end, 10);
+    if (errno != 0 || end == id_text || *end != '\0' || value < 1 || value > INT_MAX)
+    {
+        return false;
+    }
+
+    *timestamp = ts;
+    *id = (int)value;
+    return true;
+}
+
+static int
+compare_ids(const void *a, const void *b)
+{
+    int left = *(const int *)a;
+    int right = *(const int *)b;
+    return (left > right) - (left < right);
+}
+
+/* Adds "<id>" or "<first>-<last>" to the list */
+static bool
+append_id_range(command_args_t *args, const char *text)
+{
+    char *end = NULL;
+    errno = 0;
+    long first = strtol(text, &end, 10);
+    long last = first;
+    if (errno == 0 && end != text && *end == '-')
+    {
+        const char *last_text = end + 1;
+        last = strtol(last_text, &end, 10);
+        if (end == last_text)
+        {
+            return false;
+        }
+    }
+    if (errno != 0 || end == text || *end != '\0' || first < 1 || last < first ||
+        last > INT_MAX || last - first >= MAX_UPLOAD_IDS - args->upload_id_count)
+    {
+        return false;
+    }
+
+    int added = (int)(last - first + 1);
+    int *grown = realloc(args->upload_ids, (args->upload_id_count + added) * sizeof(int));
+    if (!grown)
+    {
+        return false;
+    }
+    args->upload_ids = grown;
+
+    for (long id = first; id <= last; id++)
+    {
+        args->upload_ids[args->upload_id_count++] = (int)id;
+    }
+    return true;
+}
+
+/* IDs are given as separate arguments or comma-separated lists of IDs and ranges, e.g.
+ * "3 7-9,12"; the result is sorted and free of duplicates */
+static void
+parse_upload_ids(command_args_t *args, int argc, char *argv[], int first)
+{
+    if (first >= argc)
+    {
+        print_error("Error: Upload ID required\n");
+        args->type = CMD_UNKNOWN;
+        return;
+    }
+
+    for (int i = first; i < argc; i++)
+    {
+        char *list = strdup(argv[i]);
+        char *saveptr = NULL;
+        bool ok = list != NULL && list[0] != '\0';
+        for (char *item = list ? strtok_r(list, ",", &saveptr) : NULL; ok && item;
+             item = strtok_r(NULL, ",", &saveptr))
+        {
+            ok = append_id_range(args, item);
+        }
+        free(list);
+
+        if (!ok)
+        {
+            print_error("Error: Invalid upload ID '%s' (at most %d IDs per command)\n",
+                        argv[i],
+                        MAX_UPLOAD_IDS);
+            args->type = CMD_UNKNOWN;
+            return;
+        }
+    }
+
+    qsort(args->upload_ids, args->upload_id_count, sizeof(int), compare_ids);
+    int unique = 0;
+    for (int i = 0; i < args->upload_id_count; i++)
+    {
+        if (unique == 0 || args->upload_ids[unique - 1] != args->upload_ids[i])
+        {
+            args->upload_ids[unique++] = args->upload_ids[i];
+        }
+    }
+    args->upload_id_count = unique;
+}
+
 command_args_t
 parse_args(int argc, char *argv[])
 {
@@ -463,8 +758,12 @@ parse_args(int argc, char *argv[])
     args.type = CMD_UNKNOWN;
     args.page = 1;
     args.limit = 20;
+    args.jobs = 1;
     args.output_mode = OUTPUT_NORMAL;
 
+    use_color = true;
+    current_output_mode = OUTPUT_NORMAL;
+    notification_set_enabled(true);
     init_color_support();
 
     for (int i = 1; i < argc; i++)
@@ -510,6 +809,11 @@ parse_args(int argc, char *argv[])
         return args;
     }
 
+    /* Command options are parsed from the command onwards. optind = 0 makes glibc drop the
+     * scanning state of a previous parse, which the resident daemon would otherwise inherit. */
+    int command_argc = argc - cmd_index;
+    char **command_argv = argv + cmd_index;
+
     if (strcmp(argv[cmd_index], "upload") == 0)
     {
         args.type = CMD_UPLOAD;
@@ -531,15 +835,19 @@ parse_args(int argc, char *argv[])
 
         int option_index = 0;
         int c;
-        optind = cmd_index + 1;
+        optind = 0;
 
-        while ((c = getopt_long(argc, argv, "q", long_options, &option_index)) != -1)
+        while ((c = getopt_long(command_argc,
+                                command_argv,
+                                "q",
+                                long_options,
+                                &option_index)) != -1)
         {
             switch (c)
             {
                 case '?':
-                    print_command_help("list-hosts");
-                    exit(EXIT_SUCCESS);
+                    request_command_help(&args, "list-hosts");
+                    break;
                 default:
                     handle_global_option(c, &args);
                     break;
@@ -559,35 +867,31 @@ parse_args(int argc, char *argv[])
 
         int option_index = 0;
         int c;
-        optind = cmd_index + 1;
+        optind = 0;
 
-        while ((c = getopt_long(argc, argv, "q", long_options, &option_index)) != -1)
+        while ((c = getopt_long(command_argc,
+                                command_argv,
+                                "q",
+                                long_options,
+                                &option_index)) != -1)
         {
             switch (c)
             {
                 case '?':
-                    print_command_help("delete-upload");
-                    exit(EXIT_SUCCESS);
+                    request_command_help(&args, "delete-upload");
+                    break;
                 default:
                     handle_global_option(c, &args);
                     break;
             }
         }
 
-        if (optind < argc)
-        {
-            args.upload_id = atoi(argv[optind]);
-            if (args.upload_id <= 0)
-            {
-                print_error("Error: Invalid upload ID\n");
-                args.type = CMD_UNKNOWN;
-            }
-        }
-        else
+        if (args.type == CMD_HELP)
         {
-            print_error("Error: Upload ID required\n");
-            args.type = CMD_UNKNOWN;
+            return args;
         }
+
+        parse_upload_ids(&args, command_argc, command_argv, optind);
     }
     else if (strcmp(argv[cmd_index], "delete-file") == 0)
     {
@@ -602,36 +906,75 @@ parse_args(int argc, char *argv[])
 
         int option_index = 0;
         int c;
-        optind = cmd_index + 1;
+        optind = 0;
 
-        while ((c = getopt_long(argc, argv, "q", long_options, &option_index)) != -1)
+        while ((c = getopt_long(command_argc,
+                                command_argv,
+                                "q",
+                                long_options,
+                                &option_index)) != -1)
         {
             switch (c)
             {
                 case '?':
-                    print_command_help("delete-file");
-                    exit(EXIT_SUCCESS);
+                    request_command_help(&args, "delete-file");
+                    break;
                 default:
                     handle_global_option(c, &args);
                     break;
             }
         }
 
-        if (optind < argc)
+        if (args.type == CMD_HELP)
         {
-            args.upload_id = atoi(argv[optind]);
-            if (args.upload_id <= 0)
-            {
-                print_error("Error: Invalid upload ID\n");
-                args.type = CMD_UNKNOWN;
-            }
+            return args;
         }
-        else
+
+        parse_upload_ids(&args, command_argc, command_argv, optind);
+    }
+    else if (strcmp(argv[cmd_index], "stats") == 0)
+    {
+        args.type = CMD_STATS;
+    }
+    else if (strcmp(argv[cmd_index], "daemon") == 0)
+    {
+        args.type = CMD_DAEMON;
+
+        static struct option long_options[] = { { "help", no_argument, 0, '?' },
+                                                { "quiet", no_argument, 0, 'q' },
+                                                { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
+                                                { "no-color", no_argument, 0, OPT_GLOBAL_NO_COLOR },
+                                                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+        int c;
+        optind = 0;
+
+        while ((c = getopt_long(command_argc,
+                                command_argv,
+                                "q",
+                                long_options,
+                                &option_index)) != -1)
         {
-            print_error("Error: Upload ID required\n");
-            args.type = CMD_UNKNOWN;
+            switch (c)
+            {
+                case '?':
+                    request_command_help(&args, "daemon");
+                    break;
+                default:
+                    handle_global_option(c, &args);
+                    break;
+            }
         }
     }
+    else if (strcmp(argv[cmd_index], "watch") == 0)
+    {
+        args.type = CMD_WATCH;
+    }
+    else if (strcmp(argv[cmd_index], "flush") == 0)
+    {
+        args.type = CMD_FLUSH;
+    }
     else if (strcmp(argv[cmd_index], "add-host") == 0)
     {
         args.type = CMD_ADD_HOST;
@@ -687,11 +1030,22 @@ parse_args(int argc, char *argv[])
             static struct option long_options[] = {
                 { "host", required_argument, 0, 'h' },
                 { "directory", required_argument, 0, 'd' },
+                { "recursive", no_argument, 0, 'r' },
+                { "include", required_argument, 0, OPT_FILTER_INCLUDE },
+                { "exclude", required_argument, 0, OPT_FILTER_EXCLUDE },
                 { "continue-on-error", no_argument, 0, 'c' },
                 { "throttle", required_argument, 0, 't' },
+                { "jobs", required_argument, 0, 'j' },
+                { "limit-rate", required_argument, 0, OPT_UPLOAD_LIMIT_RATE },
                 { "no-clipboard", no_argument, 0, 'n' },
                 { "insecure", no_argument, 0, 'k' },
                 { "clipboard", no_argument, 0, 'p' },
+                { "stdin-name", required_argument, 0, OPT_UPLOAD_STDIN_NAME },
+                { "dedupe", no_argument, 0, OPT_UPLOAD_DEDUPE },
+                { "queue-on-failure", no_argument, 0, OPT_UPLOAD_QUEUE_ON_FAILURE },
+                { "files-from", required_argument, 0, OPT_UPLOAD_FILES_FROM },
+                { "null", no_argument, 0, '0' },
+                { "resume", required_argument, 0, OPT_UPLOAD_RESUME },
                 { "quiet", no_argument, 0, 'q' },
                 { "json", no_argument, 0, OPT_GLOBAL_JSON },
                 { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
@@ -702,9 +1056,13 @@ parse_args(int argc, char *argv[])
 
             int option_index = 0;
             int c;
-            optind = cmd_index + 1;
+            optind = 0;
 
-            while ((c = getopt_long(argc, argv, "h:d:ct:nkpq", long_options, &option_index)) != -1)
+            while ((c = getopt_long(command_argc,
+                                    command_argv,
+                                    "h:d:rct:j:nkp0q",
+                                    long_options,
+                                    &option_index)) != -1)
             {
                 switch (c)
                 {
@@ -714,13 +1072,36 @@ parse_args(int argc, char *argv[])
                     case 'd':
                         args.directory = strdup(optarg);
                         break;
+                    case 'r':
+                        args.recursive = true;
+                        break;
+                    case OPT_FILTER_INCLUDE:
+                        if (!append_pattern(&args.include_patterns, &args.include_count, optarg))
+                        {
+                            print_error("Error: Out of memory\n");
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case OPT_FILTER_EXCLUDE:
+                        if (!append_pattern(&args.exclude_patterns, &args.exclude_count, optarg))
+                        {
+                            print_error("Error: Out of memory\n");
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
                     case 'c':
                         args.continue_on_error = true;
                         break;
                     case 't':
-                        args.throttle_ms = atoi(optarg);
-                        if (args.throttle_ms < 0)
-                            args.throttle_ms = 0;
+                        print_error("Warning: --throttle is deprecated and has no effect; "
+                                    "use --limit-rate to cap upload bandwidth\n");
+                        break;
+                    case 'j':
+                        args.jobs = atoi(optarg);
+                        if (args.jobs < 1)
+                            args.jobs = 1;
+                        if (args.jobs > MAX_UPLOAD_JOBS)
+                            args.jobs = MAX_UPLOAD_JOBS;
                         break;
                     case 'n':
                         args.no_clipboard = true;
@@ -731,18 +1112,147 @@ parse_args(int argc, char *argv[])
                     case 'p':
                         args.from_clipboard = true;
                         break;
+                    case OPT_UPLOAD_LIMIT_RATE:
+                        parse_limit_rate_option(&args, optarg);
+                        break;
+                    case OPT_UPLOAD_DEDUPE:
+                        args.dedupe = true;
+                        break;
+                    case OPT_UPLOAD_QUEUE_ON_FAILURE:
+                        args.queue_on_failure = true;
+                        break;
+                    case OPT_UPLOAD_FILES_FROM:
+                        free(args.files_from);
+                        args.files_from = strdup(optarg);
+                        break;
+                    case '0':
+                        args.null_separated = true;
+                        break;
+                    case OPT_UPLOAD_RESUME:
+                        args.resume_batch = atoi(optarg);
+                        if (args.resume_batch < 1)
+                        {
+                            print_error("Error: Invalid batch ID '%s'\n", optarg);
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case OPT_UPLOAD_STDIN_NAME:
+                        free(args.stdin_name);
+                        args.stdin_name = strdup(optarg);
+                        break;
                     case '?':
-                        print_command_help("upload");
-                        exit(EXIT_SUCCESS);
+                        request_command_help(&args, "upload");
+                        break;
                     default:
                         handle_global_option(c, &args);
                         break;
                 }
             }
 
-            if (args.from_clipboard)
+            if (args.type != CMD_UPLOAD)
+            {
+                break;
+            }
+
+            if (!args.directory &&
+                (args.recursive || args.include_count > 0 || args.exclude_count > 0))
+            {
+                print_error("Error: --recursive, --include and --exclude require --directory\n");
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+
+            if (args.null_separated && !args.files_from)
+            {
+                print_error("Error: --null requires --files-from\n");
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+
+            bool stdin_dash =
+              optind == command_argc - 1 && strcmp(command_argv[optind], "-") == 0;
+            if (args.resume_batch > 0 && (args.from_clipboard || args.stdin_name || stdin_dash))
+            {
+                print_error("Error: --resume cannot be used with --clipboard or stdin uploads\n");
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+
+            if (args.files_from)
+            {
+                if (args.from_clipboard || args.directory || args.stdin_name ||
+                    optind < command_argc)
+                {
+                    print_error("Error: --files-from cannot be combined with file paths, "
+                                "--directory, --clipboard or --stdin-name\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+
+                if (strcmp(args.files_from, "-") == 0 && isatty(STDIN_FILENO))
+                {
+                    print_error("Error: stdin is a terminal\n");
+                    print_info("  Pipe paths into hostman, e.g. find . -print0 | "
+                               "hostman upload --null --files-from -\n");
+                    args.type = CMD_UNKNOWN;
+                }
+                break;
+            }
+
+            if (args.stdin_name || stdin_dash)
+            {
+                if (args.from_clipboard || args.directory ||
+                    (optind < command_argc && !stdin_dash))
+                {
+                    print_error("Error: Uploading from stdin cannot be combined with file paths, "
+                                "--directory or --clipboard\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+
+                if (args.dedupe)
+                {
+                    print_error("Error: --dedupe cannot be used when uploading from stdin\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+
+                if (args.queue_on_failure)
+                {
+                    print_error(
+                      "Error: --queue-on-failure cannot be used when uploading from stdin\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+
+                if (isatty(STDIN_FILENO))
+                {
+                    print_error("Error: stdin is a terminal\n");
+                    print_info("  Pipe data into hostman, e.g. grim - | hostman upload -\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+
+                args.from_stdin = true;
+                if (!args.stdin_name)
+                {
+                    args.stdin_name = strdup("stdin");
+                }
+
+                args.file_count = 1;
+                args.file_paths = malloc(sizeof(char *));
+                if (!args.file_paths)
+                {
+                    print_error("Error: Out of memory\n");
+                    args.type = CMD_UNKNOWN;
+                    break;
+                }
+                args.file_paths[0] = strdup("-");
+                args.file_path = strdup("-");
+            }
+            else if (args.from_clipboard)
             {
-                if (args.directory || optind < argc)
+                if (args.directory || optind < command_argc)
                 {
                     print_error("Error: --clipboard cannot be combined with file paths or "
                                 "--directory\n");
@@ -792,6 +1302,7 @@ parse_args(int argc, char *argv[])
             }
             else if (args.directory)
             {
+                /* Files are discovered while uploading; see dir_walk_start() */
                 struct stat dir_stat;
                 if (stat(args.directory, &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
                 {
@@ -799,83 +1310,24 @@ parse_args(int argc, char *argv[])
                     args.type = CMD_UNKNOWN;
                     break;
                 }
-
-                DIR *dir = opendir(args.directory);
-                if (!dir)
+            }
+            else if (optind < command_argc)
+            {
+                int remaining = command_argc - optind;
+                if (remaining == 1)
                 {
-                    print_error("Error: Cannot open directory '%s'\n", args.directory);
-                    args.type = CMD_UNKNOWN;
-                    break;
+                    args.file_path = strdup(command_argv[optind]);
+                    args.file_count = 1;
+                    args.file_paths = malloc(sizeof(char *));
+                    if (!args.file_paths)
+                    {
+                        print_error("Error: Out of memory\n");
+                        args.type = CMD_UNKNOWN;
+                        break;
+                    }
+                    args.file_paths[0] = strdup(command_argv[optind]);
                 }
-
-                int capacity = 16;
-                args.file_paths = malloc(capacity * sizeof(char *));
-                if (!args.file_paths)
-                {
-                    print_error("Error: Out of memory reading directory\n");
-                    closedir(dir);
-                    args.type = CMD_UNKNOWN;
-                    break;
-                }
-                args.file_count = 0;
-
-                struct dirent *entry;
-                while ((entry = readdir(dir)) != NULL)
-                {
-                    if (entry->d_name[0] == '.')
-                        continue;
-
-                    char full_path[4096];
-                    snprintf(full_path, sizeof(full_path), "%s/%s", args.directory, entry->d_name);
-
-                    struct stat file_stat;
-                    if (stat(full_path, &file_stat) == 0 && S_ISREG(file_stat.st_mode))
-                    {
-                        if (args.file_count >= capacity)
-                        {
-                            capacity *= 2;
-                            char **new_paths = realloc(args.file_paths, capacity * sizeof(char *));
-                            if (!new_paths)
-                            {
-                                print_error("Error: Out of memory reading directory\n");
-                                closedir(dir);
-                                args.type = CMD_UNKNOWN;
-                                break;
-                            }
-                            args.file_paths = new_paths;
-                        }
-                        args.file_paths[args.file_count++] = strdup(full_path);
-                    }
-                }
-                closedir(dir);
-
-                if (args.file_count == 0)
-                {
-                    print_error("Error: No files found in directory '%s'\n", args.directory);
-                    args.type = CMD_UNKNOWN;
-                }
-                else if (args.file_count > 0)
-                {
-                    args.file_path = strdup(args.file_paths[0]);
-                }
-            }
-            else if (optind < argc)
-            {
-                int remaining = argc - optind;
-                if (remaining == 1)
-                {
-                    args.file_path = strdup(argv[optind]);
-                    args.file_count = 1;
-                    args.file_paths = malloc(sizeof(char *));
-                    if (!args.file_paths)
-                    {
-                        print_error("Error: Out of memory\n");
-                        args.type = CMD_UNKNOWN;
-                        break;
-                    }
-                    args.file_paths[0] = strdup(argv[optind]);
-                }
-                else
+                else
                 {
                     args.file_count = remaining;
                     args.file_paths = malloc(remaining * sizeof(char *));
@@ -887,59 +1339,17 @@ parse_args(int argc, char *argv[])
                     }
                     for (int i = 0; i < remaining; i++)
                     {
-                        args.file_paths[i] = strdup(argv[optind + i]);
+                        args.file_paths[i] = strdup(command_argv[optind + i]);
                     }
                     args.file_path = strdup(args.file_paths[0]);
                 }
             }
-            else
+            else if (args.resume_batch == 0)
             {
                 if (!isatty(STDIN_FILENO))
                 {
-                    char line[4096];
-                    int capacity = 16;
-                    args.file_paths = malloc(capacity * sizeof(char *));
-                    if (!args.file_paths)
-                    {
-                        print_error("Error: Out of memory reading stdin\n");
-                        args.type = CMD_UNKNOWN;
-                        break;
-                    }
-                    args.file_count = 0;
-
-                    while (fgets(line, sizeof(line), stdin))
-                    {
-                        size_t len = strlen(line);
-                        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
-                            line[--len] = '\0';
-
-                        if (len == 0)
-                            continue;
-
-                        if (args.file_count >= capacity)
-                        {
-                            capacity *= 2;
-                            char **new_paths = realloc(args.file_paths, capacity * sizeof(char *));
-                            if (!new_paths)
-                            {
-                                print_error("Error: Out of memory reading stdin\n");
-                                args.type = CMD_UNKNOWN;
-                                break;
-                            }
-                            args.file_paths = new_paths;
-                        }
-                        args.file_paths[args.file_count++] = strdup(line);
-                    }
-
-                    if (args.file_count == 0)
-                    {
-                        print_error("Error: No file paths received from stdin\n");
-                        args.type = CMD_UNKNOWN;
-                    }
-                    else
-                    {
-                        args.file_path = strdup(args.file_paths[0]);
-                    }
+                    /* A path list piped without --files-from is read the same way */
+                    args.files_from = strdup("-");
                 }
                 else
                 {
@@ -956,6 +1366,8 @@ parse_args(int argc, char *argv[])
                 { "host", required_argument, 0, 'h' },
                 { "page", required_argument, 0, 'p' },
                 { "limit", required_argument, 0, 'l' },
+                { "before", required_argument, 0, OPT_LIST_BEFORE },
+                { "cursor", required_argument, 0, OPT_LIST_CURSOR },
                 { "quiet", no_argument, 0, 'q' },
                 { "json", no_argument, 0, OPT_GLOBAL_JSON },
                 { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
@@ -966,9 +1378,13 @@ parse_args(int argc, char *argv[])
 
             int option_index = 0;
             int c;
-            optind = cmd_index + 1;
+            optind = 0;
 
-            while ((c = getopt_long(argc, argv, "h:p:l:q", long_options, &option_index)) != -1)
+            while ((c = getopt_long(command_argc,
+                                    command_argv,
+                                    "h:p:l:q",
+                                    long_options,
+                                    &option_index)) != -1)
             {
                 switch (c)
                 {
@@ -985,9 +1401,219 @@ parse_args(int argc, char *argv[])
                         if (args.limit < 1)
                             args.limit = 1;
                         break;
+                    case OPT_LIST_BEFORE:
+                        args.before_id = atoi(optarg);
+                        args.before_timestamp = -1;
+                        if (args.before_id < 1)
+                        {
+                            print_error("Error: Invalid upload ID '%s'\n", optarg);
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case OPT_LIST_CURSOR:
+                        if (!parse_list_cursor(optarg, &args.before_timestamp, &args.before_id))
+                        {
+                            print_error("Error: Invalid cursor '%s'\n", optarg);
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case '?':
+                        request_command_help(&args, "list-uploads");
+                        break;
+                    default:
+                        handle_global_option(c, &args);
+                        break;
+                }
+            }
+
+            if (args.type == CMD_LIST_UPLOADS && args.before_id > 0 && args.page > 1)
+            {
+                print_error("Error: --page cannot be combined with --before or --cursor\n");
+                args.type = CMD_UNKNOWN;
+            }
+            break;
+        }
+
+        case CMD_STATS:
+        {
+            static struct option long_options[] = {
+                { "host", required_argument, 0, 'h' },
+                { "latency", no_argument, 0, OPT_STATS_LATENCY },
+                { "quiet", no_argument, 0, 'q' },
+                { "json", no_argument, 0, OPT_GLOBAL_JSON },
+                { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
+                { "no-color", no_argument, 0, OPT_GLOBAL_NO_COLOR },
+                { "help", no_argument, 0, '?' },
+                { 0, 0, 0, 0 }
+            };
+
+            int option_index = 0;
+            int c;
+            optind = 0;
+
+            while ((c = getopt_long(command_argc,
+                                    command_argv,
+                                    "h:q",
+                                    long_options,
+                                    &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        args.host_name = strdup(optarg);
+                        break;
+                    case OPT_STATS_LATENCY:
+                        args.latency = true;
+                        break;
+                    case '?':
+                        request_command_help(&args, "stats");
+                        break;
+                    default:
+                        handle_global_option(c, &args);
+                        break;
+                }
+            }
+            break;
+        }
+
+        case CMD_WATCH:
+        {
+            static struct option long_options[] = {
+                { "host", required_argument, 0, 'h' },
+                { "include", required_argument, 0, OPT_FILTER_INCLUDE },
+                { "exclude", required_argument, 0, OPT_FILTER_EXCLUDE },
+                { "debounce", required_argument, 0, OPT_WATCH_DEBOUNCE },
+                { "no-clipboard", no_argument, 0, 'n' },
+                { "insecure", no_argument, 0, 'k' },
+                { "quiet", no_argument, 0, 'q' },
+                { "json", no_argument, 0, OPT_GLOBAL_JSON },
+                { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
+                { "no-color", no_argument, 0, OPT_GLOBAL_NO_COLOR },
+                { "help", no_argument, 0, '?' },
+                { 0, 0, 0, 0 }
+            };
+
+            args.debounce_ms = WATCH_DEFAULT_DEBOUNCE_MS;
+
+            int option_index = 0;
+            int c;
+            optind = 0;
+
+            while ((c = getopt_long(command_argc,
+                                    command_argv,
+                                    "h:nkq",
+                                    long_options,
+                                    &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'h':
+                        free(args.host_name);
+                        args.host_name = strdup(optarg);
+                        break;
+                    case OPT_FILTER_INCLUDE:
+                        if (!append_pattern(&args.include_patterns, &args.include_count, optarg))
+                        {
+                            print_error("Error: Out of memory\n");
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case OPT_FILTER_EXCLUDE:
+                        if (!append_pattern(&args.exclude_patterns, &args.exclude_count, optarg))
+                        {
+                            print_error("Error: Out of memory\n");
+                            args.type = CMD_UNKNOWN;
+                        }
+                        break;
+                    case OPT_WATCH_DEBOUNCE:
+                        args.debounce_ms = atoi(optarg);
+                        if (args.debounce_ms < 0)
+                            args.debounce_ms = 0;
+                        break;
+                    case 'n':
+                        args.no_clipboard = true;
+                        break;
+                    case 'k':
+                        args.insecure = true;
+                        break;
+                    case '?':
+                        request_command_help(&args, "watch");
+                        break;
+                    default:
+                        handle_global_option(c, &args);
+                        break;
+                }
+            }
+
+            if (args.type != CMD_WATCH)
+            {
+                break;
+            }
+
+            if (optind != command_argc - 1)
+            {
+                print_error("Error: Exactly one directory to watch is required\n");
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+
+            struct stat dir_stat;
+            if (stat(command_argv[optind], &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+            {
+                print_error("Error: '%s' is not a valid directory\n", command_argv[optind]);
+                args.type = CMD_UNKNOWN;
+                break;
+            }
+            args.directory = strdup(command_argv[optind]);
+            break;
+        }
+
+        case CMD_FLUSH:
+        {
+            static struct option long_options[] = {
+                { "jobs", required_argument, 0, 'j' },
+                { "all", no_argument, 0, OPT_FLUSH_ALL },
+                { "limit-rate", required_argument, 0, OPT_UPLOAD_LIMIT_RATE },
+                { "insecure", no_argument, 0, 'k' },
+                { "quiet", no_argument, 0, 'q' },
+                { "json", no_argument, 0, OPT_GLOBAL_JSON },
+                { "verbose", no_argument, 0, OPT_GLOBAL_VERBOSE },
+                { "no-color", no_argument, 0, OPT_GLOBAL_NO_COLOR },
+                { "help", no_argument, 0, '?' },
+                { 0, 0, 0, 0 }
+            };
+
+            int option_index = 0;
+            int c;
+            optind = 0;
+
+            while ((c = getopt_long(command_argc,
+                                    command_argv,
+                                    "j:kq",
+                                    long_options,
+                                    &option_index)) != -1)
+            {
+                switch (c)
+                {
+                    case 'j':
+                        args.jobs = atoi(optarg);
+                        if (args.jobs < 1)
+                            args.jobs = 1;
+                        if (args.jobs > MAX_UPLOAD_JOBS)
+                            args.jobs = MAX_UPLOAD_JOBS;
+                        break;
+                    case OPT_FLUSH_ALL:
+                        args.flush_all = true;
+                        break;
+                    case OPT_UPLOAD_LIMIT_RATE:
+                        parse_limit_rate_option(&args, optarg);
+                        break;
+                    case 'k':
+                        args.insecure = true;
+                        break;
                     case '?':
-                        print_command_help("list-uploads");
-                        exit(EXIT_SUCCESS);
+                        request_command_help(&args, "flush");
+                        break;
                     default:
                         handle_global_option(c, &args);
                         break;
@@ -1168,93 +1794,1544 @@ parse_args(int argc, char *argv[])
     return args;
 }
 
-int
-execute_command(command_args_t *args)
+/* One line of the batch summary, tagged with the file's position in the input */
+typedef struct
 {
-    switch (args->type)
+    int index;
+    char *name;
+    char *detail;
+} batch_entry_t;
+
+/* Holds every entry, or when limit is set only the limit lowest-indexed ones; the rest are
+ * only counted */
+typedef struct
+{
+    batch_entry_t *entries;
+    int count;
+    int capacity;
+    int limit;
+    /* Slot of the entry with the highest index */
+    int highest;
+    int omitted;
+} batch_list_t;
+
+typedef struct
+{
+    command_args_t *args;
+    host_config_t *host;
+    int next_file;
+    /* File count, or -1 while files are still being discovered */
+    int total;
+    int success_count;
+    int failure_count;
+    batch_list_t successes;
+    batch_list_t failures;
+    upload_response_t **existing;
+    dir_walk_t *walk;
+    char *walk_path;
+    FILE *files_from;
+    /* Index of the file whose "Uploading" line was printed when it was handed out, or -1 */
+    int announced;
+    bool journaled;
+    int batch_id;
+    bool stopped;
+} batch_state_t;
+
+static void
+batch_list_add(batch_list_t *list, int index, const char *name, const char *detail)
+{
+    batch_entry_t *entry;
+
+    /* Concurrent uploads finish out of order, so a full list trades its highest index for a
+     * lower one; the summary then shows the start of the batch */
+    if (list->limit > 0 && list->count == list->limit)
     {
-        case CMD_UPLOAD:
+        list->omitted++;
+        entry = &list->entries[list->highest];
+        if (index > entry->index)
         {
-            hostman_config_t *config = config_load();
-            if (!config)
+            return;
+        }
+
+        free(entry->name);
+        free(entry->detail);
+        entry->index = index;
+        entry->name = strdup(name);
+        entry->detail = detail ? strdup(detail) : NULL;
+        for (int i = 0; i < list->count; i++)
+        {
+            if (list->entries[i].index > list->entries[list->highest].index)
+            {
+                list->highest = i;
+            }
+        }
+        return;
+    }
+
+    if (list->count == list->capacity)
+    {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        if (list->limit > 0 && capacity > list->limit)
+        {
+            capacity = list->limit;
+        }
+
+        batch_entry_t *entries = realloc(list->entries, capacity * sizeof(batch_entry_t));
+        if (!entries)
+        {
+            list->omitted++;
+            return;
+        }
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+
+    if (list->count == 0 || index > list->entries[list->highest].index)
+    {
+        list->highest = list->count;
+    }
+    entry = &list->entries[list->count++];
+    entry->index = index;
+    entry->name = strdup(name);
+    entry->detail = detail ? strdup(detail) : NULL;
+}
+
+static int
+compare_batch_entries(const void *a, const void *b)
+{
+    const batch_entry_t *left = (const batch_entry_t *)a;
+    const batch_entry_t *right = (const batch_entry_t *)b;
+    return (left->index > right->index) - (left->index < right->index);
+}
+
+/* Concurrent uploads finish out of order; the summary follows the input order */
+static void
+batch_list_sort(batch_list_t *list)
+{
+    qsort(list->entries, list->count, sizeof(batch_entry_t), compare_batch_entries);
+}
+
+static void
+batch_list_free(batch_list_t *list)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        free(list->entries[i].name);
+        free(list->entries[i].detail);
+    }
+    free(list->entries);
+}
+
+static void
+batch_free(batch_state_t *state)
+{
+    batch_list_free(&state->successes);
+    batch_list_free(&state->failures);
+    free(state->walk_path);
+}
+
+static void
+batch_label(const batch_state_t *state, int index, char *buffer, size_t size)
+{
+    if (state->total < 0)
+    {
+        snprintf(buffer, size, "[%d]", index + 1);
+    }
+    else
+    {
+        snprintf(buffer, size, "[%d/%d]", index + 1, state->total);
+    }
+}
+
+static void
+handle_batch_interrupt(int signum)
+{
+    (void)signum;
+    batch_interrupted = 1;
+}
+
+/* The daemon keeps its own SIGINT/SIGTERM handlers, which stop a running batch through
+ * cli_request_interrupt() as well as the daemon */
+void
+cli_set_resident(bool resident)
+{
+    cli_resident = resident;
+}
+
+/* Async-signal-safe; lets the daemon stop a batch on behalf of the client that started it */
+void
+cli_request_interrupt(void)
+{
+    batch_interrupted = 1;
+}
+
+/* Journal entries are keyed by absolute path, so a batch can be resumed from any directory */
+static char *
+journal_key(const char *file_path)
+{
+    char *key = realpath(file_path, NULL);
+    if (key || file_path[0] == '/')
+    {
+        return key ? key : strdup(file_path);
+    }
+
+    /* A missing file has no real path, but must still resolve from another directory */
+    char *cwd = getcwd(NULL, 0);
+    if (!cwd)
+    {
+        return strdup(file_path);
+    }
+
+    size_t len = strlen(cwd) + strlen(file_path) + 2;
+    key = malloc(len);
+    if (key)
+    {
+        snprintf(key, len, "%s/%s", cwd, file_path);
+    }
+    free(cwd);
+    return key;
+}
+
+static void
+batch_journal(const batch_state_t *state,
+              const char *file_path,
+              journal_state_t journal_state,
+              const char *remote_url,
+              const char *error)
+{
+    if (!state->journaled)
+    {
+        return;
+    }
+
+    char *key = journal_key(file_path);
+    if (key)
+    {
+        db_journal_set(key, journal_state, remote_url, error);
+        free(key);
+    }
+
+    /* After Ctrl+C every outcome is committed at once, so a second Ctrl+C loses nothing */
+    if (batch_interrupted)
+    {
+        db_batch_sync();
+    }
+}
+
+/* Files a resumed batch already uploaded are reported with their journaled URL */
+static upload_response_t *
+find_journaled_upload(const batch_state_t *state, const char *file_path)
+{
+    if (!state->journaled || state->args->resume_batch == 0)
+    {
+        return NULL;
+    }
+
+    char *key = journal_key(file_path);
+    journal_state_t journal_state;
+    char *remote_url = NULL;
+    bool found = key && db_journal_lookup(key, &journal_state, &remote_url);
+    free(key);
+
+    if (!found || journal_state != JOURNAL_DONE || !remote_url)
+    {
+        free(remote_url);
+        return NULL;
+    }
+
+    upload_response_t *response = calloc(1, sizeof(upload_response_t));
+    if (!response)
+    {
+        free(remote_url);
+        return NULL;
+    }
+
+    response->success = true;
+    response->deduplicated = true;
+    response->url = remote_url;
+    return response;
+}
+
+/* Whether the server refused the request in a way that retrying later would not change */
+static bool
+upload_was_rejected(const upload_response_t *response)
+{
+    if (!response || response->attempt_count == 0)
+    {
+        return false;
+    }
+
+    const upload_attempt_t *last = &response->attempts[response->attempt_count - 1];
+    return !retry_is_retryable(last->retry_class);
+}
+
+/* Only failures the server may accept later are queued; a rejected request would fail again */
+static void
+queue_failed_upload(const command_args_t *args,
+                    const host_config_t *host,
+                    const char *file_path,
+                    size_t size,
+                    const upload_response_t *response)
+{
+    if (!args->queue_on_failure || !response || response->attempt_count == 0 ||
+        upload_was_rejected(response))
+    {
+        return;
+    }
+
+    time_t next_attempt = time(NULL) + QUEUE_RETRY_DELAY_MS / 1000;
+    if (db_queue_add(file_path, host->name, size, next_attempt, response->error_message))
+    {
+        print_info("  Queued for retry; run 'hostman flush' to upload it later\n");
+    }
+}
+
+static bool
+batch_record_failure(batch_state_t *state,
+                     int index,
+                     const char *file_path,
+                     const char *filename,
+                     const char *error)
+{
+    batch_journal(state, file_path, JOURNAL_FAILED, NULL, error);
+    batch_list_add(&state->failures, index, filename, error ? error : "Unknown error");
+    state->failure_count++;
+
+    if (!state->args->continue_on_error)
+    {
+        if (!state->stopped)
+        {
+            print_error("\nStopping due to error (use --continue-on-error to continue)\n");
+            state->stopped = true;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+batch_handle_response(batch_state_t *state,
+                      int index,
+                      const char *file_path,
+                      const char *filename,
+                      size_t size,
+                      upload_response_t *response)
+{
+    if (!response)
+    {
+        print_error("        Failed: Network error\n");
+        return batch_record_failure(state, index, file_path, filename, "Network error");
+    }
+
+    if (!response->success)
+    {
+        print_error("        Failed: %s\n", response->error_message);
+        queue_failed_upload(state->args, state->host, file_path, size, response);
+        return batch_record_failure(
+          state, index, file_path, filename, response->error_message);
+    }
+
+    batch_list_add(&state->successes, index, response->url, NULL);
+    state->success_count++;
+
+    if (response->deduplicated)
+    {
+        print_success("        Already uploaded: %s\n", response->url);
+    }
+    else
+    {
+        print_success("        Success: %s\n", response->url);
+        db_add_upload(state->host->name,
+                      file_path,
+                      response->url,
+                      response->deletion_url,
+                      filename,
+                      size,
+                      response->content_hash,
+                      &response->timing);
+    }
+
+    /* Journaled after the history row, which may share its transaction, so a file the journal
+     * marks done is never missing from history */
+    batch_journal(state, file_path, JOURNAL_DONE, response->url, NULL);
+    return true;
+}
+
+static upload_response_t *
+find_upload_by_hash(host_config_t *host, const char *file_path, const char *content_hash)
+{
+    upload_record_t *record = db_find_upload_by_hash(host->name, content_hash);
+    if (!record)
+    {
+        return NULL;
+    }
+
+    upload_response_t *response = calloc(1, sizeof(upload_response_t));
+    if (response)
+    {
+        response->success = true;
+        response->deduplicated = true;
+        response->url = strdup(record->remote_url);
+        response->deletion_url = record->deletion_url ? strdup(record->deletion_url) : NULL;
+        snprintf(response->content_hash, sizeof(response->content_hash), "%s", content_hash);
+        log_info("Skipping %s: identical content already uploaded as %s", file_path, response->url);
+    }
+
+    db_free_record(record);
+
+    return response;
+}
+
+static upload_response_t *
+find_existing_upload(host_config_t *host, const char *file_path)
+{
+    char content_hash[CONTENT_HASH_HEX_LEN + 1];
+    if (!content_hash_file(file_path, content_hash))
+    {
+        return NULL;
+    }
+
+    return find_upload_by_hash(host, file_path, content_hash);
+}
+
+static void
+batch_announce(const batch_state_t *state, int index, const char *filename, size_t size)
+{
+    char size_str[32];
+    char label[32];
+    format_file_size(size, size_str, sizeof(size_str));
+    batch_label(state, index, label, sizeof(label));
+    print_info("  %s Uploading %s (%s)...\n", label, filename, size_str);
+}
+
+static bool
+batch_upload_done(void *userdata, int index, const char *file_path, upload_response_t *response)
+{
+    batch_state_t *state = (batch_state_t *)userdata;
+    char *filename = get_filename_from_path(file_path);
+
+    struct stat file_stat;
+    size_t size = stat(file_path, &file_stat) == 0 ? (size_t)file_stat.st_size : 0;
+
+    if (index != state->announced)
+    {
+        batch_announce(state, index, filename, size);
+    }
+
+    bool keep_going = batch_handle_response(state, index, file_path, filename, size, response);
+    free(filename);
+
+    return keep_going;
+}
+
+/* Hashes every file before concurrent uploads start, so hashing never stalls transfers */
+static upload_response_t **
+find_existing_uploads(command_args_t *args, host_config_t *host)
+{
+    upload_response_t **existing = calloc(args->file_count, sizeof(upload_response_t *));
+    if (!existing)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < args->file_count; i++)
+    {
+        existing[i] = find_existing_upload(host, args->file_paths[i]);
+    }
+
+    return existing;
+}
+
+static void
+free_existing_uploads(upload_response_t **existing, int count)
+{
+    if (!existing)
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        network_free_response(existing[i]);
+    }
+    free(existing);
+}
+
+static bool
+batch_missing_file(batch_state_t *state, int index, const char *file_path)
+{
+    char label[32];
+    char *filename = get_filename_from_path(file_path);
+    batch_label(state, index, label, sizeof(label));
+    print_error("  %s %s - File not found\n", label, filename);
+    bool keep_going = batch_record_failure(state, index, file_path, filename, "File not found");
+    free(filename);
+
+    return keep_going;
+}
+
+static const char *
+batch_next_walked_file(batch_state_t *state, int *index)
+{
+    free(state->walk_path);
+    state->walk_path = NULL;
+
+    dir_walk_entry_t entry;
+    while (!state->stopped && dir_walk_next(state->walk, &entry))
+    {
+        int i = state->next_file++;
+
+        /* Unlike walked files, listed ones may not exist */
+        struct stat file_stat;
+        if (state->files_from && stat(entry.path, &file_stat) != 0)
+        {
+            bool keep_going = batch_missing_file(state, i, entry.path);
+            free(entry.path);
+            if (!keep_going)
+            {
+                break;
+            }
+            continue;
+        }
+
+        upload_response_t *existing = find_journaled_upload(state, entry.path);
+        if (!existing && entry.hashed)
+        {
+            existing = find_upload_by_hash(state->host, entry.path, entry.content_hash);
+        }
+        if (!existing)
+        {
+            state->walk_path = entry.path;
+            *index = i;
+            return entry.path;
+        }
+
+        batch_upload_done(state, i, entry.path, existing);
+        network_free_response(existing);
+        free(entry.path);
+    }
+
+    return NULL;
+}
+
+static const char *
+batch_next_source_file(batch_state_t *state, int *index)
+{
+    command_args_t *args = state->args;
+
+    if (state->walk)
+    {
+        return batch_next_walked_file(state, index);
+    }
+
+    while (state->next_file < args->file_count)
+    {
+        int i = state->next_file++;
+        const char *current_file = args->file_paths[i];
+        struct stat file_stat;
+
+        if (stat(current_file, &file_stat) == 0)
+        {
+            upload_response_t *existing = find_journaled_upload(state, current_file);
+            if (state->existing)
+            {
+                if (!existing)
+                {
+                    existing = state->existing[i];
+                }
+                else
+                {
+                    network_free_response(state->existing[i]);
+                }
+                state->existing[i] = NULL;
+            }
+            if (!existing)
+            {
+                *index = i;
+                return current_file;
+            }
+
+            batch_upload_done(state, i, current_file, existing);
+            network_free_response(existing);
+            continue;
+        }
+
+        if (!batch_missing_file(state, i, current_file))
+        {
+            state->next_file = args->file_count;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static const char *
+batch_next_file(void *userdata, int *index)
+{
+    batch_state_t *state = (batch_state_t *)userdata;
+
+    if (batch_interrupted)
+    {
+        if (!state->stopped)
+        {
+            print_error("\nInterrupted; finishing uploads in progress (Ctrl+C again to abort)\n");
+            state->stopped = true;
+            db_batch_sync();
+        }
+        return NULL;
+    }
+
+    const char *file_path = batch_next_source_file(state, index);
+    if (!file_path)
+    {
+        return NULL;
+    }
+
+    batch_journal(state, file_path, JOURNAL_IN_FLIGHT, NULL, NULL);
+
+    /* One file at a time shows a progress bar, which needs the file named above it; with more,
+     * each file is named once it finishes so lines from different files do not interleave */
+    if (state->args->jobs <= 1)
+    {
+        char *filename = get_filename_from_path(file_path);
+        struct stat file_stat;
+        batch_announce(state,
+                       *index,
+                       filename ? filename : file_path,
+                       stat(file_path, &file_stat) == 0 ? (size_t)file_stat.st_size : 0);
+        free(filename);
+        state->announced = *index;
+    }
+
+    return file_path;
+}
+
+static struct sigaction batch_old_int;
+static struct sigaction batch_old_term;
+
+/* Journals the batch, groups its database writes into few transactions, and lets the first
+ * Ctrl+C stop it at a clean checkpoint */
+static void
+batch_begin(batch_state_t *state)
+{
+    command_args_t *args = state->args;
+
+    db_batch_begin();
+
+    if (args->resume_batch > 0)
+    {
+        state->journaled = true;
+        state->batch_id = args->resume_batch;
+    }
+    else
+    {
+        state->journaled = db_journal_begin(state->host->name, &state->batch_id);
+        if (!state->journaled)
+        {
+            log_warn("Batch journal unavailable; this batch cannot be resumed");
+        }
+    }
+
+    if (state->journaled)
+    {
+        for (int i = 0; i < args->file_count; i++)
+        {
+            char *key = journal_key(args->file_paths[i]);
+            if (key)
+            {
+                db_journal_add(key);
+                free(key);
+            }
+        }
+        db_batch_sync();
+    }
+
+    batch_interrupted = 0;
+    if (cli_resident)
+    {
+        return;
+    }
+
+    struct sigaction action = { .sa_handler = handle_batch_interrupt,
+                                .sa_flags = (int)SA_RESETHAND };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &batch_old_int);
+    sigaction(SIGTERM, &action, &batch_old_term);
+}
+
+static void
+batch_end(batch_state_t *state, bool complete)
+{
+    if (!cli_resident)
+    {
+        sigaction(SIGINT, &batch_old_int, NULL);
+        sigaction(SIGTERM, &batch_old_term, NULL);
+    }
+    batch_interrupted = 0;
+
+    if (state->journaled)
+    {
+        db_journal_end(complete);
+    }
+    db_batch_end();
+}
+
+static int
+resume_journaled_batch(command_args_t *args)
+{
+    char *host_name = NULL;
+    if (!db_journal_resume(args->resume_batch, &host_name))
+    {
+        print_error("Error: No unfinished batch with ID %d\n", args->resume_batch);
+        return EXIT_INVALID_ARGS;
+    }
+
+    if (args->host_name && strcmp(args->host_name, host_name) != 0)
+    {
+        print_error(
+          "Error: Batch %d was uploaded to host '%s'\n", args->resume_batch, host_name);
+        free(host_name);
+        db_journal_end(false);
+        return EXIT_INVALID_ARGS;
+    }
+
+    free(args->host_name);
+    args->host_name = host_name;
+
+    /* Without a source to re-read, the journal's unfinished entries are the batch */
+    if (args->file_count == 0 && !args->directory && !args->files_from)
+    {
+        args->file_paths = db_journal_get_unfinished(&args->file_count);
+        if (args->file_count > 0)
+        {
+            args->file_path = strdup(args->file_paths[0]);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static upload_response_t *
+upload_from_stdin(network_session_t *session, const char *name, host_config_t *host)
+{
+    upload_source_t *source = upload_source_open_fd(STDIN_FILENO);
+    if (!source)
+    {
+        return NULL;
+    }
+
+    upload_response_t *response = network_upload_source(session, source, name, host);
+    upload_source_close(source);
+
+    return response;
+}
+
+static int
+print_host_stats(const command_args_t *args)
+{
+    int count = 0;
+    host_upload_stats_t *stats = NULL;
+    if (!db_get_host_stats(&stats, &count))
+    {
+        print_error("Error: Failed to read upload history\n");
+        return EXIT_FAILURE;
+    }
+
+    print_section_header("UPLOAD STATISTICS");
+    printf("\033[1m%-20s %-10s %-12s %s\033[0m\n", "Host", "Uploads", "Total size", "Last upload");
+    printf("%-20s %-10s %-12s %s\n",
+           "--------------------",
+           "----------",
+           "------------",
+           "--------------------");
+
+    int shown = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (args->host_name && strcmp(args->host_name, stats[i].host_name) != 0)
+        {
+            continue;
+        }
+
+        char size_str[32];
+        format_file_size((size_t)stats[i].total_bytes, size_str, sizeof(size_str));
+
+        char time_str[21];
+        struct tm *tm_info = localtime(&stats[i].last_upload);
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+
+        printf("%-20s %-10d %-12s %s\n",
+               stats[i].host_name,
+               stats[i].upload_count,
+               size_str,
+               time_str);
+        shown++;
+    }
+
+    if (shown == 0)
+    {
+        print_info("No upload records found.\n");
+    }
+
+    db_free_host_stats(stats, count);
+    return EXIT_SUCCESS;
+}
+
+static void
+format_duration_us(long long us, char *buffer, size_t buffer_size)
+{
+    if (us < 1000)
+    {
+        snprintf(buffer, buffer_size, "%lld us", us);
+    }
+    else if (us < 10000000)
+    {
+        snprintf(buffer, buffer_size, "%.1f ms", us / 1000.0);
+    }
+    else
+    {
+        snprintf(buffer, buffer_size, "%.2f s", us / 1000000.0);
+    }
+}
+
+static void
+format_speed(long long bytes_per_second, char *buffer, size_t buffer_size)
+{
+    char size_str[32];
+    format_file_size((size_t)bytes_per_second, size_str, sizeof(size_str));
+    snprintf(buffer, buffer_size, "%s/s", size_str);
+}
+
+static int
+print_latency_stats(const command_args_t *args)
+{
+    printf("\n");
+    print_section_header("TRANSFER LATENCY");
+    if (args->host_name)
+    {
+        print_info("Host: %s\n", args->host_name);
+    }
+
+    int samples = 0;
+    long long *values = db_get_timing_samples(args->host_name, TIMING_PHASE_TOTAL, &samples);
+    free(values);
+    if (samples == 0)
+    {
+        print_info("No uploads with timing data recorded yet.\n");
+        return EXIT_SUCCESS;
+    }
+
+    print_info("Samples: %d\n\n", samples);
+    printf("\033[1m%-16s %-12s %-12s %s\033[0m\n", "Phase", "p50", "p90", "p99");
+    printf("%-16s %-12s %-12s %s\n",
+           "----------------",
+           "------------",
+           "------------",
+           "------------");
+
+    for (int phase = 0; phase < TIMING_PHASE_COUNT; phase++)
+    {
+        int count = 0;
+        values = db_get_timing_samples(args->host_name, (timing_phase_t)phase, &count);
+        if (!values)
+        {
+            continue;
+        }
+
+        char p50[16], p90[16], p99[16];
+        format_duration_us(timing_percentile(values, count, 50), p50, sizeof(p50));
+        format_duration_us(timing_percentile(values, count, 90), p90, sizeof(p90));
+        format_duration_us(timing_percentile(values, count, 99), p99, sizeof(p99));
+        printf("%-16s %-12s %-12s %s\n", timing_phase_name((timing_phase_t)phase), p50, p90, p99);
+        free(values);
+    }
+
+    int count = 0;
+    values = db_get_speed_samples(args->host_name, &count);
+    if (values)
+    {
+        /* For speed the slow tail is the low end, so it gets its own p10/p1 header */
+        char p50[40], p10[40], p1[40];
+        format_speed(timing_percentile(values, count, 50), p50, sizeof(p50));
+        format_speed(timing_percentile(values, count, 10), p10, sizeof(p10));
+        format_speed(timing_percentile(values, count, 1), p1, sizeof(p1));
+        printf("\n\033[1m%-16s %-12s %-12s %s\033[0m\n", "Throughput", "p50", "p10", "p1");
+        printf("%-16s %-12s %-12s %s\n",
+               "----------------",
+               "------------",
+               "------------",
+               "------------");
+        printf("%-16s %-12s %-12s %s\n", "Upload speed", p50, p10, p1);
+        free(values);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* --limit-rate on the command line wins over the host's limit_rate setting */
+static bool
+apply_limit_rate(const command_args_t *args, const host_config_t *host)
+{
+    curl_off_t limit_rate = (curl_off_t)args->limit_rate;
+    if (limit_rate == 0 && host->limit_rate && !rate_limit_parse(host->limit_rate, &limit_rate))
+    {
+        print_error("Error: Invalid limit_rate '%s' for host '%s'\n", host->limit_rate, host->name);
+        return false;
+    }
+    rate_limit_set(limit_rate);
+    return true;
+}
+
+/* Loads the configuration and resolves the upload host, applying its rate limit */
+static int
+load_upload_host(command_args_t *args, hostman_config_t **config_out, host_config_t **host_out)
+{
+    hostman_config_t *config = config_load();
+    if (!config)
+    {
+        log_error("Failed to load configuration");
+        return EXIT_CONFIG_ERROR;
+    }
+
+    set_clipboard_override(config->clipboard_manager);
+    network_set_insecure(args->insecure);
+
+    host_config_t *host = NULL;
+    if (args->host_name)
+    {
+        host = config_get_host(args->host_name);
+        if (!host)
+        {
+            print_error("Error: Host '%s' not found\n", args->host_name);
+            config_free(config);
+            return EXIT_INVALID_ARGS;
+        }
+    }
+    else
+    {
+        host = config_get_default_host();
+        if (!host)
+        {
+            print_error("Error: No default host configured\n");
+            config_free(config);
+            return EXIT_CONFIG_ERROR;
+        }
+    }
+
+    if (!apply_limit_rate(args, host))
+    {
+        config_free(config);
+        return EXIT_CONFIG_ERROR;
+    }
+
+    *config_out = config;
+    *host_out = host;
+    return EXIT_SUCCESS;
+}
+
+typedef struct
+{
+    queue_entry_t *entries;
+    int next;
+    int end;
+    const host_config_t *host;
+    int uploaded;
+    int failed;
+    int dropped;
+} flush_state_t;
+
+static const char *
+flush_next_file(void *userdata, int *index)
+{
+    flush_state_t *state = (flush_state_t *)userdata;
+
+    while (state->next < state->end)
+    {
+        queue_entry_t *entry = &state->entries[state->next];
+        struct stat file_stat;
+
+        if (stat(entry->local_path, &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+        {
+            *index = state->next++;
+            return entry->local_path;
+        }
+
+        print_error("  %s no longer exists; dropped from the queue\n", entry->local_path);
+        db_queue_remove(entry->id);
+        state->dropped++;
+        state->next++;
+    }
+
+    return NULL;
+}
+
+static bool
+flush_upload_done(void *userdata, int index, const char *file_path, upload_response_t *response)
+{
+    flush_state_t *state = (flush_state_t *)userdata;
+    queue_entry_t *entry = &state->entries[index];
+    char *filename = get_filename_from_path(file_path);
+
+    if (response && response->success)
+    {
+        struct stat file_stat;
+        size_t size = stat(file_path, &file_stat) == 0 ? (size_t)file_stat.st_size : entry->size;
+
+        print_success("  %s: %s\n", filename, response->url);
+        db_add_upload(state->host->name,
+                      file_path,
+                      response->url,
+                      response->deletion_url,
+                      filename,
+                      size,
+                      response->content_hash,
+                      &response->timing);
+        db_queue_remove(entry->id);
+        state->uploaded++;
+    }
+    else if (upload_was_rejected(response))
+    {
+        const char *error = response->error_message ? response->error_message : "Rejected";
+        print_error("  %s: %s; dropped from the queue\n", filename, error);
+        db_queue_remove(entry->id);
+        state->dropped++;
+    }
+    else
+    {
+        const char *error =
+          response && response->error_message ? response->error_message : "Network error";
+        retry_policy_t policy = { .base_delay_ms = QUEUE_RETRY_DELAY_MS,
+                                  .max_delay_ms = QUEUE_MAX_RETRY_DELAY_MS };
+        long delay_ms = retry_backoff_ms(&policy, entry->attempts + 1, 0);
+
+        print_error("  %s: %s (retry in %ld s)\n", filename, error, delay_ms / 1000);
+        db_queue_defer(entry->id, time(NULL) + delay_ms / 1000, error);
+        state->failed++;
+    }
+
+    free(filename);
+    return true;
+}
+
+static int
+flush_queue(command_args_t *args)
+{
+    hostman_config_t *config = config_load();
+    if (!config)
+    {
+        log_error("Failed to load configuration");
+        return EXIT_CONFIG_ERROR;
+    }
+
+    network_set_insecure(args->insecure);
+
+    int count = 0;
+    queue_entry_t *entries = db_queue_get(!args->flush_all, time(NULL), &count);
+    if (count == 0)
+    {
+        int waiting = 0;
+        db_free_queue_entries(db_queue_get(false, 0, &waiting), waiting);
+        if (waiting > 0)
+        {
+            print_info("No queued uploads are due; %d waiting (use --all to retry them now)\n",
+                       waiting);
+        }
+        else
+        {
+            print_info("The upload queue is empty\n");
+        }
+        db_free_queue_entries(entries, count);
+        config_free(config);
+        return EXIT_SUCCESS;
+    }
+
+    print_section_header("FLUSH");
+    print_info("  Retrying %d queued upload(s)\n\n", count);
+
+    network_session_t *session = network_session_create();
+    flush_state_t state = { .entries = entries };
+    bool started = true;
+
+    for (int start = 0; start < count && started; start = state.end)
+    {
+        const char *host_name = entries[start].host_name;
+        state.next = start;
+        state.end = start;
+        while (state.end < count && strcmp(entries[state.end].host_name, host_name) == 0)
+        {
+            state.end++;
+        }
+
+        /* A host removed from the config will not come back by waiting */
+        host_config_t *host = config_get_host(host_name);
+        if (!host)
+        {
+            print_error("  Host '%s' not found; dropped %d queued upload(s)\n",
+                        host_name,
+                        state.end - start);
+            for (int i = start; i < state.end; i++)
+            {
+                db_queue_remove(entries[i].id);
+            }
+            state.dropped += state.end - start;
+            continue;
+        }
+
+        if (!apply_limit_rate(args, host))
+        {
+            state.failed += state.end - start;
+            continue;
+        }
+
+        state.host = host;
+        db_batch_begin();
+        started = network_upload_batch(
+          session, host, args->jobs, NULL, flush_next_file, flush_upload_done, &state);
+        db_batch_end();
+    }
+
+    network_session_free(session);
+    db_free_queue_entries(entries, count);
+    config_free(config);
+
+    if (!started)
+    {
+        print_error("Error: Failed to start concurrent uploads\n");
+        return EXIT_NETWORK_ERROR;
+    }
+
+    printf("\n");
+    print_section_header("FLUSH SUMMARY");
+    print_success("  Uploaded:     %d\n", state.uploaded);
+    print_info("  Still queued: %d\n", state.failed);
+    if (state.dropped > 0)
+    {
+        print_info("  Dropped:      %d\n", state.dropped);
+    }
+
+    if (state.uploaded > 0)
+    {
+        char body[128];
+        snprintf(body, sizeof(body), "%d queued file(s) uploaded", state.uploaded);
+        notify_send("Upload queue flushed", body);
+    }
+
+    return state.failed > 0 ? EXIT_NETWORK_ERROR : EXIT_SUCCESS;
+}
+
+static void
+print_uploads_json(upload_record_t **records, int count, const char *next_cursor)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON *uploads = cJSON_AddArrayToObject(json, "uploads");
+
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *upload = cJSON_CreateObject();
+        cJSON_AddNumberToObject(upload, "id", records[i]->id);
+        cJSON_AddNumberToObject(upload, "timestamp", (double)records[i]->timestamp);
+        cJSON_AddStringToObject(upload, "host", records[i]->host_name);
+        cJSON_AddStringToObject(upload, "filename", records[i]->filename);
+        cJSON_AddStringToObject(upload, "local_path", records[i]->local_path);
+        cJSON_AddNumberToObject(upload, "size", (double)records[i]->size);
+        cJSON_AddStringToObject(upload, "url", records[i]->remote_url);
+        if (records[i]->deletion_url)
+        {
+            cJSON_AddStringToObject(upload, "deletion_url", records[i]->deletion_url);
+        }
+        cJSON_AddItemToArray(uploads, upload);
+    }
+
+    if (next_cursor[0] != '\0')
+    {
+        cJSON_AddStringToObject(json, "next_cursor", next_cursor);
+    }
+    else
+    {
+        cJSON_AddNullToObject(json, "next_cursor");
+    }
+
+    char *text = cJSON_Print(json);
+    if (text)
+    {
+        printf("%s\n", text);
+        free(text);
+    }
+    cJSON_Delete(json);
+}
+
+/* Looks up the uploads named on the command line, reporting the IDs that have no record */
+static upload_record_t **
+find_upload_records(const command_args_t *args, int *count)
+{
+    upload_record_t **records =
+      db_get_uploads_by_ids(args->upload_ids, args->upload_id_count, count);
+    if (!records)
+    {
+        print_error("Error: Failed to retrieve upload records\n");
+        return NULL;
+    }
+
+    /* Both lists are in ascending ID order */
+    int found = 0;
+    for (int i = 0; i < args->upload_id_count; i++)
+    {
+        if (found < *count && records[found]->id == args->upload_ids[i])
+        {
+            found++;
+        }
+        else
+        {
+            print_error("Error: No upload record found with ID %d\n", args->upload_ids[i]);
+        }
+    }
+
+    if (*count == 0)
+    {
+        db_free_records(records, *count);
+        return NULL;
+    }
+
+    return records;
+}
+
+static void
+print_upload_record(const upload_record_t *record, bool detailed, bool deletion_url)
+{
+    char time_str[21];
+    struct tm *tm_info = localtime(&record->timestamp);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+
+    char size_str[32];
+    format_file_size(record->size, size_str, sizeof(size_str));
+
+    if (!detailed)
+    {
+        print_info("  %-6d %s  %-15s %s (%s)\n",
+                   record->id,
+                   time_str,
+                   record->host_name,
+                   record->filename,
+                   size_str);
+        return;
+    }
+
+    print_info("ID: %d\n", record->id);
+    print_info("Date: %s\n", time_str);
+    print_info("Host: %s\n", record->host_name);
+    print_info("File: %s (%s)\n", record->filename, size_str);
+    print_info("URL: %s\n", record->remote_url);
+    if (deletion_url)
+    {
+        print_info("Deletion URL: %s\n", record->deletion_url);
+    }
+}
+
+/* Returns whether the user answered yes; a failed read sets *status to EXIT_FAILURE */
+static bool
+confirm_action(const char *question, int *status)
+{
+    char response[10];
+    printf("%s [y/N]: ", question);
+    if (fgets(response, sizeof(response), stdin) == NULL)
+    {
+        print_error("Error reading response\n");
+        *status = EXIT_FAILURE;
+        return false;
+    }
+
+    if (response[0] != 'y' && response[0] != 'Y')
+    {
+        print_info("Delete operation cancelled.\n");
+        return false;
+    }
+    return true;
+}
+
+static int
+delete_remote_file(CURL *curl, const upload_record_t *record, bool insecure)
+{
+    size_t max_response_size = DEFAULT_MAX_RESPONSE_SIZE;
+    host_config_t *record_host = config_get_host(record->host_name);
+    if (record_host && !network_max_response_size(record_host, &max_response_size))
+    {
+        print_error("Error: Invalid max_response_size '%s' for host '%s'\n",
+                    record_host->max_response_size,
+                    record_host->name);
+        return EXIT_CONFIG_ERROR;
+    }
+
+    response_buffer_t response_data;
+    response_buffer_init(&response_data, max_response_size);
+
+    print_info("Sending deletion request for upload %d...\n", record->id);
+
+    curl_easy_reset(curl);
+    curl_easy_setopt(curl, CURLOPT_URL, record->deletion_url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    response_buffer_attach(&response_data, curl);
+
+    if (insecure)
+    {
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+    else
+    {
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    }
+
+    CURLcode res = curl_easy_perform(curl);
+
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if (res != CURLE_OK)
+    {
+        if (response_buffer_exceeded(&response_data, res))
+        {
+            print_error("Error: Response exceeded the maximum size of %zu bytes\n",
+                        response_data.max_size);
+        }
+        else
+        {
+            print_error("Error: %s\n", curl_easy_strerror(res));
+        }
+        response_buffer_free(&response_data);
+        return EXIT_NETWORK_ERROR;
+    }
+
+    bool success = (http_code >= 200 && http_code < 300);
+
+    if (success)
+    {
+        print_success("File deleted successfully from the remote host!\n");
+    }
+    else
+    {
+        print_error("Failed to delete file. HTTP status code: %ld\n", http_code);
+        if (response_data.data && response_data.size > 0)
+        {
+            print_info("Server response: %s\n", response_data.data);
+        }
+        print_info("You can try visiting the deletion URL in your browser: %s\n",
+                   record->deletion_url);
+    }
+
+    response_buffer_free(&response_data);
+    return success ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
+}
+
+int
+execute_command(command_args_t *args)
+{
+    switch (args->type)
+    {
+        case CMD_UPLOAD:
+        {
+            if (args->resume_batch > 0)
+            {
+                int status = resume_journaled_batch(args);
+                if (status != EXIT_SUCCESS)
+                {
+                    return status;
+                }
+            }
+
+            hostman_config_t *config = NULL;
+            host_config_t *host = NULL;
+            int status = load_upload_host(args, &config, &host);
+            if (status != EXIT_SUCCESS)
+            {
+                return status;
+            }
+
+            /* Directory walks and file lists stream paths straight into the batch driver */
+            bool walking = args->directory != NULL;
+            bool streaming = walking || args->files_from != NULL;
+            if (args->resume_batch > 0 && !streaming && args->file_count == 0)
+            {
+                print_success("Batch %d has no files left to upload\n", args->resume_batch);
+                db_journal_end(true);
+                config_free(config);
+                return EXIT_SUCCESS;
+            }
+
+            network_session_t *session = network_session_create();
+            bool is_batch = streaming || args->file_count > 1 || args->resume_batch > 0;
+            bool interrupted = false;
+            /* Object store batches go through the driver so it can refuse duplicate keys */
+            bool object_store = request_body_format_from_string(host->request_body_format) ==
+                                REQUEST_BODY_S3;
+            bool concurrent = streaming || (is_batch && (args->jobs > 1 || object_store));
+            /* Hashes are only read back from history by --dedupe */
+            network_upload_options_t upload_options = { .root = walking ? args->directory : NULL,
+                                                        .hash_contents = args->dedupe,
+                                                        .show_progress = args->jobs <= 1 };
+            /* Streamed batches may be arbitrarily long, so their summary is capped */
+            int list_limit = streaming ? BATCH_LIST_LIMIT : 0;
+            batch_state_t state = { .args = args,
+                                    .host = host,
+                                    .total = streaming ? -1 : args->file_count,
+                                    .announced = -1,
+                                    .successes = { .limit = list_limit },
+                                    .failures = { .limit = list_limit } };
+
+            if (args->files_from)
             {
-                log_error("Failed to load configuration");
-                return EXIT_CONFIG_ERROR;
+                bool from_stdin = strcmp(args->files_from, "-") == 0;
+                state.files_from = from_stdin ? stdin : fopen(args->files_from, "r");
+                if (!state.files_from)
+                {
+                    print_error(
+                      "Error: Cannot open '%s': %s\n", args->files_from, strerror(errno));
+                    network_session_free(session);
+                    config_free(config);
+                    return EXIT_FILE_ERROR;
+                }
             }
 
-            set_clipboard_override(config->clipboard_manager);
-            network_set_insecure(args->insecure);
+            if (is_batch)
+            {
+                batch_begin(&state);
+                print_section_header("BATCH UPLOAD");
+                if (state.journaled)
+                {
+                    print_info("  Batch ID: %d\n", state.batch_id);
+                }
+                if (walking)
+                {
+                    print_info("  Uploading files from %s to %s\n\n", args->directory, host->name);
+                }
+                else if (streaming)
+                {
+                    print_info("  Uploading listed files to %s\n\n", host->name);
+                }
+                else
+                {
+                    print_info("  Uploading %d files to %s\n\n", args->file_count, host->name);
+                }
+            }
 
-            host_config_t *host = NULL;
-            if (args->host_name)
+            /* Walks and file lists are read, and hashed for --dedupe, on threads of their own so
+             * neither stalls transfers */
+            dir_walk_options_t walk_options = { .recursive = args->recursive,
+                                                .hash_contents = args->dedupe,
+                                                .threads = DIR_WALK_THREADS,
+                                                .include_patterns = args->include_patterns,
+                                                .include_count = args->include_count,
+                                                .exclude_patterns = args->exclude_patterns,
+                                                .exclude_count = args->exclude_count };
+            if (state.files_from)
             {
-                host = config_get_host(args->host_name);
-                if (!host)
+                state.walk = dir_walk_list(
+                  fileno(state.files_from), args->null_separated ? '\0' : '\n', &walk_options);
+                if (!state.walk)
                 {
-                    print_error("Error: Host '%s' not found\n", args->host_name);
+                    print_error("Error: Cannot read the file list\n");
+                    if (state.files_from != stdin)
+                    {
+                        fclose(state.files_from);
+                    }
+                    batch_end(&state, args->resume_batch == 0);
+                    batch_free(&state);
+                    network_session_free(session);
                     config_free(config);
-                    return EXIT_INVALID_ARGS;
+                    return EXIT_FILE_ERROR;
                 }
             }
-            else
+            else if (walking)
             {
-                host = config_get_default_host();
-                if (!host)
+                state.walk = dir_walk_start(args->directory, &walk_options);
+                if (!state.walk)
                 {
-                    print_error("Error: No default host configured\n");
+                    print_error("Error: Cannot read directory '%s'\n", args->directory);
+                    batch_end(&state, args->resume_batch == 0);
+                    batch_free(&state);
+                    network_session_free(session);
                     config_free(config);
-                    return EXIT_CONFIG_ERROR;
+                    return EXIT_FILE_ERROR;
                 }
             }
+            else if (concurrent && !streaming && args->dedupe)
+            {
+                state.existing = find_existing_uploads(args, host);
+            }
 
-            bool is_batch = args->file_count > 1;
-            int success_count = 0;
-            int failure_count = 0;
-            char **success_urls = NULL;
-            char **failed_files = NULL;
-            char **failed_errors = NULL;
+            bool batch_started = !concurrent || network_upload_batch(session,
+                                                                     host,
+                                                                     args->jobs,
+                                                                     &upload_options,
+                                                                     batch_next_file,
+                                                                     batch_upload_done,
+                                                                     &state);
+            free_existing_uploads(state.existing, args->file_count);
+            if (state.files_from && dir_walk_list_error(state.walk) != 0)
+            {
+                print_error("Error: Failed to read the file list: %s\n",
+                            strerror(dir_walk_list_error(state.walk)));
+            }
+            dir_walk_free(state.walk);
+            if (state.files_from && state.files_from != stdin)
+            {
+                fclose(state.files_from);
+            }
+            if (streaming)
+            {
+                state.total = state.next_file;
+            }
 
-            if (is_batch)
+            if (!batch_started)
             {
-                success_urls = malloc(args->file_count * sizeof(char *));
-                failed_files = malloc(args->file_count * sizeof(char *));
-                failed_errors = malloc(args->file_count * sizeof(char *));
+                print_error("Error: Failed to start concurrent uploads\n");
+                batch_end(&state, args->resume_batch == 0);
+                batch_free(&state);
+                network_session_free(session);
+                config_free(config);
+                return EXIT_NETWORK_ERROR;
+            }
 
-                if (!success_urls || !failed_files || !failed_errors)
+            if (streaming && state.total == 0)
+            {
+                if (walking)
                 {
-                    print_error("Error: Out of memory for batch upload tracking\n");
-                    free(success_urls);
-                    free(failed_files);
-                    free(failed_errors);
-                    config_free(config);
-                    return EXIT_FAILURE;
+                    print_error("Error: No files found in directory '%s'\n", args->directory);
                 }
-
-                print_section_header("BATCH UPLOAD");
-                print_info("  Uploading %d files to %s\n\n", args->file_count, host->name);
+                else
+                {
+                    const char *source =
+                      strcmp(args->files_from, "-") == 0 ? "stdin" : args->files_from;
+                    print_error("Error: No file paths found in %s\n", source);
+                }
+                batch_end(&state, args->resume_batch == 0);
+                batch_free(&state);
+                network_session_free(session);
+                config_free(config);
+                return EXIT_FILE_ERROR;
             }
 
-            for (int i = 0; i < args->file_count; i++)
+            for (int i = 0; i < args->file_count && !concurrent && !batch_interrupted; i++)
             {
                 const char *current_file = args->file_paths[i];
-                char *filename = get_filename_from_path(current_file);
-                struct stat file_stat;
+                char *filename = args->from_stdin ? strdup(args->stdin_name)
+                                                  : get_filename_from_path(current_file);
+                struct stat file_stat = { 0 };
 
-                if (stat(current_file, &file_stat) != 0)
+                if (!args->from_stdin && stat(current_file, &file_stat) != 0)
                 {
                     if (is_batch)
                     {
                         print_error(
                           "  [%d/%d] %s - File not found\n", i + 1, args->file_count, filename);
-                        failed_files[failure_count] = strdup(filename);
-                        failed_errors[failure_count] = strdup("File not found");
-                        failure_count++;
+                        bool keep_going =
+                          batch_record_failure(&state, i, current_file, filename, "File not found");
                         free(filename);
 
-                        if (!args->continue_on_error)
+                        if (!keep_going)
                         {
-                            print_error(
-                              "\nStopping due to error (use --continue-on-error to continue)\n");
                             break;
                         }
                         continue;
@@ -1263,6 +3340,7 @@ execute_command(command_args_t *args)
                     {
                         print_error("Error: File not found: %s\n", current_file);
                         free(filename);
+                        network_session_free(session);
                         config_free(config);
                         return EXIT_FILE_ERROR;
                     }
@@ -1279,203 +3357,209 @@ execute_command(command_args_t *args)
                                size_str);
                 }
 
-                upload_response_t *response = network_upload_file(current_file, host);
-
-                if (!response)
+                upload_response_t *response = NULL;
+                if (args->from_stdin)
                 {
-                    if (is_batch)
+                    response = upload_from_stdin(session, filename, host);
+                }
+                else
+                {
+                    response = find_journaled_upload(&state, current_file);
+                    if (!response && args->dedupe)
                     {
-                        print_error("        Failed: Network error\n");
-                        failed_files[failure_count] = strdup(filename);
-                        failed_errors[failure_count] = strdup("Network error");
-                        failure_count++;
-                        free(filename);
-
-                        if (!args->continue_on_error)
-                        {
-                            print_error(
-                              "\nStopping due to error (use --continue-on-error to continue)\n");
-                            break;
-                        }
-                        continue;
+                        response = find_existing_upload(host, current_file);
                     }
-                    else
+                    if (!response)
                     {
-                        print_error("Error: Upload failed\n");
-                        free(filename);
-                        config_free(config);
-                        return EXIT_NETWORK_ERROR;
+                        batch_journal(&state, current_file, JOURNAL_IN_FLIGHT, NULL, NULL);
+                        response = network_upload_file(
+                          session, current_file, host, &upload_options);
                     }
                 }
 
-                if (response->success)
+                if (is_batch)
                 {
-                    if (is_batch)
+                    bool keep_going = batch_handle_response(
+                      &state, i, current_file, filename, file_stat.st_size, response);
+                    network_free_response(response);
+                    free(filename);
+
+                    if (!keep_going)
                     {
-                        print_success("        Success: %s\n", response->url);
-                        success_urls[success_count++] = strdup(response->url);
+                        break;
                     }
-                    else
-                    {
-                        print_section_header("UPLOAD SUCCESSFUL");
+                    continue;
+                }
 
-                        char size_str[32];
-                        format_file_size(file_stat.st_size, size_str, sizeof(size_str));
+                if (!response)
+                {
+                    print_error("Error: Upload failed\n");
+                    free(filename);
+                    network_session_free(session);
+                    config_free(config);
+                    return EXIT_NETWORK_ERROR;
+                }
 
-                        print_info("  File: %s (%s)\n", filename, size_str);
-                        print_info("  Host: %s\n", host->name);
+                if (!response->success)
+                {
+                    print_error("Error: %s\n", response->error_message);
+                    notify_send_error("Upload failed", response->error_message);
+                    queue_failed_upload(args, host, current_file, file_stat.st_size, response);
+                    network_free_response(response);
+                    free(filename);
+                    network_session_free(session);
+                    config_free(config);
+                    return EXIT_NETWORK_ERROR;
+                }
 
-                        notify_send("Upload successful", response->url);
+                print_section_header(response->deduplicated ? "ALREADY UPLOADED"
+                                                            : "UPLOAD SUCCESSFUL");
 
-                        double time_ms = response->request_time_ms;
-                        char time_str[32];
-                        if (time_ms < 1000)
-                        {
-                            snprintf(time_str, sizeof(time_str), "%.2f ms", time_ms);
-                        }
-                        else
-                        {
-                            snprintf(time_str, sizeof(time_str), "%.2f sec", time_ms / 1000.0);
-                        }
-                        print_info("  Request time: %s\n", time_str);
+                size_t file_size =
+                  args->from_stdin ? (size_t)response->bytes_sent : (size_t)file_stat.st_size;
+                char size_str[32];
+                format_file_size(file_size, size_str, sizeof(size_str));
 
-                        printf("\n\033[1;32m%s\033[0m\n", response->url);
+                print_info("  File: %s (%s)\n", filename, size_str);
+                print_info("  Host: %s\n", host->name);
 
-                        if (response->deletion_url)
-                        {
-                            printf("\n\033[1;33mDeletion URL: %s\033[0m\n", response->deletion_url);
-                            print_info("  Save this URL to delete the file later\n");
-                        }
-                        printf("\n");
+                notify_send("Upload successful", response->url);
 
-                        const char *clipboard_manager = get_clipboard_manager_name();
-                        if (clipboard_manager && !args->no_clipboard && config->copy_to_clipboard &&
-                            copy_to_clipboard(response->url))
-                        {
-                            print_success("URL copied to clipboard using %s\n", clipboard_manager);
-                        }
-                    }
+                double time_ms = response->request_time_ms;
+                char time_str[32];
+                if (time_ms < 1000)
+                {
+                    snprintf(time_str, sizeof(time_str), "%.2f ms", time_ms);
+                }
+                else
+                {
+                    snprintf(time_str, sizeof(time_str), "%.2f sec", time_ms / 1000.0);
+                }
+                if (!response->deduplicated)
+                {
+                    print_info("  Request time: %s\n", time_str);
+                }
+
+                printf("\n\033[1;32m%s\033[0m\n", response->url);
+
+                if (response->deletion_url)
+                {
+                    printf("\n\033[1;33mDeletion URL: %s\033[0m\n", response->deletion_url);
+                    print_info("  Save this URL to delete the file later\n");
+                }
+                printf("\n");
+
+                const char *clipboard_manager = get_clipboard_manager_name();
+                if (clipboard_manager && !args->no_clipboard && config->copy_to_clipboard &&
+                    copy_to_clipboard(response->url))
+                {
+                    print_success("URL copied to clipboard using %s\n", clipboard_manager);
+                }
 
+                if (!response->deduplicated)
+                {
                     db_add_upload(host->name,
                                   current_file,
                                   response->url,
                                   response->deletion_url,
                                   filename,
-                                  file_stat.st_size);
-                }
-                else
-                {
-                    if (is_batch)
-                    {
-                        print_error("        Failed: %s\n", response->error_message);
-                        failed_files[failure_count] = strdup(filename);
-                        failed_errors[failure_count] = strdup(
-                          response->error_message ? response->error_message : "Unknown error");
-                        failure_count++;
-
-                        if (!args->continue_on_error)
-                        {
-                            network_free_response(response);
-                            free(filename);
-                            print_error(
-                              "\nStopping due to error (use --continue-on-error to continue)\n");
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        print_error("Error: %s\n", response->error_message);
-                        notify_send_error("Upload failed", response->error_message);
-                        network_free_response(response);
-                        free(filename);
-                        config_free(config);
-                        return EXIT_NETWORK_ERROR;
-                    }
+                                  file_size,
+                                  response->content_hash,
+                                  &response->timing);
                 }
 
                 network_free_response(response);
                 free(filename);
-
-                if (is_batch && args->throttle_ms > 0 && i < args->file_count - 1)
-                {
-                    usleep(args->throttle_ms * 1000);
-                }
             }
 
             if (is_batch)
             {
                 printf("\n");
                 print_section_header("BATCH SUMMARY");
-                print_info("  Total files: %d\n", args->file_count);
-                print_success("  Successful:  %d\n", success_count);
-                if (failure_count > 0)
+                print_info("  Total files: %d\n", state.total);
+                print_success("  Successful:  %d\n", state.success_count);
+                if (state.failure_count > 0)
                 {
-                    print_error("  Failed:      %d\n", failure_count);
+                    print_error("  Failed:      %d\n", state.failure_count);
                 }
                 else
                 {
                     print_info("  Failed:      0\n");
                 }
 
-                if (success_count > 0 && failure_count == 0)
+                if (state.success_count > 0 && state.failure_count == 0)
                 {
                     char body[128];
-                    snprintf(body, sizeof(body), "%d file(s) uploaded successfully", success_count);
+                    snprintf(
+                      body, sizeof(body), "%d file(s) uploaded successfully", state.success_count);
                     notify_send("Batch upload complete", body);
                 }
-                else if (failure_count > 0)
+                else if (state.failure_count > 0)
                 {
                     char body[128];
-                    snprintf(
-                      body, sizeof(body), "%d succeeded, %d failed", success_count, failure_count);
+                    snprintf(body,
+                             sizeof(body),
+                             "%d succeeded, %d failed",
+                             state.success_count,
+                             state.failure_count);
                     notify_send_error("Batch upload finished", body);
                 }
 
-                if (success_count > 0)
+                if (state.success_count > 0)
                 {
                     printf("\n");
                     print_section_header("UPLOADED URLs");
-                    for (int i = 0; i < success_count; i++)
+                    batch_list_sort(&state.successes);
+                    for (int i = 0; i < state.successes.count; i++)
+                    {
+                        printf("  \033[1;32m%s\033[0m\n", state.successes.entries[i].name);
+                    }
+                    if (state.successes.omitted > 0)
                     {
-                        printf("  \033[1;32m%s\033[0m\n", success_urls[i]);
+                        print_info("  ... and %d more, listed above\n", state.successes.omitted);
                     }
 
                     const char *clipboard_manager = get_clipboard_manager_name();
                     if (clipboard_manager && !args->no_clipboard && config->copy_to_clipboard)
                     {
-                        if (success_count == 1)
+                        if (state.success_count == 1)
                         {
-                            if (copy_to_clipboard(success_urls[0]))
+                            if (copy_to_clipboard(state.successes.entries[0].name))
                             {
                                 printf("\n");
                                 print_success("URL copied to clipboard using %s\n",
                                               clipboard_manager);
                             }
                         }
-                        else if (success_count > 1)
+                        else
                         {
                             size_t total_len = 0;
-                            for (int i = 0; i < success_count; i++)
+                            for (int i = 0; i < state.successes.count; i++)
                             {
-                                total_len += strlen(success_urls[i]) + 1;
+                                total_len += strlen(state.successes.entries[i].name) + 1;
                             }
 
                             char *all_urls = malloc(total_len);
                             if (all_urls)
                             {
-                                all_urls[0] = '\0';
-                                for (int i = 0; i < success_count; i++)
+                                size_t offset = 0;
+                                for (int i = 0; i < state.successes.count; i++)
                                 {
-                                    strcat(all_urls, success_urls[i]);
-                                    if (i < success_count - 1)
+                                    size_t len = strlen(state.successes.entries[i].name);
+                                    if (offset > 0)
                                     {
-                                        strcat(all_urls, "\n");
+                                        all_urls[offset++] = '\n';
                                     }
+                                    memcpy(all_urls + offset, state.successes.entries[i].name, len);
+                                    offset += len;
                                 }
+                                all_urls[offset] = '\0';
+
                                 if (copy_to_clipboard(all_urls))
                                 {
                                     printf("\n");
-                                    print_success("All URLs copied to clipboard using %s\n",
+                                    print_success("%d URLs copied to clipboard using %s\n",
+                                                  state.successes.count,
                                                   clipboard_manager);
                                 }
                                 free(all_urls);
@@ -1484,41 +3568,68 @@ execute_command(command_args_t *args)
                     }
                 }
 
-                if (failure_count > 0)
+                if (state.failure_count > 0)
                 {
                     printf("\n");
                     print_section_header("FAILED FILES");
-                    for (int i = 0; i < failure_count; i++)
+                    batch_list_sort(&state.failures);
+                    for (int i = 0; i < state.failures.count; i++)
+                    {
+                        print_error("  %s: %s\n",
+                                    state.failures.entries[i].name,
+                                    state.failures.entries[i].detail);
+                    }
+                    if (state.failures.omitted > 0)
                     {
-                        print_error("  %s: %s\n", failed_files[i], failed_errors[i]);
+                        print_error("  ... and %d more, listed above\n", state.failures.omitted);
                     }
                 }
 
-                for (int i = 0; i < success_count; i++)
-                {
-                    free(success_urls[i]);
-                }
-                for (int i = 0; i < failure_count; i++)
+                interrupted = batch_interrupted;
+                bool complete = !interrupted && state.failure_count == 0;
+                batch_end(&state, complete);
+                if (state.journaled && !complete)
                 {
-                    free(failed_files[i]);
-                    free(failed_errors[i]);
+                    printf("\n");
+                    print_info("  Resume with: hostman upload --resume %d\n", state.batch_id);
+                    if (streaming && interrupted)
+                    {
+                        print_info("  Pass the same --directory or --files-from to include files "
+                                   "not yet listed\n");
+                    }
                 }
-                free(success_urls);
-                free(failed_files);
-                free(failed_errors);
+
+                batch_free(&state);
 
                 printf("\n");
             }
 
+            network_session_free(session);
             config_free(config);
-            return failure_count > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+            return state.failure_count > 0 || interrupted ? EXIT_FAILURE : EXIT_SUCCESS;
         }
 
         case CMD_LIST_UPLOADS:
         {
+            /* --before names an upload, whose position in the listing is the cursor */
+            if (args->before_id > 0 && args->before_timestamp < 0)
+            {
+                upload_record_t *before = db_get_upload_by_id(args->before_id);
+                if (!before)
+                {
+                    print_error("Error: No upload record found with ID %d\n", args->before_id);
+                    return EXIT_INVALID_ARGS;
+                }
+                args->before_timestamp = before->timestamp;
+                db_free_record(before);
+            }
+
             int count = 0;
             upload_record_t **records =
-              db_get_uploads(args->host_name, args->page, args->limit, &count);
+              args->page > 1
+                ? db_get_uploads(args->host_name, args->page, args->limit, &count)
+                : db_get_uploads_after(
+                    args->host_name, args->before_timestamp, args->before_id, args->limit, &count);
 
             if (!records)
             {
@@ -1526,6 +3637,24 @@ execute_command(command_args_t *args)
                 return EXIT_FAILURE;
             }
 
+            /* A full page may have more after it; the cursor is the last row shown */
+            char next_cursor[48] = "";
+            if (count > 0 && count == args->limit)
+            {
+                snprintf(next_cursor,
+                         sizeof(next_cursor),
+                         "%lld:%d",
+                         (long long)records[count - 1]->timestamp,
+                         records[count - 1]->id);
+            }
+
+            if (args->output_mode == OUTPUT_JSON)
+            {
+                print_uploads_json(records, count, next_cursor);
+                db_free_records(records, count);
+                return EXIT_SUCCESS;
+            }
+
             if (count == 0)
             {
                 print_info("No upload records found.\n");
@@ -1583,7 +3712,21 @@ execute_command(command_args_t *args)
                 printf("\n");
             }
 
-            printf("\n\033[1mPage %d, showing %d record(s)\033[0m\n", args->page, count);
+            if (args->page > 1)
+            {
+                printf("\n\033[1mPage %d, showing %d record(s)\033[0m\n", args->page, count);
+            }
+            else
+            {
+                printf("\n\033[1mShowing %d record(s)\033[0m\n", count);
+            }
+            if (next_cursor[0] != '\0')
+            {
+                printf("Next page: hostman list-uploads%s%s --before %d\n",
+                       args->host_name ? " --host " : "",
+                       args->host_name ? args->host_name : "",
+                       records[count - 1]->id);
+            }
 
             bool has_deletion_urls = false;
             for (int i = 0; i < count; i++)
@@ -1606,6 +3749,37 @@ execute_command(command_args_t *args)
             return EXIT_SUCCESS;
         }
 
+        case CMD_STATS:
+        {
+            int status = print_host_stats(args);
+            if (status == EXIT_SUCCESS && args->latency)
+            {
+                status = print_latency_stats(args);
+            }
+            return status;
+        }
+
+        case CMD_DAEMON:
+            return daemon_run();
+
+        case CMD_FLUSH:
+            return flush_queue(args);
+
+        case CMD_WATCH:
+        {
+            hostman_config_t *config = NULL;
+            host_config_t *host = NULL;
+            int status = load_upload_host(args, &config, &host);
+            if (status != EXIT_SUCCESS)
+            {
+                return status;
+            }
+
+            bool watched = watch_directory(args, config, host);
+            config_free(config);
+            return watched ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
         case CMD_LIST_HOSTS:
         {
             hostman_config_t *config = config_load();
@@ -1765,243 +3939,156 @@ execute_command(command_args_t *args)
 
         case CMD_DELETE_UPLOAD:
         {
-            if (args->upload_id <= 0)
+            int count = 0;
+            upload_record_t **records = find_upload_records(args, &count);
+            if (!records)
             {
-                print_error("Error: Invalid upload ID\n");
-                return EXIT_INVALID_ARGS;
+                return EXIT_FAILURE;
             }
 
-            int count = 0;
-            upload_record_t **records = db_get_uploads(NULL, 1, 1000, &count);
-            bool found = false;
-
-            if (records)
+            printf(count == 1 ? "Delete the following record?\n\n"
+                              : "Delete the following %d records?\n\n",
+                   count);
+            int *ids = malloc(count * sizeof(int));
+            for (int i = 0; i < count; i++)
             {
-                for (int i = 0; i < count; i++)
+                print_upload_record(records[i], count == 1, false);
+                if (ids)
                 {
-                    if (records[i]->id == args->upload_id)
-                    {
-                        found = true;
-                        printf("Delete the following record?\n\n");
-
-                        char time_str[21];
-                        struct tm *tm_info = localtime(&records[i]->timestamp);
-                        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
-                        char size_str[32];
-                        format_file_size(records[i]->size, size_str, sizeof(size_str));
-
-                        print_info("ID: %d\n", records[i]->id);
-                        print_info("Date: %s\n", time_str);
-                        print_info("Host: %s\n", records[i]->host_name);
-                        print_info("File: %s (%s)\n", records[i]->filename, size_str);
-                        print_info("URL: %s\n\n", records[i]->remote_url);
-
-                        break;
-                    }
+                    ids[i] = records[i]->id;
                 }
-                db_free_records(records, count);
             }
+            db_free_records(records, count);
 
-            if (!found)
+            if (!ids)
             {
-                print_error("Error: No upload record found with ID %d\n", args->upload_id);
+                print_error("Error: Out of memory\n");
                 return EXIT_FAILURE;
             }
 
-            char response[10];
-            printf("Are you sure you want to delete this record? [y/N]: ");
-            if (fgets(response, sizeof(response), stdin) == NULL)
+            int status = EXIT_SUCCESS;
+            if (!confirm_action(count == 1 ? "\nAre you sure you want to delete this record?"
+                                           : "\nAre you sure you want to delete these records?",
+                                &status))
             {
-                print_error("Error reading response\n");
-                return EXIT_FAILURE;
+                free(ids);
+                return status;
             }
 
-            if (response[0] == 'y' || response[0] == 'Y')
-            {
-                if (db_delete_upload(args->upload_id))
-                {
-                    print_success("Upload record deleted successfully.\n");
-                    return EXIT_SUCCESS;
-                }
-                else
-                {
-                    print_error("Error: Failed to delete upload record.\n");
-                    return EXIT_FAILURE;
-                }
-            }
-            else
+            bool deleted = db_delete_uploads(ids, count);
+            free(ids);
+            if (!deleted)
             {
-                print_info("Delete operation cancelled.\n");
-                return EXIT_SUCCESS;
+                print_error("Error: Failed to delete upload record(s).\n");
+                return EXIT_FAILURE;
             }
+
+            print_success("%d upload record(s) deleted successfully.\n", count);
+            return EXIT_SUCCESS;
         }
 
         case CMD_DELETE_FILE:
         {
-            if (args->upload_id <= 0)
+            int count = 0;
+            upload_record_t **records = find_upload_records(args, &count);
+            if (!records)
             {
-                print_error("Error: Invalid upload ID\n");
-                return EXIT_INVALID_ARGS;
+                return EXIT_FAILURE;
             }
 
-            int count = 0;
-            upload_record_t **records = db_get_uploads(NULL, 1, 1000, &count);
-            bool found = false;
-            char *deletion_url = NULL;
-            upload_record_t *record = NULL;
-
-            if (records)
+            /* Uploads without a deletion URL are reported and left out */
+            int deletable = 0;
+            for (int i = 0; i < count; i++)
             {
-                for (int i = 0; i < count; i++)
+                if (!records[i]->deletion_url || records[i]->deletion_url[0] == '\0')
                 {
-                    if (records[i]->id == args->upload_id)
-                    {
-                        found = true;
-                        record = records[i];
-
-                        if (!record->deletion_url || strlen(record->deletion_url) == 0)
-                        {
-                            print_error("Error: This upload doesn't have a deletion URL\n");
-                            db_free_records(records, count);
-                            return EXIT_FAILURE;
-                        }
-
-                        deletion_url = strdup(record->deletion_url);
-
-                        printf("Delete the following file from the remote host?\n\n");
-
-                        char time_str[21];
-                        struct tm *tm_info = localtime(&record->timestamp);
-                        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-
-                        char size_str[32];
-                        format_file_size(record->size, size_str, sizeof(size_str));
-
-                        print_info("ID: %d\n", record->id);
-                        print_info("Date: %s\n", time_str);
-                        print_info("Host: %s\n", record->host_name);
-                        print_info("File: %s (%s)\n", record->filename, size_str);
-                        print_info("URL: %s\n", record->remote_url);
-                        print_info("Deletion URL: %s\n\n", record->deletion_url);
-                        break;
-                    }
+                    print_error("Error: Upload %d doesn't have a deletion URL\n", records[i]->id);
+                    db_free_record(records[i]);
+                    continue;
                 }
+                records[deletable++] = records[i];
             }
+            count = deletable;
 
-            if (!found || !deletion_url)
+            if (count == 0)
             {
-                print_error("Error: No upload record found with ID %d\n", args->upload_id);
-                if (records)
-                    db_free_records(records, count);
+                db_free_records(records, count);
                 return EXIT_FAILURE;
             }
 
-            char response[10];
-            printf("Are you sure you want to delete this file from the remote host? [y/N]: ");
-            if (fgets(response, sizeof(response), stdin) == NULL)
+            printf(count == 1 ? "Delete the following file from the remote host?\n\n"
+                              : "Delete the following %d files from the remote host?\n\n",
+                   count);
+            for (int i = 0; i < count; i++)
             {
-                print_error("Error reading response\n");
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
-                return EXIT_FAILURE;
+                print_upload_record(records[i], count == 1, true);
             }
 
-            if (response[0] != 'y' && response[0] != 'Y')
+            int status = EXIT_SUCCESS;
+            if (!confirm_action(count == 1
+                                  ? "\nAre you sure you want to delete this file from the remote "
+                                    "host?"
+                                  : "\nAre you sure you want to delete these files from the "
+                                    "remote host?",
+                                &status))
             {
-                print_info("Delete operation cancelled.\n");
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
-                return EXIT_SUCCESS;
+                db_free_records(records, count);
+                return status;
             }
 
-            CURL *curl;
-            CURLcode res;
-            response_data_t response_data = { 0 };
-
-            curl = curl_easy_init();
-            if (!curl)
+            CURL *curl = curl_easy_init();
+            int *deleted_ids = malloc(count * sizeof(int));
+            if (!curl || !deleted_ids)
             {
                 print_error("Error: Failed to initialize cURL\n");
-                if (records)
-                    db_free_records(records, count);
-                free(deletion_url);
+                curl_easy_cleanup(curl);
+                free(deleted_ids);
+                db_free_records(records, count);
                 return EXIT_NETWORK_ERROR;
             }
 
-            print_info("Sending deletion request...\n");
-
-            curl_easy_setopt(curl, CURLOPT_URL, deletion_url);
-            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-
-            if (args->insecure)
-            {
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-            }
-            else
+            /* One handle keeps the connection to a host open across its files */
+            int deleted = 0;
+            status = EXIT_SUCCESS;
+            for (int i = 0; i < count; i++)
             {
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-                curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+                int result = delete_remote_file(curl, records[i], args->insecure);
+                if (result == EXIT_SUCCESS)
+                {
+                    deleted_ids[deleted++] = records[i]->id;
+                }
+                else if (status == EXIT_SUCCESS)
+                {
+                    status = result;
+                }
             }
-
-            res = curl_easy_perform(curl);
-
-            long http_code = 0;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
             curl_easy_cleanup(curl);
-            free(deletion_url);
-
-            if (res != CURLE_OK)
-            {
-                print_error("Error: %s\n", curl_easy_strerror(res));
-                free(response_data.data);
-                if (records)
-                    db_free_records(records, count);
-                return EXIT_NETWORK_ERROR;
-            }
-
-            bool success = (http_code >= 200 && http_code < 300);
+            db_free_records(records, count);
 
-            if (success)
+            if (deleted > 0)
             {
-                print_success("File deleted successfully from the remote host!\n");
-
-                char confirm[10];
-                printf("Do you want to remove the record from the local database too? [y/N]: ");
-                if (fgets(confirm, sizeof(confirm), stdin) != NULL &&
-                    (confirm[0] == 'y' || confirm[0] == 'Y'))
+                int ignored = EXIT_SUCCESS;
+                if (confirm_action(deleted == 1
+                                     ? "Do you want to remove the record from the local database "
+                                       "too?"
+                                     : "Do you want to remove the records from the local database "
+                                       "too?",
+                                   &ignored))
                 {
-                    if (db_delete_upload(args->upload_id))
+                    if (db_delete_uploads(deleted_ids, deleted))
                     {
-                        print_success("Upload record deleted from local database.\n");
+                        print_success("%d upload record(s) deleted from local database.\n",
+                                      deleted);
                     }
                     else
                     {
-                        print_error("Failed to delete upload record from local database.\n");
+                        print_error("Failed to delete upload record(s) from local database.\n");
                     }
                 }
             }
-            else
-            {
-                print_error("Failed to delete file. HTTP status code: %ld\n", http_code);
-                if (response_data.data && response_data.size > 0)
-                {
-                    print_info("Server response: %s\n", response_data.data);
-                }
-                print_info("You can try visiting the deletion URL in your browser: %s\n",
-                           record->deletion_url);
-            }
 
-            free(response_data.data);
-
-            if (records)
-                db_free_records(records, count);
-            return success ? EXIT_SUCCESS : EXIT_NETWORK_ERROR;
+            free(deleted_ids);
+            return status;
         }
 
         case CMD_HELP:
@@ -2051,7 +4138,7 @@ run_setup_wizard(void)
     if (access(cache_dir, F_OK) != 0)
     {
         print_info("Creating cache directory: %s\n", cache_dir);
-        if (mkdir(cache_dir, 0755) != 0)
+        if (mkdir(cache_dir, 0700) != 0)
         {
             print_error("Error: Failed to create cache directory.\n");
             free(cache_dir);
@@ -2131,8 +4218,20 @@ free_command_args(command_args_t *args)
             free(args->clipboard_temp_file);
         }
         free(args->host_name);
+        free(args->stdin_name);
         free(args->file_path);
         free(args->directory);
+        free(args->files_from);
+        for (int i = 0; i < args->include_count; i++)
+        {
+            free(args->include_patterns[i]);
+        }
+        free(args->include_patterns);
+        for (int i = 0; i < args->exclude_count; i++)
+        {
+            free(args->exclude_patterns[i]);
+        }
+        free(args->exclude_patterns);
         if (args->file_paths)
         {
             for (int i = 0; i < args->file_count; i++)
@@ -2145,5 +4244,6 @@ free_command_args(command_args_t *args)
         free(args->config_value);
         free(args->command_name);
         free(args->import_file);
+        free(args->upload_ids);
     }
 }
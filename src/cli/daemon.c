@@ -0,0 +1,812 @@
+#define _GNU_SOURCE
+
+#include "hostman/cli/daemon.h"
+#include "hostman/cli/cli.h"
+#include "hostman/core/config.h"
+#include "hostman/core/logging.h"
+#include "hostman/network/network.h"
+#include "hostman/ui/ui.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DAEMON_SOCKET_NAME "hostman.sock"
+#define DAEMON_MAGIC 0x484d4432u
+#define DAEMON_READY 'R'
+#define DAEMON_INTERRUPT 'I'
+#define DAEMON_READY_TIMEOUT_MS 200
+#define DAEMON_MAX_ARGS 4096
+#define DAEMON_MAX_REQUEST (1024 * 1024)
+#define DAEMON_STATUS_REJECTED (-1)
+#define DAEMON_RECV_TIMEOUT_SECONDS 5
+#define DAEMON_FD_COUNT 3
+
+/* The daemon answers each connection with DAEMON_READY once it is free to serve it. The client
+ * then sends this header followed by its cwd, argv and environment entries as NUL-terminated
+ * strings; its stdin, stdout and stderr travel with the header as SCM_RIGHTS. While the request
+ * runs, the client sends DAEMON_INTERRUPT for each SIGINT or SIGTERM it receives. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t length;
+} daemon_request_t;
+
+static const char *forwarded_commands[] = {
+    "upload", "list-uploads", "delete-upload", "delete-file", "stats",
+};
+
+/* Locate the config, history and keys; a client that disagrees runs in-process */
+static const char *shared_environment[] = {
+    "HOME",
+    "XDG_CONFIG_HOME",
+    "XDG_CACHE_HOME",
+};
+
+/* Applied for the duration of each request */
+static const char *request_environment[] = {
+    "PATH", "TERM", "NO_COLOR", "DISPLAY", "WAYLAND_DISPLAY", "XDG_SESSION_TYPE",
+};
+
+#define ARRAY_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t forward_fd = -1;
+static volatile sig_atomic_t request_client = -1;
+
+bool
+daemon_socket_path(char *buffer, size_t size)
+{
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir || runtime_dir[0] != '/')
+    {
+        return false;
+    }
+
+    int written = snprintf(buffer, size, "%s/%s", runtime_dir, DAEMON_SOCKET_NAME);
+    return written > 0 && (size_t)written < size;
+}
+
+static int
+connect_socket(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool
+send_all(int fd, const void *data, size_t length)
+{
+    const char *p = data;
+    while (length > 0)
+    {
+        ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += sent;
+        length -= (size_t)sent;
+    }
+
+    return true;
+}
+
+static bool
+read_all(int fd, void *data, size_t length)
+{
+    char *p = data;
+    while (length > 0)
+    {
+        ssize_t got = read(fd, p, length);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            return false;
+        }
+        p += got;
+        length -= (size_t)got;
+    }
+
+    return true;
+}
+
+static const char *
+find_command(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-')
+        {
+            return argv[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool
+daemon_can_forward(int argc, char *argv[])
+{
+    const char *disabled = getenv("HOSTMAN_NO_DAEMON");
+    if (disabled && disabled[0] != '\0' && strcmp(disabled, "0") != 0)
+    {
+        return false;
+    }
+
+    const char *command = find_command(argc, argv);
+    if (!command)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < ARRAY_COUNT(forwarded_commands); i++)
+    {
+        if (strcmp(command, forwarded_commands[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+wait_until_ready(int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int ready;
+    do
+    {
+        ready = poll(&pfd, 1, DAEMON_READY_TIMEOUT_MS);
+    } while (ready < 0 && errno == EINTR);
+
+    char byte;
+    return ready == 1 && read(fd, &byte, 1) == 1 && byte == DAEMON_READY;
+}
+
+static void
+append_string(char *payload, size_t *offset, const char *text)
+{
+    size_t length = strlen(text) + 1;
+    memcpy(payload + *offset, text, length);
+    *offset += length;
+}
+
+static char *
+build_payload(const char *cwd, int argc, char *argv[], size_t *length, uint32_t *envc)
+{
+    const char *names[ARRAY_COUNT(shared_environment) + ARRAY_COUNT(request_environment)];
+    size_t name_count = 0;
+    for (size_t i = 0; i < ARRAY_COUNT(shared_environment); i++)
+    {
+        names[name_count++] = shared_environment[i];
+    }
+    for (size_t i = 0; i < ARRAY_COUNT(request_environment); i++)
+    {
+        names[name_count++] = request_environment[i];
+    }
+
+    size_t total = strlen(cwd) + 1;
+    for (int i = 0; i < argc; i++)
+    {
+        total += strlen(argv[i]) + 1;
+    }
+    for (size_t i = 0; i < name_count; i++)
+    {
+        const char *value = getenv(names[i]);
+        if (value)
+        {
+            total += strlen(names[i]) + 1 + strlen(value) + 1;
+        }
+    }
+    if (total > DAEMON_MAX_REQUEST)
+    {
+        return NULL;
+    }
+
+    char *payload = malloc(total);
+    if (!payload)
+    {
+        return NULL;
+    }
+
+    size_t offset = 0;
+    append_string(payload, &offset, cwd);
+    for (int i = 0; i < argc; i++)
+    {
+        append_string(payload, &offset, argv[i]);
+    }
+
+    *envc = 0;
+    for (size_t i = 0; i < name_count; i++)
+    {
+        const char *value = getenv(names[i]);
+        if (value)
+        {
+            offset += (size_t)sprintf(payload + offset, "%s=%s", names[i], value) + 1;
+            (*envc)++;
+        }
+    }
+
+    *length = total;
+    return payload;
+}
+
+static void
+handle_forward_signal(int signum)
+{
+    (void)signum;
+    char byte = DAEMON_INTERRUPT;
+    int saved_errno = errno;
+    if (forward_fd >= 0)
+    {
+        send(forward_fd, &byte, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    errno = saved_errno;
+}
+
+bool
+daemon_forward(int argc, char *argv[], int *exit_code)
+{
+    char path[PATH_MAX];
+    if (!daemon_socket_path(path, sizeof(path)))
+    {
+        return false;
+    }
+
+    int fd = connect_socket(path);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    /* A daemon busy with another request is not waited for */
+    char cwd[PATH_MAX];
+    if (!wait_until_ready(fd) || !getcwd(cwd, sizeof(cwd)))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t length = 0;
+    uint32_t envc = 0;
+    char *payload = build_payload(cwd, argc, argv, &length, &envc);
+    if (!payload)
+    {
+        close(fd);
+        return false;
+    }
+
+    /* Standard streams closed by the caller (e.g. a hotkey daemon) are replaced by /dev/null */
+    int fds[DAEMON_FD_COUNT];
+    int opened[DAEMON_FD_COUNT] = { -1, -1, -1 };
+    for (int i = 0; i < DAEMON_FD_COUNT; i++)
+    {
+        fds[i] = i;
+        if (fcntl(i, F_GETFD) < 0)
+        {
+            opened[i] = open("/dev/null", i == 0 ? O_RDONLY : O_WRONLY);
+            fds[i] = opened[i];
+        }
+    }
+
+    daemon_request_t request = { .magic = DAEMON_MAGIC,
+                                 .argc = (uint32_t)argc,
+                                 .envc = envc,
+                                 .length = (uint32_t)length };
+    struct iovec iov = { .iov_base = &request, .iov_len = sizeof(request) };
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg = { .msg_iov = &iov,
+                          .msg_iovlen = 1,
+                          .msg_control = control.buffer,
+                          .msg_controllen = sizeof(control.buffer) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    bool sent = sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(request) &&
+                send_all(fd, payload, length);
+
+    free(payload);
+    for (int i = 0; i < DAEMON_FD_COUNT; i++)
+    {
+        if (opened[i] >= 0)
+        {
+            close(opened[i]);
+        }
+    }
+
+    if (!sent)
+    {
+        close(fd);
+        return false;
+    }
+
+    /* Ctrl+C must stop the batch the daemon is running for us, not just this process; a second
+     * one falls back to the default action */
+    struct sigaction action = { .sa_handler = handle_forward_signal,
+                                .sa_flags = (int)SA_RESETHAND };
+    struct sigaction old_int;
+    struct sigaction old_term;
+    sigemptyset(&action.sa_mask);
+    forward_fd = fd;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+
+    int32_t status;
+    bool answered = read_all(fd, &status, sizeof(status));
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    forward_fd = -1;
+    close(fd);
+
+    if (!answered)
+    {
+        /* The request may already have run, so it is not repeated in-process */
+        fprintf(stderr, "Error: hostman daemon closed the connection\n");
+        *exit_code = EXIT_FAILURE;
+        return true;
+    }
+
+    if (status == DAEMON_STATUS_REJECTED)
+    {
+        return false;
+    }
+
+    *exit_code = status;
+    return true;
+}
+
+/* Stops the daemon after the current request, which is itself stopped at a clean checkpoint */
+static void
+handle_stop_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+    cli_request_interrupt();
+}
+
+/* Raised for activity on the client socket while a request runs. The client only sends
+ * DAEMON_INTERRUPT or hangs up, and either means the user wants the request stopped. */
+static void
+handle_client_signal(int signum)
+{
+    (void)signum;
+    int saved_errno = errno;
+    struct pollfd pfd = { .fd = request_client, .events = POLLIN };
+    if (request_client >= 0 && poll(&pfd, 1, 0) == 1)
+    {
+        cli_request_interrupt();
+    }
+    errno = saved_errno;
+}
+
+static void
+watch_client(int client, bool enable)
+{
+    int flags = fcntl(client, F_GETFL);
+    if (flags < 0)
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        request_client = client;
+        fcntl(client, F_SETOWN, getpid());
+        fcntl(client, F_SETFL, flags | O_ASYNC);
+    }
+    else
+    {
+        fcntl(client, F_SETFL, flags & ~O_ASYNC);
+        request_client = -1;
+    }
+}
+
+static int
+receive_request(int client, daemon_request_t *request, int fds[DAEMON_FD_COUNT])
+{
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int) * DAEMON_FD_COUNT)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = request, .iov_len = sizeof(*request) };
+    struct msghdr msg = { .msg_iov = &iov,
+                          .msg_iovlen = 1,
+                          .msg_control = control.buffer,
+                          .msg_controllen = sizeof(control.buffer) };
+
+    ssize_t got;
+    do
+    {
+        got = recvmsg(client, &msg, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+
+    int received = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * DAEMON_FD_COUNT);
+        }
+    }
+
+    if (got != (ssize_t)sizeof(*request) || (msg.msg_flags & MSG_CTRUNC) ||
+        received != DAEMON_FD_COUNT)
+    {
+        for (int i = 0; i < received && i < DAEMON_FD_COUNT; i++)
+        {
+            close(fds[i]);
+        }
+        return got == 0 ? 0 : -1;
+    }
+
+    return 1;
+}
+
+static const char *
+find_environment(char **env, int envc, const char *name)
+{
+    size_t name_length = strlen(name);
+    for (int i = 0; i < envc; i++)
+    {
+        if (strncmp(env[i], name, name_length) == 0 && env[i][name_length] == '=')
+        {
+            return env[i] + name_length + 1;
+        }
+    }
+
+    return NULL;
+}
+
+static bool
+shares_environment(char **env, int envc)
+{
+    for (size_t i = 0; i < ARRAY_COUNT(shared_environment); i++)
+    {
+        const char *theirs = find_environment(env, envc, shared_environment[i]);
+        const char *ours = getenv(shared_environment[i]);
+        if ((theirs == NULL) != (ours == NULL) || (theirs && strcmp(theirs, ours) != 0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+swap_environment(char **env, int envc, char *saved[])
+{
+    for (size_t i = 0; i < ARRAY_COUNT(request_environment); i++)
+    {
+        const char *name = request_environment[i];
+        const char *current = getenv(name);
+        char *previous = current ? strdup(current) : NULL;
+
+        const char *value = env ? find_environment(env, envc, name) : saved[i];
+        if (value)
+        {
+            setenv(name, value, 1);
+        }
+        else
+        {
+            unsetenv(name);
+        }
+
+        if (!env)
+        {
+            free(saved[i]);
+        }
+        saved[i] = previous;
+    }
+}
+
+static int
+run_request(int argc, char **argv, const char *cwd, int fds[DAEMON_FD_COUNT], int home_dir)
+{
+    int saved[DAEMON_FD_COUNT];
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < DAEMON_FD_COUNT; i++)
+    {
+        saved[i] = fcntl(i, F_DUPFD_CLOEXEC, DAEMON_FD_COUNT);
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+    __fpurge(stdin);
+    clearerr(stdin);
+
+    int status;
+    if (chdir(cwd) != 0)
+    {
+        fprintf(stderr, "Error: Cannot change to directory '%s': %s\n", cwd, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    else
+    {
+        ui_init(&argc, argv);
+        command_args_t args = parse_args(argc, argv);
+        status = execute_command(&args);
+        free_command_args(&args);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    __fpurge(stdin);
+    for (int i = 0; i < DAEMON_FD_COUNT; i++)
+    {
+        if (saved[i] >= 0)
+        {
+            dup2(saved[i], i);
+            close(saved[i]);
+        }
+        else
+        {
+            close(i);
+        }
+    }
+    if (fchdir(home_dir) != 0)
+    {
+        log_warn("Failed to restore daemon working directory: %s", strerror(errno));
+    }
+
+    return status;
+}
+
+static void
+serve_client(int client, int home_dir)
+{
+    int32_t status = DAEMON_STATUS_REJECTED;
+
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 ||
+        cred.uid != getuid())
+    {
+        log_warn("Rejected daemon connection from another user");
+        return;
+    }
+
+    config_reload_if_changed();
+
+    char ready = DAEMON_READY;
+    if (!send_all(client, &ready, 1))
+    {
+        return;
+    }
+
+    struct timeval timeout = { .tv_sec = DAEMON_RECV_TIMEOUT_SECONDS };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    daemon_request_t request;
+    int fds[DAEMON_FD_COUNT];
+    int received = receive_request(client, &request, fds);
+    if (received <= 0)
+    {
+        /* A client that gave up waiting for DAEMON_READY closes without a request */
+        if (received < 0)
+        {
+            log_warn("Rejected malformed daemon request");
+            send_all(client, &status, sizeof(status));
+        }
+        return;
+    }
+
+    char *payload = NULL;
+    char **strings = NULL;
+    uint32_t string_count = request.argc + request.envc;
+    bool valid = request.magic == DAEMON_MAGIC && request.argc > 0 &&
+                 request.argc <= DAEMON_MAX_ARGS && request.envc <= DAEMON_MAX_ARGS &&
+                 request.length > 0 && request.length <= DAEMON_MAX_REQUEST;
+    if (valid)
+    {
+        payload = malloc(request.length);
+        strings = calloc(string_count, sizeof(char *));
+        valid = payload && strings && read_all(client, payload, request.length) &&
+                payload[request.length - 1] == '\0';
+    }
+
+    /* Split into cwd followed by exactly argc arguments and envc environment entries */
+    const char *cwd = payload;
+    if (valid)
+    {
+        char *p = payload + strlen(payload) + 1;
+        char *end = payload + request.length;
+        uint32_t count = 0;
+        while (p < end && count < string_count)
+        {
+            strings[count++] = p;
+            p += strlen(p) + 1;
+        }
+        valid = count == string_count && p == end;
+    }
+
+    /* parse_args expects a NULL-terminated argv like main's */
+    int argc = (int)request.argc;
+    int envc = (int)request.envc;
+    char **argv = valid ? calloc((size_t)argc + 1, sizeof(char *)) : NULL;
+    char **env = valid ? strings + argc : NULL;
+    valid = valid && argv;
+    if (valid)
+    {
+        memcpy(argv, strings, (size_t)argc * sizeof(char *));
+    }
+
+    if (valid && daemon_can_forward(argc, argv) && shares_environment(env, envc))
+    {
+        log_info("Serving daemon request: %s", find_command(argc, argv));
+
+        char *saved_environment[ARRAY_COUNT(request_environment)] = { 0 };
+        swap_environment(env, envc, saved_environment);
+        watch_client(client, true);
+        status = run_request(argc, argv, cwd, fds, home_dir);
+        watch_client(client, false);
+        swap_environment(NULL, 0, saved_environment);
+    }
+    else
+    {
+        log_info("Declined daemon request; the client will run it directly");
+        for (int i = 0; i < DAEMON_FD_COUNT; i++)
+        {
+            close(fds[i]);
+        }
+    }
+
+    send_all(client, &status, sizeof(status));
+    free(argv);
+    free(strings);
+    free(payload);
+}
+
+int
+daemon_run(void)
+{
+    char path[PATH_MAX];
+    if (!daemon_socket_path(path, sizeof(path)))
+    {
+        fprintf(stderr, "Error: XDG_RUNTIME_DIR is not set; cannot create the daemon socket\n");
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Error: Socket path is too long: %s\n", path);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+
+    int existing = connect_socket(path);
+    if (existing >= 0)
+    {
+        close(existing);
+        fprintf(stderr, "Error: A hostman daemon is already listening on %s\n", path);
+        return EXIT_FAILURE;
+    }
+    unlink(path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0)
+    {
+        fprintf(stderr, "Error: Failed to create socket: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    mode_t old_umask = umask(0077);
+    int bound = bind(server, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_umask);
+    if (bound != 0 || listen(server, 16) != 0)
+    {
+        fprintf(stderr, "Error: Failed to listen on %s: %s\n", path, strerror(errno));
+        close(server);
+        return EXIT_FAILURE;
+    }
+
+    int home_dir = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (home_dir < 0)
+    {
+        fprintf(stderr, "Error: Failed to open working directory: %s\n", strerror(errno));
+        close(server);
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction action = { .sa_handler = handle_stop_signal };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sigaction client_action = { .sa_handler = handle_client_signal,
+                                       .sa_flags = SA_RESTART };
+    sigemptyset(&client_action.sa_mask);
+    sigaction(SIGIO, &client_action, NULL);
+
+    /* Prompts without a trailing newline must reach the client before it is asked for input */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    config_set_resident(true);
+    network_set_resident(true);
+    cli_set_resident(true);
+    config_load();
+
+    log_info("Daemon listening on %s", path);
+    printf("hostman daemon listening on %s\n", path);
+
+    while (!stop_requested)
+    {
+        int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            log_error("Daemon accept failed: %s", strerror(errno));
+            break;
+        }
+
+        serve_client(client, home_dir);
+        close(client);
+    }
+
+    log_info("Daemon shutting down");
+    close(server);
+    close(home_dir);
+    unlink(path);
+    cli_set_resident(false);
+    network_set_resident(false);
+    config_set_resident(false);
+
+    return EXIT_SUCCESS;
+}
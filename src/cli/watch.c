@@ -0,0 +1,313 @@
+#include "hostman/cli/watch.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/notification.h"
+#include "hostman/core/utils.h"
+#include "hostman/core/walk.h"
+#include "hostman/network/network.h"
+#include "hostman/storage/database.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#define WATCH_EVENT_BUFFER 4096
+
+/* A file is uploaded once no event has touched it for the debounce window */
+typedef struct
+{
+    char *name;
+    long long due_ms;
+} pending_file_t;
+
+typedef struct
+{
+    pending_file_t *files;
+    int count;
+    int capacity;
+} pending_list_t;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+handle_stop_signal(int signum)
+{
+    (void)signum;
+    stop_requested = 1;
+}
+
+static long long
+monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool
+pending_touch(pending_list_t *pending, const char *name, long long due_ms)
+{
+    for (int i = 0; i < pending->count; i++)
+    {
+        if (strcmp(pending->files[i].name, name) == 0)
+        {
+            pending->files[i].due_ms = due_ms;
+            return true;
+        }
+    }
+
+    if (pending->count == pending->capacity)
+    {
+        int capacity = pending->capacity ? pending->capacity * 2 : 16;
+        pending_file_t *files = realloc(pending->files, capacity * sizeof(pending_file_t));
+        if (!files)
+        {
+            return false;
+        }
+        pending->files = files;
+        pending->capacity = capacity;
+    }
+
+    char *copy = strdup(name);
+    if (!copy)
+    {
+        return false;
+    }
+    pending->files[pending->count].name = copy;
+    pending->files[pending->count].due_ms = due_ms;
+    pending->count++;
+    return true;
+}
+
+static int
+pending_timeout(const pending_list_t *pending, long long now)
+{
+    if (pending->count == 0)
+    {
+        return -1;
+    }
+
+    long long earliest = pending->files[0].due_ms;
+    for (int i = 1; i < pending->count; i++)
+    {
+        if (pending->files[i].due_ms < earliest)
+        {
+            earliest = pending->files[i].due_ms;
+        }
+    }
+    return earliest <= now ? 0 : (int)(earliest - now);
+}
+
+static void
+pending_free(pending_list_t *pending)
+{
+    for (int i = 0; i < pending->count; i++)
+    {
+        free(pending->files[i].name);
+    }
+    free(pending->files);
+}
+
+static void
+upload_watched_file(network_session_t *session,
+                    const command_args_t *args,
+                    hostman_config_t *config,
+                    host_config_t *host,
+                    const char *path,
+                    const char *name)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+    {
+        return;
+    }
+
+    char size_str[32];
+    format_file_size(file_stat.st_size, size_str, sizeof(size_str));
+    print_info("  Uploading %s (%s)...\n", name, size_str);
+
+    network_upload_options_t options = { .root = args->directory };
+    upload_response_t *response = network_upload_file(session, path, host, &options);
+    if (!response || !response->success)
+    {
+        const char *error = response && response->error_message ? response->error_message
+                                                                : "Upload failed";
+        print_error("  %s: %s\n", name, error);
+        notify_send_error("Upload failed", error);
+        log_error("Watch upload of %s failed: %s", path, error);
+        network_free_response(response);
+        return;
+    }
+
+    printf("  \033[1;32m%s\033[0m\n", response->url);
+    notify_send("Upload successful", response->url);
+
+    const char *clipboard_manager = get_clipboard_manager_name();
+    if (clipboard_manager && !args->no_clipboard && config->copy_to_clipboard &&
+        copy_to_clipboard(response->url))
+    {
+        print_success("  URL copied to clipboard using %s\n", clipboard_manager);
+    }
+
+    db_add_upload(host->name,
+                  path,
+                  response->url,
+                  response->deletion_url,
+                  name,
+                  (size_t)file_stat.st_size,
+                  response->content_hash,
+                  &response->timing);
+
+    network_free_response(response);
+}
+
+static void
+upload_due_files(network_session_t *session,
+                 const command_args_t *args,
+                 hostman_config_t *config,
+                 host_config_t *host,
+                 pending_list_t *pending)
+{
+    int i = 0;
+    while (i < pending->count && !stop_requested)
+    {
+        if (pending->files[i].due_ms > monotonic_ms())
+        {
+            i++;
+            continue;
+        }
+
+        char *name = pending->files[i].name;
+        pending->files[i] = pending->files[--pending->count];
+
+        char path[PATH_MAX];
+        int written = snprintf(path, sizeof(path), "%s/%s", args->directory, name);
+        if (written > 0 && (size_t)written < sizeof(path))
+        {
+            upload_watched_file(session, args, config, host, path, name);
+        }
+        free(name);
+    }
+}
+
+/* Returns false once the watched directory itself is gone */
+static bool
+read_events(int fd, const command_args_t *args, pending_list_t *pending)
+{
+    char buffer[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;)
+    {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            return true;
+        }
+
+        long long due_ms = monotonic_ms() + args->debounce_ms;
+        for (char *ptr = buffer; ptr < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                log_warn("Watch event queue overflowed; some files may not be uploaded");
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                return false;
+            }
+            if ((event->mask & IN_ISDIR) || event->len == 0 ||
+                !walk_name_matches(event->name,
+                                   args->include_patterns,
+                                   args->include_count,
+                                   args->exclude_patterns,
+                                   args->exclude_count))
+            {
+                continue;
+            }
+            if (!pending_touch(pending, event->name, due_ms))
+            {
+                log_error("Out of memory queueing %s for upload", event->name);
+            }
+        }
+    }
+}
+
+bool
+watch_directory(const command_args_t *args, hostman_config_t *config, host_config_t *host)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        print_error("Error: Failed to initialize inotify: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (inotify_add_watch(fd, args->directory, WATCH_EVENTS | IN_ONLYDIR) < 0)
+    {
+        print_error("Error: Cannot watch '%s': %s\n", args->directory, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    struct sigaction action = { .sa_handler = handle_stop_signal };
+    struct sigaction old_int;
+    struct sigaction old_term;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    stop_requested = 0;
+
+    print_section_header("WATCH");
+    print_info("  Watching %s, uploading to %s (Ctrl+C to stop)\n\n", args->directory, host->name);
+    fflush(stdout);
+    log_info("Watching %s for new files", args->directory);
+
+    network_session_t *session = network_session_create();
+    pending_list_t pending = { 0 };
+    bool ok = true;
+
+    while (!stop_requested)
+    {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, pending_timeout(&pending, monotonic_ms()));
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            print_error("Error: Failed to wait for file events: %s\n", strerror(errno));
+            ok = false;
+            break;
+        }
+
+        if (ready > 0 && !read_events(fd, args, &pending))
+        {
+            print_error("Error: '%s' was removed or moved; stopping\n", args->directory);
+            ok = false;
+            break;
+        }
+
+        upload_due_files(session, args, config, host, &pending);
+        fflush(stdout);
+    }
+
+    log_info("Stopped watching %s", args->directory);
+    pending_free(&pending);
+    network_session_free(session);
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    close(fd);
+    return ok;
+}
@@ -11,6 +11,20 @@
 #include <cJSON.h>
 
 static hostman_config_t *current_config = NULL;
+static bool config_resident = false;
+static struct stat current_config_stat;
+
+static void
+config_destroy(hostman_config_t *config);
+
+static void
+remember_config_stat(const char *path)
+{
+    if (stat(path, &current_config_stat) != 0)
+    {
+        memset(&current_config_stat, 0, sizeof(current_config_stat));
+    }
+}
 
 char *
 config_get_path(void)
@@ -106,6 +120,72 @@ parse_host_config(cJSON *host_json, const char *name)
         }
     }
 
+    cJSON *request_method = cJSON_GetObjectItem(host_json, "request_method");
+    if (request_method && cJSON_IsString(request_method))
+    {
+        const char *method = cJSON_GetStringValue(request_method);
+        if (method && strlen(method) > 0 && strlen(method) < 16)
+        {
+            host->request_method = strdup(method);
+        }
+    }
+
+    cJSON *upload_source = cJSON_GetObjectItem(host_json, "upload_source");
+    if (upload_source && cJSON_IsString(upload_source))
+    {
+        const char *value = cJSON_GetStringValue(upload_source);
+        if (value && strlen(value) > 0 && strlen(value) < 16)
+        {
+            host->upload_source = strdup(value);
+        }
+    }
+
+    cJSON *limit_rate = cJSON_GetObjectItem(host_json, "limit_rate");
+    if (limit_rate && cJSON_IsString(limit_rate))
+    {
+        const char *value = cJSON_GetStringValue(limit_rate);
+        if (value && strlen(value) > 0 && strlen(value) < 32)
+        {
+            host->limit_rate = strdup(value);
+        }
+    }
+
+    cJSON *max_response_size = cJSON_GetObjectItem(host_json, "max_response_size");
+    if (max_response_size && cJSON_IsString(max_response_size))
+    {
+        const char *value = cJSON_GetStringValue(max_response_size);
+        if (value && strlen(value) > 0 && strlen(value) < 32)
+        {
+            host->max_response_size = strdup(value);
+        }
+    }
+
+    cJSON *chunk_size = cJSON_GetObjectItem(host_json, "chunk_size");
+    if (chunk_size && cJSON_IsString(chunk_size))
+    {
+        const char *value = cJSON_GetStringValue(chunk_size);
+        if (value && strlen(value) > 0 && strlen(value) < 32)
+        {
+            host->chunk_size = strdup(value);
+        }
+    }
+
+    cJSON *region = cJSON_GetObjectItem(host_json, "region");
+    if (region && cJSON_IsString(region))
+    {
+        const char *value = cJSON_GetStringValue(region);
+        if (value && strlen(value) > 0 && strlen(value) < 64)
+        {
+            host->region = strdup(value);
+        }
+    }
+
+    cJSON *part_concurrency = cJSON_GetObjectItem(host_json, "part_concurrency");
+    if (part_concurrency && cJSON_IsNumber(part_concurrency) && part_concurrency->valueint > 0)
+    {
+        host->part_concurrency = part_concurrency->valueint;
+    }
+
     cJSON *file_form_field = cJSON_GetObjectItem(host_json, "file_form_field");
     if (file_form_field && cJSON_IsString(file_form_field))
     {
@@ -167,6 +247,8 @@ parse_host_config(cJSON *host_json, const char *name)
         }
     }
 
+    config_compile_host_paths(host);
+
     return host;
 }
 
@@ -253,6 +335,18 @@ parse_config(cJSON *json)
         config->clipboard_manager = strdup(clipboard_manager->valuestring);
     }
 
+    cJSON *db_mmap_size = cJSON_GetObjectItem(json, "db_mmap_size");
+    if (db_mmap_size && cJSON_IsString(db_mmap_size))
+    {
+        config->db_mmap_size = strdup(db_mmap_size->valuestring);
+    }
+
+    cJSON *db_cache_size = cJSON_GetObjectItem(json, "db_cache_size");
+    if (db_cache_size && cJSON_IsString(db_cache_size))
+    {
+        config->db_cache_size = strdup(db_cache_size->valuestring);
+    }
+
     cJSON *hosts = cJSON_GetObjectItem(json, "hosts");
     if (hosts && cJSON_IsObject(hosts))
     {
@@ -315,6 +409,41 @@ host_config_to_json(host_config_t *host)
         cJSON_AddStringToObject(json, "request_body_format", host->request_body_format);
     }
 
+    if (host->request_method)
+    {
+        cJSON_AddStringToObject(json, "request_method", host->request_method);
+    }
+
+    if (host->upload_source)
+    {
+        cJSON_AddStringToObject(json, "upload_source", host->upload_source);
+    }
+
+    if (host->limit_rate)
+    {
+        cJSON_AddStringToObject(json, "limit_rate", host->limit_rate);
+    }
+
+    if (host->max_response_size)
+    {
+        cJSON_AddStringToObject(json, "max_response_size", host->max_response_size);
+    }
+
+    if (host->chunk_size)
+    {
+        cJSON_AddStringToObject(json, "chunk_size", host->chunk_size);
+    }
+
+    if (host->region)
+    {
+        cJSON_AddStringToObject(json, "region", host->region);
+    }
+
+    if (host->part_concurrency > 0)
+    {
+        cJSON_AddNumberToObject(json, "part_concurrency", host->part_concurrency);
+    }
+
     if (host->file_form_field)
     {
         cJSON_AddStringToObject(json, "file_form_field", host->file_form_field);
@@ -377,6 +506,16 @@ config_to_json(hostman_config_t *config)
         cJSON_AddStringToObject(json, "clipboard_manager", config->clipboard_manager);
     }
 
+    if (config->db_mmap_size)
+    {
+        cJSON_AddStringToObject(json, "db_mmap_size", config->db_mmap_size);
+    }
+
+    if (config->db_cache_size)
+    {
+        cJSON_AddStringToObject(json, "db_cache_size", config->db_cache_size);
+    }
+
     cJSON *hosts = cJSON_CreateObject();
     for (int i = 0; i < config->host_count; i++)
     {
@@ -470,13 +609,15 @@ config_load(void)
     }
 
     free(buffer);
-    free(path);
 
     if (config)
     {
         current_config = config;
+        remember_config_stat(path);
     }
 
+    free(path);
+
     return config;
 }
 
@@ -550,9 +691,10 @@ config_save(hostman_config_t *config)
 
         if (current_config && current_config != config)
         {
-            config_free(current_config);
+            config_destroy(current_config);
         }
         current_config = config;
+        remember_config_stat(path);
     }
 
     free(path);
@@ -612,6 +754,20 @@ config_get_value(const char *key)
             value = strdup(config->clipboard_manager);
         }
     }
+    else if (strcmp(key, "db_mmap_size") == 0)
+    {
+        if (config->db_mmap_size)
+        {
+            value = strdup(config->db_mmap_size);
+        }
+    }
+    else if (strcmp(key, "db_cache_size") == 0)
+    {
+        if (config->db_cache_size)
+        {
+            value = strdup(config->db_cache_size);
+        }
+    }
     else
     {
         if (strncmp(key, "hosts.", 6) == 0)
@@ -666,6 +822,57 @@ config_get_value(const char *key)
                             value = strdup(host->request_body_format);
                         }
                     }
+                    else if (strcmp(prop, "request_method") == 0)
+                    {
+                        if (host->request_method)
+                        {
+                            value = strdup(host->request_method);
+                        }
+                    }
+                    else if (strcmp(prop, "upload_source") == 0)
+                    {
+                        if (host->upload_source)
+                        {
+                            value = strdup(host->upload_source);
+                        }
+                    }
+                    else if (strcmp(prop, "limit_rate") == 0)
+                    {
+                        if (host->limit_rate)
+                        {
+                            value = strdup(host->limit_rate);
+                        }
+                    }
+                    else if (strcmp(prop, "max_response_size") == 0)
+                    {
+                        if (host->max_response_size)
+                        {
+                            value = strdup(host->max_response_size);
+                        }
+                    }
+                    else if (strcmp(prop, "chunk_size") == 0)
+                    {
+                        if (host->chunk_size)
+                        {
+                            value = strdup(host->chunk_size);
+                        }
+                    }
+                    else if (strcmp(prop, "region") == 0)
+                    {
+                        if (host->region)
+                        {
+                            value = strdup(host->region);
+                        }
+                    }
+                    else if (strcmp(prop, "part_concurrency") == 0)
+                    {
+                        if (host->part_concurrency > 0)
+                        {
+                            char number[16];
+                            snprintf(number, sizeof(number), "%d", host->part_concurrency);
+                            value = strdup(number);
+                        }
+                    }
                     else if (strcmp(prop, "file_form_field") == 0)
                     {
                         if (host->file_form_field)
@@ -805,6 +1012,20 @@ config_set_value(const char *key, const char *value)
         config->clipboard_manager = strdup(value);
         changed = true;
     }
+    else if (strcmp(key, "db_mmap_size") == 0 || strcmp(key, "db_cache_size") == 0)
+    {
+        long long bytes = 0;
+        if (strcmp(value, "0") != 0 && !parse_byte_size(value, &bytes))
+        {
+            log_error("Invalid size '%s' for %s. Use bytes or a K, M or G suffix", value, key);
+            return false;
+        }
+        char **field =
+          strcmp(key, "db_mmap_size") == 0 ? &config->db_mmap_size : &config->db_cache_size;
+        free(*field);
+        *field = strdup(value);
+        changed = true;
+    }
     else
     {
         if (strncmp(key, "hosts.", 6) == 0)
@@ -855,6 +1076,51 @@ config_set_value(const char *key, const char *value)
                         host->request_body_format = strdup(value);
                         changed = true;
                     }
+                    else if (strcmp(prop, "request_method") == 0)
+                    {
+                        free(host->request_method);
+                        host->request_method = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "upload_source") == 0)
+                    {
+                        free(host->upload_source);
+                        host->upload_source = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "limit_rate") == 0)
+                    {
+                        free(host->limit_rate);
+                        host->limit_rate = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "max_response_size") == 0)
+                    {
+                        free(host->max_response_size);
+                        host->max_response_size = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "chunk_size") == 0)
+                    {
+                        free(host->chunk_size);
+                        host->chunk_size = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "region") == 0)
+                    {
+                        free(host->region);
+                        host->region = strdup(value);
+                        changed = true;
+                    }
+                    else if (strcmp(prop, "part_concurrency") == 0)
+                    {
+                        int concurrency = atoi(value);
+                        if (concurrency > 0)
+                        {
+                            host->part_concurrency = concurrency;
+                            changed = true;
+                        }
+                    }
                     else if (strcmp(prop, "file_form_field") == 0)
                     {
                         free(host->file_form_field);
@@ -865,12 +1131,14 @@ config_set_value(const char *key, const char *value)
                     {
                         free(host->response_url_json_path);
                         host->response_url_json_path = strdup(value);
+                        config_compile_host_paths(host);
                         changed = true;
                     }
                     else if (strcmp(prop, "response_deletion_url_json_path") == 0)
                     {
                         free(host->response_deletion_url_json_path);
                         host->response_deletion_url_json_path = strdup(value);
+                        config_compile_host_paths(host);
                         changed = true;
                     }
                 }
@@ -983,6 +1251,12 @@ config_remove_host(const char *host_name)
             free(config->hosts[i]->api_key_name);
             free(config->hosts[i]->api_key);
             free(config->hosts[i]->request_body_format);
+            free(config->hosts[i]->request_method);
+            free(config->hosts[i]->max_response_size);
+            free(config->hosts[i]->chunk_size);
+            free(config->hosts[i]->region);
+            free(config->hosts[i]->limit_rate);
+            free(config->hosts[i]->upload_source);
             free(config->hosts[i]->file_form_field);
             free(config->hosts[i]->response_url_json_path);
             free(config->hosts[i]->response_deletion_url_json_path);
@@ -1112,8 +1386,80 @@ config_get_host(const char *host_name)
     return NULL;
 }
 
+void
+config_compile_host_paths(host_config_t *host)
+{
+    if (!json_path_is_compiled_from(&host->response_url_path, host->response_url_json_path) &&
+        !json_path_compile(&host->response_url_path, host->response_url_json_path) &&
+        host->response_url_json_path && host->response_url_json_path[0] != '\0')
+    {
+        log_warn("Host '%s' has an invalid response URL path: %s",
+                 host->name,
+                 host->response_url_json_path);
+    }
+
+    if (!json_path_is_compiled_from(&host->response_deletion_url_path,
+                                    host->response_deletion_url_json_path) &&
+        !json_path_compile(&host->response_deletion_url_path,
+                           host->response_deletion_url_json_path) &&
+        host->response_deletion_url_json_path && host->response_deletion_url_json_path[0] != '\0')
+    {
+        log_warn("Host '%s' has an invalid deletion URL path: %s",
+                 host->name,
+                 host->response_deletion_url_json_path);
+    }
+}
+
+void
+config_set_resident(bool resident)
+{
+    config_resident = resident;
+}
+
+bool
+config_reload_if_changed(void)
+{
+    if (!current_config)
+    {
+        return false;
+    }
+
+    char *path = config_get_path();
+    if (!path)
+    {
+        return false;
+    }
+
+    struct stat st;
+    bool changed = stat(path, &st) != 0 || st.st_ino != current_config_stat.st_ino ||
+                   st.st_size != current_config_stat.st_size ||
+                   st.st_mtim.tv_sec != current_config_stat.st_mtim.tv_sec ||
+                   st.st_mtim.tv_nsec != current_config_stat.st_mtim.tv_nsec;
+    free(path);
+
+    if (!changed)
+    {
+        return false;
+    }
+
+    log_info("Configuration file changed, reloading");
+    config_destroy(current_config);
+    return config_load() != NULL;
+}
+
 void
 config_free(hostman_config_t *config)
+{
+    if (config_resident && config == current_config)
+    {
+        return;
+    }
+
+    config_destroy(config);
+}
+
+static void
+config_destroy(hostman_config_t *config)
 {
     if (!config)
     {
@@ -1124,6 +1470,8 @@ config_free(hostman_config_t *config)
     free(config->log_level);
     free(config->log_file);
     free(config->clipboard_manager);
+    free(config->db_mmap_size);
+    free(config->db_cache_size);
 
     for (int i = 0; i < config->host_count; i++)
     {
@@ -1135,6 +1483,12 @@ config_free(hostman_config_t *config)
             free(config->hosts[i]->api_key_name);
             free(config->hosts[i]->api_key);
             free(config->hosts[i]->request_body_format);
+            free(config->hosts[i]->request_method);
+            free(config->hosts[i]->max_response_size);
+            free(config->hosts[i]->chunk_size);
+            free(config->hosts[i]->region);
+            free(config->hosts[i]->limit_rate);
+            free(config->hosts[i]->upload_source);
             free(config->hosts[i]->file_form_field);
             free(config->hosts[i]->response_url_json_path);
             free(config->hosts[i]->response_deletion_url_json_path);
@@ -0,0 +1,614 @@
+#include "hostman/core/jsonpath.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCAN_ERROR (-1)
+#define SCAN_CONTINUE 0
+#define SCAN_DONE 1
+
+typedef struct
+{
+    const char *p;
+    const char *end;
+    json_path_match_t *matches;
+    int count;
+    int remaining;
+} json_scanner_t;
+
+bool
+json_path_compile(json_path_t *path, const char *expression)
+{
+    path->valid = false;
+    path->segment_count = 0;
+    path->expression[0] = '\0';
+
+    if (!expression)
+    {
+        return false;
+    }
+
+    size_t expression_len = strlen(expression);
+    if (expression_len >= sizeof(path->expression))
+    {
+        return false;
+    }
+    memcpy(path->expression, expression, expression_len + 1);
+
+    const char *p = path->expression;
+    while (*p != '\0')
+    {
+        if (*p == '.')
+        {
+            p++;
+            continue;
+        }
+
+        if (*p != '[')
+        {
+            const char *key_start = p;
+            while (*p != '\0' && *p != '.' && *p != '[')
+            {
+                p++;
+            }
+
+            if (path->segment_count == JSON_PATH_MAX_SEGMENTS)
+            {
+                return false;
+            }
+
+            json_path_segment_t *segment = &path->segments[path->segment_count++];
+            segment->offset = (unsigned short)(key_start - path->expression);
+            segment->length = (unsigned short)(p - key_start);
+            segment->index = -1;
+        }
+
+        while (*p == '[')
+        {
+            p++;
+
+            if (!isdigit((unsigned char)*p))
+            {
+                return false;
+            }
+
+            int index = 0;
+            while (isdigit((unsigned char)*p))
+            {
+                if (index > 100000000)
+                {
+                    return false;
+                }
+                index = index * 10 + (*p - '0');
+                p++;
+            }
+
+            if (*p != ']' || path->segment_count == JSON_PATH_MAX_SEGMENTS)
+            {
+                return false;
+            }
+            p++;
+
+            json_path_segment_t *segment = &path->segments[path->segment_count++];
+            segment->offset = 0;
+            segment->length = 0;
+            segment->index = index;
+        }
+    }
+
+    path->valid = path->segment_count > 0;
+    return path->valid;
+}
+
+bool
+json_path_is_compiled_from(const json_path_t *path, const char *expression)
+{
+    return strcmp(path->expression, expression ? expression : "") == 0;
+}
+
+static int
+hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static long
+parse_hex4(const char *p, const char *end)
+{
+    if (end - p < 4)
+    {
+        return -1;
+    }
+
+    long value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int digit = hex_value(p[i]);
+        if (digit < 0)
+        {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+
+    return value;
+}
+
+/* Decodes one character of raw string contents into UTF-8; returns the byte count or -1 */
+static int
+decode_char(const char **cursor, const char *end, char out[4])
+{
+    const char *p = *cursor;
+
+    if (*p != '\\')
+    {
+        out[0] = *p;
+        *cursor = p + 1;
+        return 1;
+    }
+
+    if (end - p < 2)
+    {
+        return -1;
+    }
+
+    char simple;
+    switch (p[1])
+    {
+        case '"':
+        case '\\':
+        case '/':
+            simple = p[1];
+            break;
+        case 'b':
+            simple = '\b';
+            break;
+        case 'f':
+            simple = '\f';
+            break;
+        case 'n':
+            simple = '\n';
+            break;
+        case 'r':
+            simple = '\r';
+            break;
+        case 't':
+            simple = '\t';
+            break;
+        case 'u':
+            simple = 0;
+            break;
+        default:
+            return -1;
+    }
+
+    if (simple)
+    {
+        out[0] = simple;
+        *cursor = p + 2;
+        return 1;
+    }
+
+    long code = parse_hex4(p + 2, end);
+    if (code < 0)
+    {
+        return -1;
+    }
+    p += 6;
+
+    if (code >= 0xD800 && code <= 0xDBFF)
+    {
+        long low = end - p >= 6 && p[0] == '\\' && p[1] == 'u' ? parse_hex4(p + 2, end) : -1;
+        if (low < 0xDC00 || low > 0xDFFF)
+        {
+            return -1;
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        p += 6;
+    }
+
+    *cursor = p;
+
+    if (code < 0x80)
+    {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+/* Keys compare case-insensitively, matching the cJSON lookups this replaces */
+static bool
+key_equals(const char *raw, size_t raw_len, const char *key, size_t key_len)
+{
+    const char *cursor = raw;
+    const char *end = raw + raw_len;
+    size_t pos = 0;
+    char decoded[4];
+
+    while (cursor < end)
+    {
+        int n = decode_char(&cursor, end, decoded);
+        if (n < 0)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (pos >= key_len ||
+                tolower((unsigned char)decoded[i]) != tolower((unsigned char)key[pos]))
+            {
+                return false;
+            }
+            pos++;
+        }
+    }
+
+    return pos == key_len;
+}
+
+static void
+skip_whitespace(json_scanner_t *scanner)
+{
+    while (scanner->p < scanner->end &&
+           (*scanner->p == ' ' || *scanner->p == '\t' || *scanner->p == '\n' ||
+            *scanner->p == '\r'))
+    {
+        scanner->p++;
+    }
+}
+
+static bool
+scan_string(json_scanner_t *scanner, const char **value, size_t *length)
+{
+    const char *start = ++scanner->p;
+
+    while (scanner->p < scanner->end)
+    {
+        char c = *scanner->p;
+        if (c == '"')
+        {
+            if (value)
+            {
+                *value = start;
+                *length = (size_t)(scanner->p - start);
+            }
+            scanner->p++;
+            return true;
+        }
+
+        scanner->p += c == '\\' ? 2 : 1;
+    }
+
+    return false;
+}
+
+/* Values no path descends into are skipped without recursion so nesting depth is unbounded */
+static bool
+skip_value(json_scanner_t *scanner)
+{
+    int depth = 0;
+
+    do
+    {
+        skip_whitespace(scanner);
+        if (scanner->p >= scanner->end)
+        {
+            return false;
+        }
+
+        char c = *scanner->p;
+        if (c == '"')
+        {
+            if (!scan_string(scanner, NULL, NULL))
+            {
+                return false;
+            }
+        }
+        else if (c == '{' || c == '[')
+        {
+            depth++;
+            scanner->p++;
+        }
+        else if (c == '}' || c == ']' || c == ',' || c == ':')
+        {
+            if (depth == 0)
+            {
+                return false;
+            }
+            if (c == '}' || c == ']')
+            {
+                depth--;
+            }
+            scanner->p++;
+        }
+        else
+        {
+            const char *start = scanner->p;
+            while (scanner->p < scanner->end && !strchr(",:{}[]\" \t\r\n", *scanner->p))
+            {
+                scanner->p++;
+            }
+            if (scanner->p == start)
+            {
+                return false;
+            }
+        }
+    } while (depth > 0);
+
+    return true;
+}
+
+static int
+scan_value(json_scanner_t *scanner, int depth, uint32_t active);
+
+static uint32_t
+descend(json_scanner_t *scanner,
+        int depth,
+        uint32_t active,
+        const char *key,
+        size_t key_len,
+        int index)
+{
+    uint32_t next = 0;
+
+    for (int i = 0; i < scanner->count; i++)
+    {
+        json_path_match_t *match = &scanner->matches[i];
+        if (!(active & (1u << i)) || match->found || match->path->segment_count <= depth)
+        {
+            continue;
+        }
+
+        const json_path_segment_t *segment = &match->path->segments[depth];
+        bool hit = key ? segment->index < 0 &&
+                           key_equals(key,
+                                      key_len,
+                                      match->path->expression + segment->offset,
+                                      segment->length)
+                       : segment->index == index;
+        if (hit)
+        {
+            next |= 1u << i;
+        }
+    }
+
+    return next;
+}
+
+static int
+scan_object(json_scanner_t *scanner, int depth, uint32_t active)
+{
+    scanner->p++;
+    skip_whitespace(scanner);
+    if (scanner->p < scanner->end && *scanner->p == '}')
+    {
+        scanner->p++;
+        return SCAN_CONTINUE;
+    }
+
+    for (;;)
+    {
+        const char *key;
+        size_t key_len;
+
+        skip_whitespace(scanner);
+        if (scanner->p >= scanner->end || *scanner->p != '"' ||
+            !scan_string(scanner, &key, &key_len))
+        {
+            return SCAN_ERROR;
+        }
+
+        skip_whitespace(scanner);
+        if (scanner->p >= scanner->end || *scanner->p != ':')
+        {
+            return SCAN_ERROR;
+        }
+        scanner->p++;
+
+        uint32_t next = descend(scanner, depth, active, key, key_len, -1);
+        int status = scan_value(scanner, depth + 1, next);
+        if (status != SCAN_CONTINUE)
+        {
+            return status;
+        }
+
+        skip_whitespace(scanner);
+        if (scanner->p >= scanner->end)
+        {
+            return SCAN_ERROR;
+        }
+        if (*scanner->p == ',')
+        {
+            scanner->p++;
+            continue;
+        }
+        if (*scanner->p == '}')
+        {
+            scanner->p++;
+            return SCAN_CONTINUE;
+        }
+        return SCAN_ERROR;
+    }
+}
+
+static int
+scan_array(json_scanner_t *scanner, int depth, uint32_t active)
+{
+    scanner->p++;
+    skip_whitespace(scanner);
+    if (scanner->p < scanner->end && *scanner->p == ']')
+    {
+        scanner->p++;
+        return SCAN_CONTINUE;
+    }
+
+    for (int index = 0;; index++)
+    {
+        uint32_t next = descend(scanner, depth, active, NULL, 0, index);
+        int status = scan_value(scanner, depth + 1, next);
+        if (status != SCAN_CONTINUE)
+        {
+            return status;
+        }
+
+        skip_whitespace(scanner);
+        if (scanner->p >= scanner->end)
+        {
+            return SCAN_ERROR;
+        }
+        if (*scanner->p == ',')
+        {
+            scanner->p++;
+            continue;
+        }
+        if (*scanner->p == ']')
+        {
+            scanner->p++;
+            return SCAN_CONTINUE;
+        }
+        return SCAN_ERROR;
+    }
+}
+
+static int
+scan_value(json_scanner_t *scanner, int depth, uint32_t active)
+{
+    if (active == 0)
+    {
+        return skip_value(scanner) ? SCAN_CONTINUE : SCAN_ERROR;
+    }
+
+    skip_whitespace(scanner);
+    if (scanner->p >= scanner->end)
+    {
+        return SCAN_ERROR;
+    }
+
+    if (*scanner->p == '{')
+    {
+        return scan_object(scanner, depth, active);
+    }
+    if (*scanner->p == '[')
+    {
+        return scan_array(scanner, depth, active);
+    }
+    if (*scanner->p != '"')
+    {
+        return skip_value(scanner) ? SCAN_CONTINUE : SCAN_ERROR;
+    }
+
+    const char *value;
+    size_t length;
+    if (!scan_string(scanner, &value, &length))
+    {
+        return SCAN_ERROR;
+    }
+
+    for (int i = 0; i < scanner->count; i++)
+    {
+        json_path_match_t *match = &scanner->matches[i];
+        if ((active & (1u << i)) && !match->found && match->path->segment_count == depth)
+        {
+            match->value = value;
+            match->length = length;
+            match->found = true;
+            scanner->remaining--;
+        }
+    }
+
+    return scanner->remaining == 0 ? SCAN_DONE : SCAN_CONTINUE;
+}
+
+bool
+json_path_extract(const char *json, size_t length, json_path_match_t *matches, int count)
+{
+    if (!json || count > JSON_PATH_MAX_MATCHES)
+    {
+        return false;
+    }
+
+    json_scanner_t scanner = {
+        .p = json, .end = json + length, .matches = matches, .count = count, .remaining = 0
+    };
+    uint32_t active = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        matches[i].value = NULL;
+        matches[i].length = 0;
+        matches[i].found = false;
+        if (matches[i].path && matches[i].path->valid)
+        {
+            active |= 1u << i;
+            scanner.remaining++;
+        }
+    }
+
+    if (active == 0)
+    {
+        return true;
+    }
+
+    return scan_value(&scanner, 0, active) != SCAN_ERROR;
+}
+
+char *
+json_path_match_dup(const json_path_match_t *match)
+{
+    if (!match->found)
+    {
+        return NULL;
+    }
+
+    /* Unescaping never grows the string */
+    char *result = malloc(match->length + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    const char *cursor = match->value;
+    const char *end = match->value + match->length;
+    size_t pos = 0;
+
+    while (cursor < end)
+    {
+        int n = decode_char(&cursor, end, result + pos);
+        if (n < 0)
+        {
+            free(result);
+            return NULL;
+        }
+        pos += n;
+    }
+
+    result[pos] = '\0';
+    return result;
+}
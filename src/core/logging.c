@@ -161,7 +161,7 @@ logging_init(void)
             struct stat st;
             if (stat(cache_dir, &st) != 0 || !S_ISDIR(st.st_mode))
             {
-                mkdir(cache_dir, 0755);
+                mkdir(cache_dir, 0700);
             }
 
             log_file = fopen(log_path, "a");
@@ -1,6 +1,8 @@
 #include "hostman/core/utils.h"
+#include "hostman/core/jsonpath.h"
 #include "hostman/core/logging.h"
 #include <ctype.h>
+#include <errno.h>
 #include <math.h>
 #include <pwd.h>
 #include <stdio.h>
@@ -10,8 +12,6 @@
 #include <time.h>
 #include <unistd.h>
 
-#include <cJSON.h>
-
 char *
 get_filename_from_path(const char *path)
 {
@@ -54,6 +54,52 @@ format_file_size(size_t size, char *buffer, size_t buffer_size)
     }
 }
 
+bool
+parse_byte_size(const char *text, long long *bytes)
+{
+    if (!text || !isdigit((unsigned char)text[0]))
+    {
+        return false;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (errno != 0 || end == text || value <= 0)
+    {
+        return false;
+    }
+
+    double multiplier = 1;
+    switch (toupper((unsigned char)*end))
+    {
+        case '\0':
+            break;
+        case 'K':
+            multiplier = 1024.0;
+            end++;
+            break;
+        case 'M':
+            multiplier = 1024.0 * 1024.0;
+            end++;
+            break;
+        case 'G':
+            multiplier = 1024.0 * 1024.0 * 1024.0;
+            end++;
+            break;
+        default:
+            return false;
+    }
+
+    if (*end != '\0' || value * multiplier < 1 || value * multiplier > 9.0e18)
+    {
+        return false;
+    }
+
+    *bytes = (long long)(value * multiplier);
+    return true;
+}
+
 char *
 get_config_dir(void)
 {
@@ -140,102 +186,20 @@ extract_json_string(const char *json, const char *path)
         return NULL;
     }
 
-    char *result = NULL;
-
-    cJSON *root = cJSON_Parse(json);
-    if (!root)
+    json_path_t compiled;
+    if (!json_path_compile(&compiled, path))
     {
-        log_error("Failed to parse JSON: %s", cJSON_GetErrorPtr());
         return NULL;
     }
 
-    cJSON *current = root;
-    const char *p = path;
-
-    while (*p != '\0' && current)
-    {
-        if (*p == '.')
-        {
-            p++;
-            continue;
-        }
-
-        if (*p != '[')
-        {
-            const char *key_start = p;
-            while (*p != '\0' && *p != '.' && *p != '[')
-            {
-                p++;
-            }
-
-            size_t key_len = (size_t)(p - key_start);
-            if (key_len == 0)
-            {
-                current = NULL;
-                break;
-            }
-
-            char *key = malloc(key_len + 1);
-            if (!key)
-            {
-                cJSON_Delete(root);
-                return NULL;
-            }
-
-            memcpy(key, key_start, key_len);
-            key[key_len] = '\0';
-            current = cJSON_GetObjectItem(current, key);
-            free(key);
-
-            if (!current)
-            {
-                break;
-            }
-        }
-
-        while (*p == '[' && current)
-        {
-            p++;
-
-            if (!isdigit((unsigned char)*p))
-            {
-                current = NULL;
-                break;
-            }
-
-            int index = 0;
-            while (isdigit((unsigned char)*p))
-            {
-                index = index * 10 + (*p - '0');
-                p++;
-            }
-
-            if (*p != ']')
-            {
-                current = NULL;
-                break;
-            }
-
-            p++;
-
-            if (!cJSON_IsArray(current))
-            {
-                current = NULL;
-                break;
-            }
-
-            current = cJSON_GetArrayItem(current, index);
-        }
-    }
-
-    if (current && cJSON_IsString(current))
+    json_path_match_t match = { .path = &compiled };
+    if (!json_path_extract(json, strlen(json), &match, 1) && !match.found)
     {
-        result = strdup(current->valuestring);
+        log_error("Failed to parse JSON looking up %s", path);
+        return NULL;
     }
 
-    cJSON_Delete(root);
-
-    return result;
+    return json_path_match_dup(&match);
 }
 
 static const char *
@@ -862,7 +826,7 @@ read_clipboard_to_temp_file(void)
 
     if (access(cache_dir, F_OK) != 0)
     {
-        if (mkdir(cache_dir, 0755) != 0)
+        if (mkdir(cache_dir, 0700) != 0)
         {
             log_error("Failed to create cache directory: %s", cache_dir);
             free(data);
@@ -0,0 +1,546 @@
+#include "hostman/core/walk.h"
+#include "hostman/core/logging.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* How often a list reader waiting for input checks whether the walk was cancelled */
+#define DIR_WALK_LIST_POLL_MS 100
+
+/* Worker threads pop directories from a shared stack and push the files they find into a
+ * bounded ring, so the consumer can start uploading while the rest of the tree is walked */
+struct dir_walk
+{
+    dir_walk_options_t options;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t output_ready;
+    pthread_cond_t output_space;
+
+    char **directories;
+    int directory_count;
+    int directory_capacity;
+    int active;
+
+    dir_walk_entry_t queue[DIR_WALK_QUEUE_SIZE];
+    int queue_head;
+    int queue_count;
+
+    bool finished;
+    bool cancelled;
+
+    /* Set for a walk over a list of paths rather than a directory tree */
+    int list_fd;
+    char delimiter;
+    int list_error;
+
+    pthread_t threads[DIR_WALK_THREADS];
+    int thread_count;
+};
+
+static bool
+matches_any(char **patterns, int count, const char *name)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (fnmatch(patterns[i], name, FNM_PERIOD) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+walk_name_matches(const char *name,
+                  char **include_patterns,
+                  int include_count,
+                  char **exclude_patterns,
+                  int exclude_count)
+{
+    if (name[0] == '.')
+    {
+        return false;
+    }
+    if (include_count > 0 && !matches_any(include_patterns, include_count, name))
+    {
+        return false;
+    }
+    return !matches_any(exclude_patterns, exclude_count, name);
+}
+
+static bool
+name_wanted(const dir_walk_t *walk, const char *name)
+{
+    return walk_name_matches(name,
+                             walk->options.include_patterns,
+                             walk->options.include_count,
+                             walk->options.exclude_patterns,
+                             walk->options.exclude_count);
+}
+
+static char *
+join_path(const char *directory, const char *name)
+{
+    size_t dir_len = strlen(directory);
+    bool has_slash = dir_len > 0 && directory[dir_len - 1] == '/';
+    size_t len = dir_len + (has_slash ? 0 : 1) + strlen(name) + 1;
+
+    char *path = malloc(len);
+    if (path)
+    {
+        snprintf(path, len, "%s%s%s", directory, has_slash ? "" : "/", name);
+    }
+    return path;
+}
+
+/* Called with the mutex held */
+static bool
+push_directory(dir_walk_t *walk, char *path)
+{
+    if (walk->directory_count == walk->directory_capacity)
+    {
+        int capacity = walk->directory_capacity ? walk->directory_capacity * 2 : 64;
+        char **directories = realloc(walk->directories, capacity * sizeof(char *));
+        if (!directories)
+        {
+            return false;
+        }
+        walk->directories = directories;
+        walk->directory_capacity = capacity;
+    }
+
+    walk->directories[walk->directory_count++] = path;
+    pthread_cond_signal(&walk->work_ready);
+    return true;
+}
+
+static bool
+emit_file(dir_walk_t *walk, char *path)
+{
+    /* Listed paths may name missing files, which the consumer reports */
+    struct stat st;
+    dir_walk_entry_t entry = { .path = path };
+    if (walk->options.hash_contents && (walk->list_fd < 0 || stat(path, &st) == 0))
+    {
+        entry.hashed = content_hash_file(path, entry.content_hash);
+    }
+
+    pthread_mutex_lock(&walk->mutex);
+    while (walk->queue_count == DIR_WALK_QUEUE_SIZE && !walk->cancelled)
+    {
+        pthread_cond_wait(&walk->output_space, &walk->mutex);
+    }
+
+    if (walk->cancelled)
+    {
+        pthread_mutex_unlock(&walk->mutex);
+        free(path);
+        return false;
+    }
+
+    walk->queue[(walk->queue_head + walk->queue_count) % DIR_WALK_QUEUE_SIZE] = entry;
+    walk->queue_count++;
+    pthread_cond_signal(&walk->output_ready);
+    pthread_mutex_unlock(&walk->mutex);
+    return true;
+}
+
+static void
+scan_directory(dir_walk_t *walk, const char *directory)
+{
+    DIR *dir = opendir(directory);
+    if (!dir)
+    {
+        log_warn("Cannot open directory %s: %s", directory, strerror(errno));
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        /* Only file systems without d_type and symlinks need a stat; linked directories are
+         * not descended into, so a link cycle cannot trap the walk */
+        bool needs_stat = entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK;
+        bool is_dir = entry->d_type == DT_DIR && walk->options.recursive;
+        bool is_file = entry->d_type == DT_REG && name_wanted(walk, entry->d_name);
+        if (!is_dir && !is_file && !needs_stat)
+        {
+            continue;
+        }
+
+        char *path = join_path(directory, entry->d_name);
+        if (!path)
+        {
+            log_error("Out of memory walking %s", directory);
+            break;
+        }
+
+        if (needs_stat)
+        {
+            struct stat st;
+            if (stat(path, &st) != 0)
+            {
+                free(path);
+                continue;
+            }
+            is_file = S_ISREG(st.st_mode) && name_wanted(walk, entry->d_name);
+            is_dir = walk->options.recursive && entry->d_type == DT_UNKNOWN &&
+                     S_ISDIR(st.st_mode);
+        }
+
+        if (is_dir)
+        {
+            pthread_mutex_lock(&walk->mutex);
+            bool pushed = !walk->cancelled && push_directory(walk, path);
+            pthread_mutex_unlock(&walk->mutex);
+            if (!pushed)
+            {
+                free(path);
+            }
+        }
+        else if (is_file)
+        {
+            if (!emit_file(walk, path))
+            {
+                break;
+            }
+        }
+        else
+        {
+            free(path);
+        }
+    }
+
+    closedir(dir);
+}
+
+static void *
+walk_worker(void *userdata)
+{
+    dir_walk_t *walk = (dir_walk_t *)userdata;
+
+    pthread_mutex_lock(&walk->mutex);
+    for (;;)
+    {
+        while (walk->directory_count == 0 && walk->active > 0 && !walk->cancelled)
+        {
+            pthread_cond_wait(&walk->work_ready, &walk->mutex);
+        }
+
+        if (walk->cancelled || walk->directory_count == 0)
+        {
+            break;
+        }
+
+        char *directory = walk->directories[--walk->directory_count];
+        walk->active++;
+        pthread_mutex_unlock(&walk->mutex);
+
+        scan_directory(walk, directory);
+        free(directory);
+
+        pthread_mutex_lock(&walk->mutex);
+        walk->active--;
+        if (walk->directory_count == 0 && walk->active == 0)
+        {
+            walk->finished = true;
+            pthread_cond_broadcast(&walk->work_ready);
+            pthread_cond_broadcast(&walk->output_ready);
+        }
+    }
+    pthread_mutex_unlock(&walk->mutex);
+
+    return NULL;
+}
+
+/* Emits one line of the list, or nothing for an empty one. Returns false once cancelled. */
+static bool
+emit_line(dir_walk_t *walk, char *line, size_t length)
+{
+    while (walk->delimiter == '\n' && length > 0 && line[length - 1] == '\r')
+    {
+        length--;
+    }
+    if (length == 0)
+    {
+        return true;
+    }
+
+    char *path = strndup(line, length);
+    if (!path)
+    {
+        log_error("Out of memory reading the file list");
+        return false;
+    }
+    return emit_file(walk, path);
+}
+
+static void
+list_failed(dir_walk_t *walk, int error)
+{
+    log_error("Failed to read the file list: %s", strerror(error));
+    pthread_mutex_lock(&walk->mutex);
+    walk->list_error = error;
+    pthread_mutex_unlock(&walk->mutex);
+}
+
+/* Reads with poll so a list that is slow to arrive cannot keep a cancelled walk alive */
+static void *
+list_worker(void *userdata)
+{
+    dir_walk_t *walk = (dir_walk_t *)userdata;
+    char *buffer = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    bool running = true;
+
+    while (running)
+    {
+        pthread_mutex_lock(&walk->mutex);
+        running = !walk->cancelled;
+        pthread_mutex_unlock(&walk->mutex);
+
+        struct pollfd pfd = { .fd = walk->list_fd, .events = POLLIN };
+        int ready = running ? poll(&pfd, 1, DIR_WALK_LIST_POLL_MS) : 0;
+        if (ready < 0 && errno != EINTR)
+        {
+            list_failed(walk, errno);
+            break;
+        }
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        if (length == capacity)
+        {
+            size_t grown = capacity ? capacity * 2 : 4096;
+            char *resized = realloc(buffer, grown);
+            if (!resized)
+            {
+                log_error("Out of memory reading the file list");
+                break;
+            }
+            buffer = resized;
+            capacity = grown;
+        }
+
+        ssize_t count = read(walk->list_fd, buffer + length, capacity - length);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+        {
+            continue;
+        }
+        if (count < 0)
+        {
+            list_failed(walk, errno);
+            break;
+        }
+        if (count == 0)
+        {
+            emit_line(walk, buffer, length);
+            break;
+        }
+
+        size_t scanned = length;
+        length += (size_t)count;
+        size_t start = 0;
+        char *end;
+        while (running &&
+               (end = memchr(buffer + scanned, walk->delimiter, length - scanned)) != NULL)
+        {
+            size_t line_end = (size_t)(end - buffer);
+            running = emit_line(walk, buffer + start, line_end - start);
+            start = line_end + 1;
+            scanned = start;
+        }
+
+        memmove(buffer, buffer + start, length - start);
+        length -= start;
+    }
+
+    free(buffer);
+
+    pthread_mutex_lock(&walk->mutex);
+    walk->finished = true;
+    pthread_cond_broadcast(&walk->output_ready);
+    pthread_mutex_unlock(&walk->mutex);
+
+    return NULL;
+}
+
+static dir_walk_t *
+walk_create(const dir_walk_options_t *options)
+{
+    dir_walk_t *walk = calloc(1, sizeof(dir_walk_t));
+    if (!walk)
+    {
+        return NULL;
+    }
+
+    walk->options = *options;
+    walk->list_fd = -1;
+    pthread_mutex_init(&walk->mutex, NULL);
+    pthread_cond_init(&walk->work_ready, NULL);
+    pthread_cond_init(&walk->output_ready, NULL);
+    pthread_cond_init(&walk->output_space, NULL);
+    return walk;
+}
+
+dir_walk_t *
+dir_walk_list(int fd, char delimiter, const dir_walk_options_t *options)
+{
+    dir_walk_t *walk = walk_create(options);
+    if (!walk)
+    {
+        return NULL;
+    }
+
+    walk->list_fd = fd;
+    walk->delimiter = delimiter;
+
+    /* One reader keeps the paths in list order */
+    int error = pthread_create(&walk->threads[0], NULL, list_worker, walk);
+    if (error != 0)
+    {
+        log_warn("Failed to start file list reader thread: %s", strerror(error));
+        dir_walk_free(walk);
+        return NULL;
+    }
+    walk->thread_count = 1;
+
+    return walk;
+}
+
+int
+dir_walk_list_error(dir_walk_t *walk)
+{
+    pthread_mutex_lock(&walk->mutex);
+    int error = walk->list_error;
+    pthread_mutex_unlock(&walk->mutex);
+    return error;
+}
+
+dir_walk_t *
+dir_walk_start(const char *root, const dir_walk_options_t *options)
+{
+    dir_walk_t *walk = walk_create(options);
+    if (!walk)
+    {
+        return NULL;
+    }
+
+    char *root_copy = strdup(root);
+    if (!root_copy || !push_directory(walk, root_copy))
+    {
+        free(root_copy);
+        dir_walk_free(walk);
+        return NULL;
+    }
+
+    /* A single directory has nothing to parallelize but the hashing */
+    int threads = options->threads;
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    if (threads > DIR_WALK_THREADS)
+    {
+        threads = DIR_WALK_THREADS;
+    }
+    if (!options->recursive)
+    {
+        threads = 1;
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        int error = pthread_create(&walk->threads[walk->thread_count], NULL, walk_worker, walk);
+        if (error != 0)
+        {
+            log_warn("Failed to start directory walker thread: %s", strerror(error));
+            break;
+        }
+        walk->thread_count++;
+    }
+
+    if (walk->thread_count == 0)
+    {
+        dir_walk_free(walk);
+        return NULL;
+    }
+
+    return walk;
+}
+
+bool
+dir_walk_next(dir_walk_t *walk, dir_walk_entry_t *entry)
+{
+    pthread_mutex_lock(&walk->mutex);
+    while (walk->queue_count == 0 && !walk->finished)
+    {
+        pthread_cond_wait(&walk->output_ready, &walk->mutex);
+    }
+
+    if (walk->queue_count == 0)
+    {
+        pthread_mutex_unlock(&walk->mutex);
+        return false;
+    }
+
+    *entry = walk->queue[walk->queue_head];
+    walk->queue_head = (walk->queue_head + 1) % DIR_WALK_QUEUE_SIZE;
+    walk->queue_count--;
+    pthread_cond_signal(&walk->output_space);
+    pthread_mutex_unlock(&walk->mutex);
+
+    return true;
+}
+
+void
+dir_walk_free(dir_walk_t *walk)
+{
+    if (!walk)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&walk->mutex);
+    walk->cancelled = true;
+    pthread_cond_broadcast(&walk->work_ready);
+    pthread_cond_broadcast(&walk->output_space);
+    pthread_mutex_unlock(&walk->mutex);
+
+    for (int i = 0; i < walk->thread_count; i++)
+    {
+        pthread_join(walk->threads[i], NULL);
+    }
+
+    for (int i = 0; i < walk->queue_count; i++)
+    {
+        free(walk->queue[(walk->queue_head + i) % DIR_WALK_QUEUE_SIZE].path);
+    }
+    for (int i = 0; i < walk->directory_count; i++)
+    {
+        free(walk->directories[i]);
+    }
+    free(walk->directories);
+
+    pthread_cond_destroy(&walk->output_space);
+    pthread_cond_destroy(&walk->output_ready);
+    pthread_cond_destroy(&walk->work_ready);
+    pthread_mutex_destroy(&walk->mutex);
+    free(walk);
+}
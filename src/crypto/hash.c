@@ -0,0 +1,130 @@
+#include "hostman/crypto/hash.h"
+#include "hostman/core/logging.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HASH_READ_SIZE (64 * 1024)
+
+struct content_hash
+{
+    EVP_MD_CTX *ctx;
+};
+
+content_hash_t *
+content_hash_create(void)
+{
+    content_hash_t *hash = calloc(1, sizeof(content_hash_t));
+    if (!hash)
+    {
+        return NULL;
+    }
+
+    hash->ctx = EVP_MD_CTX_new();
+    if (!hash->ctx || !content_hash_reset(hash))
+    {
+        content_hash_free(hash);
+        return NULL;
+    }
+
+    return hash;
+}
+
+bool
+content_hash_update(content_hash_t *hash, const void *data, size_t size)
+{
+    return EVP_DigestUpdate(hash->ctx, data, size) == 1;
+}
+
+bool
+content_hash_reset(content_hash_t *hash)
+{
+    return EVP_DigestInit_ex(hash->ctx, EVP_sha256(), NULL) == 1;
+}
+
+bool
+content_hash_final(content_hash_t *hash, char *hex_out)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+
+    if (EVP_DigestFinal_ex(hash->ctx, digest, &digest_len) != 1)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < digest_len; i++)
+    {
+        snprintf(hex_out + i * 2, 3, "%02x", digest[i]);
+    }
+    hex_out[digest_len * 2] = '\0';
+
+    return true;
+}
+
+void
+content_hash_free(content_hash_t *hash)
+{
+    if (!hash)
+    {
+        return;
+    }
+
+    EVP_MD_CTX_free(hash->ctx);
+    free(hash);
+}
+
+bool
+content_hash_file(const char *path, char *hex_out)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error("Failed to open %s for hashing: %s", path, strerror(errno));
+        return false;
+    }
+
+    content_hash_t *hash = content_hash_create();
+    if (!hash)
+    {
+        close(fd);
+        return false;
+    }
+
+    char *buffer = malloc(HASH_READ_SIZE);
+    bool ok = buffer != NULL;
+
+    while (ok)
+    {
+        ssize_t n = read(fd, buffer, HASH_READ_SIZE);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("Failed to read %s for hashing: %s", path, strerror(errno));
+            ok = false;
+        }
+        else if (n == 0)
+        {
+            break;
+        }
+        else
+        {
+            ok = content_hash_update(hash, buffer, (size_t)n);
+        }
+    }
+
+    ok = ok && content_hash_final(hash, hex_out);
+
+    free(buffer);
+    content_hash_free(hash);
+    close(fd);
+
+    return ok;
+}
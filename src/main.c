@@ -1,4 +1,5 @@
 #include "hostman/cli/cli.h"
+#include "hostman/cli/daemon.h"
 #include "hostman/core/config.h"
 #include "hostman/core/logging.h"
 #include "hostman/core/notification.h"
@@ -24,6 +25,12 @@ main(int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
+    int forwarded_status;
+    if (daemon_can_forward(argc, argv) && daemon_forward(argc, argv, &forwarded_status))
+    {
+        return forwarded_status;
+    }
+
     logging_init();
 
     char *config_path = config_get_path();
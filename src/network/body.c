@@ -0,0 +1,475 @@
+#include "hostman/network/body.h"
+#include "hostman/core/logging.h"
+#include "hostman/network/ratelimit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <cJSON.h>
+
+#define BASE64_CHUNK_SIZE (3 * 4096)
+
+typedef enum
+{
+    BODY_STAGE_PREFIX,
+    BODY_STAGE_PAYLOAD,
+    BODY_STAGE_SUFFIX,
+    BODY_STAGE_DONE
+} body_stage_t;
+
+struct upload_body
+{
+    request_body_format_t format;
+    upload_source_t *source;
+    char *prefix;
+    size_t prefix_len;
+    const char *suffix;
+    size_t suffix_len;
+    body_stage_t stage;
+    size_t stage_offset;
+    unsigned char carry[3];
+    size_t carry_len;
+    bool paused;
+    /* A binary body limited to part of the source, e.g. one tus chunk */
+    bool ranged;
+    curl_off_t range_offset;
+    curl_off_t range_length;
+    curl_off_t range_remaining;
+};
+
+static const char base64_alphabet[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+request_body_format_t
+request_body_format_from_string(const char *format)
+{
+    if (!format || format[0] == '\0' || strcasecmp(format, "multipart") == 0)
+    {
+        return REQUEST_BODY_MULTIPART;
+    }
+
+    if (strcasecmp(format, "binary") == 0)
+    {
+        return REQUEST_BODY_BINARY;
+    }
+
+    if (strcasecmp(format, "json") == 0)
+    {
+        return REQUEST_BODY_JSON;
+    }
+
+    if (strcasecmp(format, "tus") == 0)
+    {
+        return REQUEST_BODY_TUS;
+    }
+
+    if (strcasecmp(format, "s3") == 0)
+    {
+        return REQUEST_BODY_S3;
+    }
+
+    return REQUEST_BODY_UNKNOWN;
+}
+
+static size_t
+base64_encode(const unsigned char *in, size_t len, char *out)
+{
+    size_t o = 0;
+    size_t i = 0;
+
+    for (; i + 2 < len; i += 3)
+    {
+        out[o++] = base64_alphabet[in[i] >> 2];
+        out[o++] = base64_alphabet[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+        out[o++] = base64_alphabet[((in[i + 1] & 0x0f) << 2) | (in[i + 2] >> 6)];
+        out[o++] = base64_alphabet[in[i + 2] & 0x3f];
+    }
+
+    if (i < len)
+    {
+        out[o++] = base64_alphabet[in[i] >> 2];
+        if (i + 1 < len)
+        {
+            out[o++] = base64_alphabet[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+            out[o++] = base64_alphabet[(in[i + 1] & 0x0f) << 2];
+        }
+        else
+        {
+            out[o++] = base64_alphabet[(in[i] & 0x03) << 4];
+            out[o++] = '=';
+        }
+        out[o++] = '=';
+    }
+
+    return o;
+}
+
+static bool
+build_json_envelope(upload_body_t *body, host_config_t *host)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < host->static_field_count; i++)
+    {
+        if (host->static_field_names[i] && host->static_field_values[i])
+        {
+            cJSON_AddStringToObject(
+              root, host->static_field_names[i], host->static_field_values[i]);
+        }
+    }
+    cJSON_AddStringToObject(root, host->file_form_field, "");
+
+    char *printed = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!printed)
+    {
+        return false;
+    }
+
+    size_t len = strlen(printed);
+    if (len < 2 || strcmp(printed + len - 2, "\"}") != 0)
+    {
+        free(printed);
+        return false;
+    }
+
+    printed[len - 2] = '\0';
+    body->prefix = printed;
+    body->prefix_len = len - 2;
+    body->suffix = "\"}";
+    body->suffix_len = 2;
+
+    return true;
+}
+
+upload_body_t *
+upload_body_create(request_body_format_t format, host_config_t *host, upload_source_t *source)
+{
+    if (!source || (format != REQUEST_BODY_BINARY && format != REQUEST_BODY_JSON))
+    {
+        return NULL;
+    }
+
+    upload_body_t *body = calloc(1, sizeof(upload_body_t));
+    if (!body)
+    {
+        return NULL;
+    }
+
+    body->format = format;
+    body->source = source;
+    body->suffix = "";
+
+    if (format == REQUEST_BODY_JSON && !build_json_envelope(body, host))
+    {
+        log_error("Failed to build JSON request body");
+        free(body);
+        return NULL;
+    }
+
+    return body;
+}
+
+curl_off_t
+upload_body_size(const upload_body_t *body)
+{
+    if (body->ranged)
+    {
+        return body->range_length;
+    }
+
+    curl_off_t payload = upload_source_size(body->source);
+    if (payload < 0)
+    {
+        return -1;
+    }
+
+    if (body->format == REQUEST_BODY_JSON)
+    {
+        payload = (payload + 2) / 3 * 4;
+    }
+
+    return (curl_off_t)body->prefix_len + payload + (curl_off_t)body->suffix_len;
+}
+
+bool
+upload_body_rewind(upload_body_t *body)
+{
+    if (body->ranged ? !upload_source_seek(body->source, body->range_offset)
+                     : !upload_source_rewind(body->source))
+    {
+        return false;
+    }
+
+    body->range_remaining = body->range_length;
+    body->stage = BODY_STAGE_PREFIX;
+    body->stage_offset = 0;
+    body->carry_len = 0;
+    body->paused = false;
+
+    return true;
+}
+
+bool
+upload_body_set_range(upload_body_t *body, curl_off_t offset, curl_off_t length)
+{
+    if (body->format != REQUEST_BODY_BINARY || offset < 0 || length < 0)
+    {
+        return false;
+    }
+
+    body->ranged = true;
+    body->range_offset = offset;
+    body->range_length = length;
+
+    return upload_body_rewind(body);
+}
+
+static size_t
+copy_literal(upload_body_t *body, const char *text, size_t len, char *out, size_t space)
+{
+    size_t n = len - body->stage_offset;
+    if (n > space)
+    {
+        n = space;
+    }
+
+    if (n > 0)
+    {
+        memcpy(out, text + body->stage_offset, n);
+    }
+    body->stage_offset += n;
+
+    if (body->stage_offset == len)
+    {
+        body->stage++;
+        body->stage_offset = 0;
+    }
+
+    return n;
+}
+
+static size_t
+read_base64_payload(upload_body_t *body, char *out, size_t space)
+{
+    unsigned char raw[BASE64_CHUNK_SIZE];
+    size_t written = 0;
+
+    while (space - written >= 4)
+    {
+        size_t want = (space - written) / 4 * 3;
+        if (want > sizeof(raw))
+        {
+            want = sizeof(raw);
+        }
+
+        size_t have = body->carry_len;
+        memcpy(raw, body->carry, have);
+        body->carry_len = 0;
+
+        size_t n = upload_source_read(body->source, (char *)raw + have, want - have);
+        if (n == UPLOAD_SOURCE_ERROR)
+        {
+            return UPLOAD_SOURCE_ERROR;
+        }
+
+        have += n;
+
+        if (n == 0)
+        {
+            written += base64_encode(raw, have, out + written);
+            body->stage = BODY_STAGE_SUFFIX;
+            body->stage_offset = 0;
+            break;
+        }
+
+        size_t whole = have - have % 3;
+        written += base64_encode(raw, whole, out + written);
+        body->carry_len = have - whole;
+        memcpy(body->carry, raw + whole, body->carry_len);
+    }
+
+    return written;
+}
+
+static size_t
+fill_buffer(upload_body_t *body, char *buffer, size_t space)
+{
+    size_t written = 0;
+
+    while (written < space && body->stage != BODY_STAGE_DONE)
+    {
+        size_t n = 0;
+        switch (body->stage)
+        {
+            case BODY_STAGE_PREFIX:
+                n = copy_literal(
+                  body, body->prefix, body->prefix_len, buffer + written, space - written);
+                break;
+            case BODY_STAGE_PAYLOAD:
+                if (body->format == REQUEST_BODY_JSON)
+                {
+                    if (space - written < 4)
+                    {
+                        return written;
+                    }
+                    n = read_base64_payload(body, buffer + written, space - written);
+                }
+                else
+                {
+                    size_t want = space - written;
+                    if (body->ranged && (curl_off_t)want > body->range_remaining)
+                    {
+                        want = (size_t)body->range_remaining;
+                    }
+
+                    n = want > 0 ? upload_source_read(body->source, buffer + written, want) : 0;
+                    if (n != UPLOAD_SOURCE_ERROR && body->ranged)
+                    {
+                        body->range_remaining -= (curl_off_t)n;
+                    }
+                    if (n == 0 || (body->ranged && body->range_remaining == 0))
+                    {
+                        body->stage = BODY_STAGE_SUFFIX;
+                    }
+                }
+                if (n == UPLOAD_SOURCE_ERROR)
+                {
+                    return CURL_READFUNC_ABORT;
+                }
+                break;
+            case BODY_STAGE_SUFFIX:
+                n = copy_literal(
+                  body, body->suffix, body->suffix_len, buffer + written, space - written);
+                break;
+            case BODY_STAGE_DONE:
+                break;
+        }
+
+        written += n;
+
+        if (n > 0 && body->stage == BODY_STAGE_PAYLOAD)
+        {
+            break;
+        }
+    }
+
+    return written;
+}
+
+size_t
+upload_body_read_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    upload_body_t *body = (upload_body_t *)userdata;
+
+    if (body->stage == BODY_STAGE_DONE)
+    {
+        return 0;
+    }
+
+    /* Returning 0 would end the upload, so an empty bucket pauses the transfer instead;
+     * the driving loop resumes it once rate_limit_wait_ms() reaches 0 */
+    size_t space = rate_limit_acquire(size * nitems);
+    size_t written = space > 0 ? fill_buffer(body, buffer, space) : 0;
+    if (written == CURL_READFUNC_ABORT)
+    {
+        return written;
+    }
+
+    rate_limit_refund(space - written);
+
+    if (written == 0 && body->stage != BODY_STAGE_DONE)
+    {
+        body->paused = true;
+        return CURL_READFUNC_PAUSE;
+    }
+
+    return written;
+}
+
+const char *
+upload_body_content_type(const upload_body_t *body, const char *file_path)
+{
+    static const struct
+    {
+        const char *extension;
+        const char *type;
+    } types[] = {
+        { "png", "image/png" },
+        { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" },
+        { "gif", "image/gif" },
+        { "webp", "image/webp" },
+        { "bmp", "image/bmp" },
+        { "svg", "image/svg+xml" },
+        { "mp4", "video/mp4" },
+        { "webm", "video/webm" },
+        { "mov", "video/quicktime" },
+        { "mp3", "audio/mpeg" },
+        { "ogg", "audio/ogg" },
+        { "txt", "text/plain" },
+        { "pdf", "application/pdf" },
+        { "zip", "application/zip" },
+    };
+
+    if (body->format == REQUEST_BODY_JSON)
+    {
+        return "application/json";
+    }
+
+    const char *dot = file_path ? strrchr(file_path, '.') : NULL;
+    if (dot && !strchr(dot, '/'))
+    {
+        for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        {
+            if (strcasecmp(dot + 1, types[i].extension) == 0)
+            {
+                return types[i].type;
+            }
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+bool
+upload_body_is_paused(const upload_body_t *body)
+{
+    return body->paused;
+}
+
+void
+upload_body_resume(upload_body_t *body)
+{
+    body->paused = false;
+}
+
+int
+upload_body_seek_callback(void *userdata, curl_off_t offset, int origin)
+{
+    upload_body_t *body = (upload_body_t *)userdata;
+
+    if (offset != 0 || origin != SEEK_SET)
+    {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    return upload_body_rewind(body) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+void
+upload_body_free(upload_body_t *body)
+{
+    if (!body)
+    {
+        return;
+    }
+
+    free(body->prefix);
+    free(body);
+}
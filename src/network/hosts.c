@@ -453,6 +453,12 @@ hosts_add(const char *name,
         free(host->api_key_name);
         free(host->api_key);
         free(host->request_body_format);
+        free(host->request_method);
+        free(host->max_response_size);
+        free(host->chunk_size);
+        free(host->region);
+        free(host->limit_rate);
+        free(host->upload_source);
         free(host->file_form_field);
         free(host->response_url_json_path);
         free(host->response_deletion_url_json_path);
@@ -1108,6 +1114,7 @@ hosts_import_sxcu(const char *file_path)
     cJSON *name_json = cJSON_GetObjectItemCaseSensitive(root, "Name");
     cJSON *request_url = cJSON_GetObjectItemCaseSensitive(root, "RequestURL");
     cJSON *headers = cJSON_GetObjectItemCaseSensitive(root, "Headers");
+    cJSON *request_method = cJSON_GetObjectItemCaseSensitive(root, "RequestMethod");
     cJSON *body = cJSON_GetObjectItemCaseSensitive(root, "Body");
     cJSON *file_form_name = cJSON_GetObjectItemCaseSensitive(root, "FileFormName");
     cJSON *url_path = cJSON_GetObjectItemCaseSensitive(root, "URL");
@@ -1213,6 +1220,14 @@ hosts_import_sxcu(const char *file_path)
         }
     }
 
+    char *method = strdup("POST");
+    if (cJSON_IsString(request_method) && request_method->valuestring &&
+        strlen(request_method->valuestring) > 0 && strlen(request_method->valuestring) < 16)
+    {
+        free(method);
+        method = strdup(request_method->valuestring);
+    }
+
     char *file_field = strdup("file");
     if (cJSON_IsString(file_form_name) && file_form_name->valuestring)
     {
@@ -1265,6 +1280,7 @@ hosts_import_sxcu(const char *file_path)
     print_current_value("API Endpoint:", api_endpoint);
     print_current_value("Auth Type:", auth_type);
     print_current_value("API Key Header:", api_key_name);
+    print_current_value("Request Method:", method);
     print_current_value("Request Body Format:", request_body_format);
     print_current_value("File Form Field:", file_field);
     print_current_value("Response URL Path:", response_url_path);
@@ -1285,6 +1301,7 @@ hosts_import_sxcu(const char *file_path)
             free(api_key_name);
             free(api_key);
             free(request_body_format);
+            free(method);
             free(file_field);
             free(response_url_path);
             free(response_deletion_path);
@@ -1305,6 +1322,13 @@ hosts_import_sxcu(const char *file_path)
                             NULL,
                             0);
 
+    if (result && strcasecmp(method, "POST") != 0)
+    {
+        char key[256];
+        snprintf(key, sizeof(key), "hosts.%s.request_method", name);
+        result = config_set_value(key, method);
+    }
+
     hostman_config_t *config = config_load();
     if (result && config && (!config->default_host || config->host_count == 1))
     {
@@ -1327,6 +1351,7 @@ hosts_import_sxcu(const char *file_path)
     free(api_key_name);
     free(api_key);
     free(request_body_format);
+    free(method);
     free(file_field);
     free(response_url_path);
     free(response_deletion_path);
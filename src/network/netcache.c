@@ -0,0 +1,626 @@
+#include "hostman/network/netcache.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cJSON.h>
+
+#define NETCACHE_FILE "netcache.json"
+
+typedef struct
+{
+    char *name;
+    unsigned char *der;
+    size_t der_len;
+    time_t expires;
+} tls_entry_t;
+
+typedef struct
+{
+    char *name;
+    char *address;
+    time_t expires;
+    bool stale;
+} dns_entry_t;
+
+static struct
+{
+    bool loaded;
+    bool dirty;
+    tls_entry_t tls[NETCACHE_MAX_ENTRIES];
+    int tls_count;
+    dns_entry_t dns[NETCACHE_MAX_ENTRIES];
+    int dns_count;
+} cache;
+
+static int (*curl_new_session_cb)(SSL *, SSL_SESSION *) = NULL;
+
+static char *
+netcache_path(void)
+{
+    char *cache_dir = get_cache_dir();
+    if (!cache_dir)
+    {
+        return NULL;
+    }
+
+    size_t len = strlen(cache_dir) + strlen("/" NETCACHE_FILE) + 1;
+    char *path = malloc(len);
+    if (path)
+    {
+        snprintf(path, len, "%s/" NETCACHE_FILE, cache_dir);
+    }
+    free(cache_dir);
+
+    return path;
+}
+
+static char *
+encode_base64(const unsigned char *data, size_t len)
+{
+    char *out = malloc(4 * ((len + 2) / 3) + 1);
+    if (out)
+    {
+        EVP_EncodeBlock((unsigned char *)out, data, (int)len);
+    }
+    return out;
+}
+
+static unsigned char *
+decode_base64(const char *text, size_t *out_len)
+{
+    size_t len = strlen(text);
+    if (len == 0 || len % 4 != 0)
+    {
+        return NULL;
+    }
+
+    unsigned char *out = malloc(3 * (len / 4));
+    if (!out)
+    {
+        return NULL;
+    }
+
+    int decoded = EVP_DecodeBlock(out, (const unsigned char *)text, (int)len);
+    if (decoded < 0)
+    {
+        free(out);
+        return NULL;
+    }
+
+    size_t padding = (text[len - 1] == '=') + (text[len - 2] == '=');
+    *out_len = (size_t)decoded - padding;
+
+    return out;
+}
+
+static void
+tls_entry_clear(tls_entry_t *entry)
+{
+    free(entry->name);
+    free(entry->der);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void
+dns_entry_clear(dns_entry_t *entry)
+{
+    free(entry->name);
+    free(entry->address);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static tls_entry_t *
+tls_slot(const char *name)
+{
+    int oldest = 0;
+    for (int i = 0; i < cache.tls_count; i++)
+    {
+        if (strcmp(cache.tls[i].name, name) == 0)
+        {
+            tls_entry_clear(&cache.tls[i]);
+            return &cache.tls[i];
+        }
+        if (cache.tls[i].expires < cache.tls[oldest].expires)
+        {
+            oldest = i;
+        }
+    }
+
+    if (cache.tls_count < NETCACHE_MAX_ENTRIES)
+    {
+        return &cache.tls[cache.tls_count++];
+    }
+
+    tls_entry_clear(&cache.tls[oldest]);
+    return &cache.tls[oldest];
+}
+
+static dns_entry_t *
+dns_find(const char *name)
+{
+    for (int i = 0; i < cache.dns_count; i++)
+    {
+        if (strcmp(cache.dns[i].name, name) == 0)
+        {
+            return &cache.dns[i];
+        }
+    }
+    return NULL;
+}
+
+static dns_entry_t *
+dns_slot(const char *name)
+{
+    dns_entry_t *entry = dns_find(name);
+    if (entry)
+    {
+        dns_entry_clear(entry);
+        return entry;
+    }
+
+    if (cache.dns_count < NETCACHE_MAX_ENTRIES)
+    {
+        return &cache.dns[cache.dns_count++];
+    }
+
+    int oldest = 0;
+    for (int i = 1; i < cache.dns_count; i++)
+    {
+        if (cache.dns[i].expires < cache.dns[oldest].expires)
+        {
+            oldest = i;
+        }
+    }
+
+    dns_entry_clear(&cache.dns[oldest]);
+    return &cache.dns[oldest];
+}
+
+static void
+load_tls_entries(cJSON *tls, time_t now)
+{
+    cJSON *item = NULL;
+    cJSON_ArrayForEach(item, tls)
+    {
+        cJSON *session = cJSON_GetObjectItem(item, "session");
+        cJSON *expires = cJSON_GetObjectItem(item, "expires");
+        if (!cJSON_IsString(session) || !cJSON_IsNumber(expires) ||
+            (time_t)expires->valuedouble <= now || cache.tls_count >= NETCACHE_MAX_ENTRIES)
+        {
+            continue;
+        }
+
+        size_t der_len = 0;
+        unsigned char *der = decode_base64(session->valuestring, &der_len);
+        if (!der)
+        {
+            continue;
+        }
+
+        tls_entry_t *entry = &cache.tls[cache.tls_count++];
+        entry->name = strdup(item->string);
+        entry->der = der;
+        entry->der_len = der_len;
+        entry->expires = (time_t)expires->valuedouble;
+    }
+}
+
+static void
+load_dns_entries(cJSON *dns, time_t now)
+{
+    cJSON *item = NULL;
+    cJSON_ArrayForEach(item, dns)
+    {
+        cJSON *address = cJSON_GetObjectItem(item, "address");
+        cJSON *expires = cJSON_GetObjectItem(item, "expires");
+        if (!cJSON_IsString(address) || !cJSON_IsNumber(expires) ||
+            (time_t)expires->valuedouble <= now || cache.dns_count >= NETCACHE_MAX_ENTRIES)
+        {
+            continue;
+        }
+
+        dns_entry_t *entry = &cache.dns[cache.dns_count++];
+        entry->name = strdup(item->string);
+        entry->address = strdup(address->valuestring);
+        entry->expires = (time_t)expires->valuedouble;
+    }
+}
+
+void
+netcache_load(void)
+{
+    if (cache.loaded)
+    {
+        return;
+    }
+    cache.loaded = true;
+
+    char *path = netcache_path();
+    if (!path)
+    {
+        return;
+    }
+
+    FILE *file = fopen(path, "r");
+    free(path);
+    if (!file)
+    {
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *data = size > 0 ? malloc(size + 1) : NULL;
+    if (!data || fread(data, 1, size, file) != (size_t)size)
+    {
+        free(data);
+        fclose(file);
+        return;
+    }
+    data[size] = '\0';
+    fclose(file);
+
+    cJSON *root = cJSON_Parse(data);
+    free(data);
+    if (!root)
+    {
+        log_warn("Ignoring malformed network cache");
+        return;
+    }
+
+    time_t now = time(NULL);
+    load_tls_entries(cJSON_GetObjectItem(root, "tls"), now);
+    load_dns_entries(cJSON_GetObjectItem(root, "dns"), now);
+    cJSON_Delete(root);
+
+    log_info("Loaded network cache: %d TLS session(s), %d address(es)",
+             cache.tls_count,
+             cache.dns_count);
+}
+
+/* The cache holds resumable TLS session secrets, so it must not be readable by others */
+static bool
+prepare_cache_dir(const char *dir)
+{
+    struct stat dir_stat;
+    if (stat(dir, &dir_stat) != 0)
+    {
+        return mkdir(dir, 0700) == 0 || errno == EEXIST;
+    }
+
+    if ((dir_stat.st_mode & 077) != 0 && chmod(dir, dir_stat.st_mode & 0700) != 0)
+    {
+        log_warn("Not saving network cache: %s is accessible by other users", dir);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+write_file(const char *path, const char *data)
+{
+    size_t tmp_len = strlen(path) + 8;
+    char *tmp_path = malloc(tmp_len);
+    if (!tmp_path)
+    {
+        return false;
+    }
+    snprintf(tmp_path, tmp_len, "%s.XXXXXX", path);
+
+    /* A unique name keeps concurrent processes (CLI and daemon) from clobbering each other */
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        log_warn("Failed to write network cache: %s", strerror(errno));
+        free(tmp_path);
+        return false;
+    }
+
+    size_t len = strlen(data);
+    bool ok = write(fd, data, len) == (ssize_t)len;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok)
+    {
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    return ok;
+}
+
+void
+netcache_save(void)
+{
+    if (!cache.dirty)
+    {
+        return;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON *tls = cJSON_AddObjectToObject(root, "tls");
+    cJSON *dns = cJSON_AddObjectToObject(root, "dns");
+    time_t now = time(NULL);
+
+    for (int i = 0; i < cache.tls_count; i++)
+    {
+        if (cache.tls[i].expires <= now)
+        {
+            continue;
+        }
+
+        char *session = encode_base64(cache.tls[i].der, cache.tls[i].der_len);
+        if (session)
+        {
+            cJSON *item = cJSON_AddObjectToObject(tls, cache.tls[i].name);
+            cJSON_AddStringToObject(item, "session", session);
+            cJSON_AddNumberToObject(item, "expires", (double)cache.tls[i].expires);
+            free(session);
+        }
+    }
+
+    for (int i = 0; i < cache.dns_count; i++)
+    {
+        if (cache.dns[i].expires <= now || cache.dns[i].stale)
+        {
+            continue;
+        }
+
+        cJSON *item = cJSON_AddObjectToObject(dns, cache.dns[i].name);
+        cJSON_AddStringToObject(item, "address", cache.dns[i].address);
+        cJSON_AddNumberToObject(item, "expires", (double)cache.dns[i].expires);
+    }
+
+    char *data = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    char *cache_dir = get_cache_dir();
+    bool dir_ready = cache_dir && prepare_cache_dir(cache_dir);
+    free(cache_dir);
+
+    char *path = netcache_path();
+    if (dir_ready && data && path && write_file(path, data))
+    {
+        cache.dirty = false;
+    }
+
+    free(path);
+    free(data);
+}
+
+bool
+netcache_tls_supported(void)
+{
+    curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    int major = 0;
+
+    if (!info->ssl_version || sscanf(info->ssl_version, "OpenSSL/%d", &major) != 1)
+    {
+        return false;
+    }
+
+    return (unsigned long)major == (OpenSSL_version_num() >> 28);
+}
+
+static int
+new_session_callback(SSL *ssl, SSL_SESSION *session)
+{
+    const char *name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+
+    if (name && SSL_SESSION_is_resumable(session))
+    {
+        int der_len = i2d_SSL_SESSION(session, NULL);
+        unsigned char *der = der_len > 0 ? malloc(der_len) : NULL;
+        if (der)
+        {
+            unsigned char *p = der;
+            i2d_SSL_SESSION(session, &p);
+
+            tls_entry_t *entry = tls_slot(name);
+            entry->name = strdup(name);
+            entry->der = der;
+            entry->der_len = (size_t)der_len;
+            entry->expires = (time_t)(SSL_SESSION_get_time(session) +
+                                      SSL_SESSION_get_timeout(session));
+            cache.dirty = true;
+        }
+    }
+
+    return curl_new_session_cb ? curl_new_session_cb(ssl, session) : 0;
+}
+
+static void
+info_callback(const SSL *ssl, int where, int ret)
+{
+    (void)ret;
+
+    if (!(where & SSL_CB_HANDSHAKE_START) || SSL_get_session(ssl))
+    {
+        return;
+    }
+
+    const char *name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!name)
+    {
+        return;
+    }
+
+    time_t now = time(NULL);
+    for (int i = 0; i < cache.tls_count; i++)
+    {
+        if (strcmp(cache.tls[i].name, name) != 0 || cache.tls[i].expires <= now)
+        {
+            continue;
+        }
+
+        const unsigned char *p = cache.tls[i].der;
+        SSL_SESSION *session = d2i_SSL_SESSION(NULL, &p, (long)cache.tls[i].der_len);
+        if (session)
+        {
+            if (SSL_set_session((SSL *)ssl, session) == 1)
+            {
+                log_info("Resuming cached TLS session for %s", name);
+            }
+            SSL_SESSION_free(session);
+        }
+        break;
+    }
+}
+
+CURLcode
+netcache_ssl_ctx_callback(CURL *curl, void *ssl_ctx, void *userptr)
+{
+    (void)curl;
+    (void)userptr;
+
+    SSL_CTX *ctx = (SSL_CTX *)ssl_ctx;
+
+    int (*existing)(SSL *, SSL_SESSION *) = SSL_CTX_sess_get_new_cb(ctx);
+    if (existing != new_session_callback)
+    {
+        curl_new_session_cb = existing;
+    }
+
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(ctx, new_session_callback);
+    SSL_CTX_set_info_callback(ctx, info_callback);
+
+    return CURLE_OK;
+}
+
+static char *
+url_host_key(const char *url)
+{
+    CURLU *handle = curl_url();
+    if (!handle)
+    {
+        return NULL;
+    }
+
+    char *host = NULL;
+    char *port = NULL;
+    char *key = NULL;
+
+    if (curl_url_set(handle, CURLUPART_URL, url, 0) == CURLUE_OK &&
+        curl_url_get(handle, CURLUPART_HOST, &host, 0) == CURLUE_OK &&
+        curl_url_get(handle, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK)
+    {
+        unsigned char addr[sizeof(struct in6_addr)];
+        bool literal = host[0] == '[' || inet_pton(AF_INET, host, addr) == 1;
+
+        if (!literal)
+        {
+            size_t len = strlen(host) + strlen(port) + 2;
+            key = malloc(len);
+            if (key)
+            {
+                snprintf(key, len, "%s:%s", host, port);
+            }
+        }
+    }
+
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(handle);
+
+    return key;
+}
+
+struct curl_slist *
+netcache_resolve_list(const char *url)
+{
+    char *key = url_host_key(url);
+    if (!key)
+    {
+        return NULL;
+    }
+
+    struct curl_slist *list = NULL;
+    dns_entry_t *entry = dns_find(key);
+
+    if (entry && entry->stale)
+    {
+        char removal[512];
+        snprintf(removal, sizeof(removal), "-%s", key);
+        list = curl_slist_append(NULL, removal);
+        dns_entry_clear(entry);
+        *entry = cache.dns[--cache.dns_count];
+        memset(&cache.dns[cache.dns_count], 0, sizeof(dns_entry_t));
+    }
+    else if (entry && entry->expires > time(NULL))
+    {
+        char pinned[512];
+        bool ipv6 = strchr(entry->address, ':') != NULL;
+        snprintf(pinned,
+                 sizeof(pinned),
+                 ipv6 ? "%s:[%s]" : "%s:%s",
+                 key,
+                 entry->address);
+        list = curl_slist_append(NULL, pinned);
+    }
+
+    free(key);
+    return list;
+}
+
+bool
+netcache_record_transfer(CURL *curl, const char *url, CURLcode result)
+{
+    char *key = url_host_key(url);
+    if (!key)
+    {
+        return false;
+    }
+
+    dns_entry_t *entry = dns_find(key);
+
+    if (result == CURLE_COULDNT_CONNECT || result == CURLE_COULDNT_RESOLVE_HOST ||
+        result == CURLE_OPERATION_TIMEDOUT)
+    {
+        bool dropped = entry && !entry->stale;
+        if (dropped)
+        {
+            log_info("Dropping cached address %s for %s", entry->address, key);
+            entry->stale = true;
+            cache.dirty = true;
+        }
+        free(key);
+        return dropped;
+    }
+
+    char *address = NULL;
+    if (curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &address) != CURLE_OK || !address ||
+        address[0] == '\0')
+    {
+        free(key);
+        return false;
+    }
+
+    if (!entry || entry->stale || strcmp(entry->address, address) != 0 ||
+        entry->expires <= time(NULL))
+    {
+        entry = dns_slot(key);
+        entry->name = key;
+        entry->address = strdup(address);
+        entry->expires = time(NULL) + NETCACHE_DNS_TTL_SECONDS;
+        cache.dirty = true;
+        return false;
+    }
+
+    free(key);
+    return false;
+}
@@ -1,53 +1,60 @@
 #include "hostman/network/network.h"
 #include "hostman/core/logging.h"
+#include "hostman/network/body.h"
+#include "hostman/network/netcache.h"
+#include "hostman/network/ratelimit.h"
+#include "hostman/network/response.h"
+#include "hostman/network/s3.h"
+#include "hostman/network/source.h"
+#include "hostman/network/tus.h"
 #include "hostman/core/utils.h"
 #include "hostman/crypto/encryption.h"
+#include "hostman/crypto/hash.h"
+#include "hostman/storage/database.h"
 #include <ctype.h>
 #include <curl/curl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #define MIN_PROGRESS_UPDATE_MS 100
+#define UPLOAD_BUFFER_SIZE (512L * 1024)
 
 static bool network_insecure = false;
+static bool network_resident = false;
+static network_session_t *resident_session = NULL;
 
 static network_config_t global_config = { .timeout_seconds = DEFAULT_TIMEOUT_SECONDS,
                                           .max_retries = DEFAULT_MAX_RETRIES,
                                           .retry_delay_ms = DEFAULT_RETRY_DELAY_MS,
+                                          .max_retry_delay_ms = DEFAULT_MAX_RETRY_DELAY_MS,
                                           .enable_http2 = true,
                                           .proxy_url = NULL,
                                           .verbose = false };
 
-typedef struct
-{
-    char *data;
-    size_t size;
-} response_data_t;
-
-static size_t
-write_callback(void *contents, size_t size, size_t nmemb, void *userp)
-{
-    size_t real_size = size * nmemb;
-    response_data_t *resp = (response_data_t *)userp;
-
-    char *ptr = realloc(resp->data, resp->size + real_size + 1);
-    if (!ptr)
-    {
-        log_error("Failed to allocate memory for response data");
-        return 0;
-    }
+/* Fields tried in order for an error message when an upload is rejected */
+static const char *error_message_fields[] = { "message", "error", "error.message" };
+#define ERROR_MESSAGE_FIELD_COUNT (sizeof(error_message_fields) / sizeof(error_message_fields[0]))
+static json_path_t error_message_paths[ERROR_MESSAGE_FIELD_COUNT];
 
-    resp->data = ptr;
-    memcpy(&(resp->data[resp->size]), contents, real_size);
-    resp->size += real_size;
-    resp->data[resp->size] = 0;
+/* Buffers above this size are freed rather than kept for the next transfer */
+#define RESPONSE_BUFFER_KEEP_MAX (64 * 1024)
 
-    return real_size;
-}
+struct network_session
+{
+    CURLSH *share;
+    CURL **idle_handles;
+    int idle_count;
+    int idle_capacity;
+    response_buffer_t *idle_buffers;
+    int idle_buffer_count;
+    int idle_buffer_capacity;
+};
 
 static char *
 duplicate_trimmed(const char *text)
@@ -116,7 +123,7 @@ looks_like_url(const char *value)
 }
 
 static char *
-extract_response_value(const char *response_body, const char *path)
+extract_response_value(const char *response_body, const char *path, const json_path_match_t *match)
 {
     if (!response_body || response_body[0] == '\0')
     {
@@ -128,9 +135,9 @@ extract_response_value(const char *response_body, const char *path)
         return duplicate_trimmed(response_body);
     }
 
-    if (path && path[0] != '\0')
+    if (match->found)
     {
-        char *json_value = extract_json_string(response_body, path);
+        char *json_value = json_path_match_dup(match);
         if (json_value)
         {
             return json_value;
@@ -159,10 +166,16 @@ progress_callback(void *clientp,
                   curl_off_t ultotal,
                   curl_off_t ulnow)
 {
+    progress_data_t *prog = (progress_data_t *)clientp;
+    if (prog->size > 0)
+    {
+        ulnow += prog->offset;
+        ultotal = prog->size;
+    }
+
     if (ultotal == 0)
         return 0;
 
-    progress_data_t *prog = (progress_data_t *)clientp;
     double percent = (double)ulnow / (double)ultotal * 100.0;
 
     time_t now = time(NULL);
@@ -231,6 +244,12 @@ network_init(void)
         log_warn("HTTP/2 not supported by libcurl, falling back to HTTP/1.1");
         global_config.enable_http2 = false;
     }
+
+    for (size_t i = 0; i < ERROR_MESSAGE_FIELD_COUNT; i++)
+    {
+        json_path_compile(&error_message_paths[i], error_message_fields[i]);
+    }
+
     return (curl_global_init(CURL_GLOBAL_ALL) == CURLE_OK);
 }
 
@@ -248,6 +267,7 @@ network_set_config(network_config_t *config)
         global_config.timeout_seconds = config->timeout_seconds;
         global_config.max_retries = config->max_retries;
         global_config.retry_delay_ms = config->retry_delay_ms;
+        global_config.max_retry_delay_ms = config->max_retry_delay_ms;
         global_config.enable_http2 = config->enable_http2;
         if (global_config.proxy_url)
         {
@@ -258,20 +278,89 @@ network_set_config(network_config_t *config)
     }
 }
 
+/* State shared by the requests of one S3 upload */
+typedef struct
+{
+    const char *file_path;
+    char *object_url;
+    char *upload_id;
+    curl_off_t size;
+    curl_off_t part_size;
+    int part_count;
+    int next_part;
+    char **etags;
+    curl_off_t bytes_done;
+    progress_data_t *progress;
+    char *error;
+} s3_upload_t;
+
+typedef struct
+{
+    int index;
+    int slot;
+    char *file_path;
+    host_config_t *host;
+    const network_upload_options_t *options;
+    network_session_t *session;
+    CURL *curl;
+    curl_mime *mime;
+    upload_source_t *source;
+    bool owns_source;
+    upload_body_t *body;
+    struct curl_slist *headers;
+    struct curl_slist *resolve;
+    response_buffer_t response_buffer;
+    progress_data_t prog_data;
+    upload_response_t *response;
+    int attempt;
+    bool retryable;
+    long retry_delay_ms;
+    bool show_progress;
+    struct timespec start_time;
+    struct timespec first_byte_time;
+    bool got_first_byte;
+    struct timespec retry_at;
+    /* Set when a request finished a step of a multi-request upload rather than the upload */
+    bool continuing;
+    tus_stage_t tus_stage;
+    char *tus_url;
+    char *tus_key;
+    long long tus_mtime;
+    curl_off_t tus_size;
+    curl_off_t tus_offset;
+    curl_off_t tus_chunk;
+    char *tus_location;
+    curl_off_t tus_server_offset;
+    int tus_restarts;
+    s3_stage_t s3_stage;
+    s3_upload_t *s3;
+    bool owns_s3;
+    int s3_part;
+    char *s3_etag;
+    char *request_url;
+    char *request_body;
+} upload_transfer_t;
+
 static void
 configure_curl_handle(CURL *curl,
                       struct curl_slist *headers,
-                      response_data_t *response_data,
+                      response_buffer_t *response_buffer,
                       progress_data_t *prog_data,
                       const char *url)
 {
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_data);
-    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
-    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, prog_data);
+    response_buffer_attach(response_buffer, curl);
+    if (prog_data)
+    {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, prog_data);
+    }
+    else
+    {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    }
     if (network_insecure)
     {
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
@@ -283,7 +372,20 @@ configure_curl_handle(CURL *curl,
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
     }
 
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, global_config.timeout_seconds);
+    if (rate_limit_get() > 0)
+    {
+        /* Paced bodies spend most of their wall time paused, which a total deadline would count
+         * against them; only give up once the transfer has made no progress for a full timeout */
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, global_config.timeout_seconds);
+    }
+    else
+    {
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, global_config.timeout_seconds);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 0L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 0L);
+    }
     curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, global_config.timeout_seconds);
 
     if (global_config.enable_http2)
@@ -296,322 +398,2369 @@ configure_curl_handle(CURL *curl,
         curl_easy_setopt(curl, CURLOPT_PROXY, global_config.proxy_url);
     }
 
+    if (!network_insecure && netcache_tls_supported())
+    {
+        curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, netcache_ssl_ctx_callback);
+    }
+
     if (global_config.verbose)
     {
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
     }
 }
 
-upload_response_t *
-network_upload_file(const char *file_path, host_config_t *host)
+static void
+session_destroy(network_session_t *session);
+
+void
+network_set_resident(bool resident)
 {
-    CURL *curl;
-    CURLcode res;
-    struct curl_slist *headers = NULL;
-    response_data_t response_data = { 0 };
-    progress_data_t prog_data = { 0 };
-    upload_response_t *response = malloc(sizeof(upload_response_t));
-    int retry_count = 0;
+    network_resident = resident;
+    if (!resident && resident_session)
+    {
+        session_destroy(resident_session);
+        resident_session = NULL;
+    }
+}
 
-    if (!response)
+network_session_t *
+network_session_create(void)
+{
+    if (network_resident && resident_session)
     {
-        log_error("Failed to allocate memory for upload response");
-        return NULL;
+        return resident_session;
     }
 
-    if (!file_path || strlen(file_path) == 0)
+    network_session_t *session = calloc(1, sizeof(network_session_t));
+    if (!session)
     {
-        response->error_message = strdup("File path is NULL or empty");
-        return response;
+        log_error("Failed to allocate memory for network session");
+        return NULL;
     }
 
-    if (strlen(file_path) > PATH_MAX)
+    session->share = curl_share_init();
+    if (!session->share)
     {
-        response->error_message = strdup("File path exceeds maximum length");
-        return response;
+        log_error("Failed to initialize curl share handle");
+        free(session);
+        return NULL;
     }
 
-    if (!host)
+    curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    netcache_load();
+
+    if (network_resident)
     {
-        response->error_message = strdup("Host configuration is NULL");
-        return response;
+        resident_session = session;
     }
 
-    if (!host->api_endpoint || strlen(host->api_endpoint) == 0)
+    return session;
+}
+
+void
+network_session_free(network_session_t *session)
+{
+    if (session && session == resident_session)
     {
-        response->error_message = strdup("API endpoint is NULL or empty");
-        return response;
+        netcache_save();
+        return;
     }
 
-    if (!host->auth_type || strlen(host->auth_type) == 0)
+    session_destroy(session);
+}
+
+static void
+session_destroy(network_session_t *session)
+{
+    if (!session)
     {
-        response->error_message = strdup("Auth type is NULL or empty");
-        return response;
+        return;
     }
 
-    if (!host->file_form_field || strlen(host->file_form_field) == 0)
+    for (int i = 0; i < session->idle_count; i++)
     {
-        response->error_message = strdup("File form field is NULL or empty");
-        return response;
+        curl_easy_cleanup(session->idle_handles[i]);
     }
+    free(session->idle_handles);
 
-    if (strcmp(host->auth_type, "none") != 0 && strcmp(host->auth_type, "bearer") != 0 &&
-        strcmp(host->auth_type, "header") != 0)
+    for (int i = 0; i < session->idle_buffer_count; i++)
     {
-        response->error_message = strdup("Invalid auth type specified");
-        return response;
+        response_buffer_free(&session->idle_buffers[i]);
     }
+    free(session->idle_buffers);
 
-    response->success = false;
-    response->url = NULL;
-    response->deletion_url = NULL;
-    response->error_message = NULL;
-    response->request_time_ms = 0.0;
-    response->retry_count = 0;
-    response->http_code = 0;
+    curl_share_cleanup(session->share);
+    free(session);
 
-    if (access(file_path, R_OK) != 0)
+    netcache_save();
+}
+
+static CURL *
+session_acquire_handle(network_session_t *session)
+{
+    if (!session)
     {
-        response->error_message = strdup("File not found or not readable");
-        return response;
+        return curl_easy_init();
     }
 
-    struct stat file_stat;
-    if (stat(file_path, &file_stat) != 0)
+    CURL *curl = NULL;
+    if (session->idle_count > 0)
+    {
+        curl = session->idle_handles[--session->idle_count];
+        curl_easy_reset(curl);
+    }
+    else
     {
-        response->error_message = strdup("Failed to get file information");
-        return response;
+        curl = curl_easy_init();
     }
 
-    do
+    if (curl)
     {
-        if (retry_count > 0)
-        {
-            log_info(
-              "Retrying upload (attempt %d of %d)", retry_count + 1, global_config.max_retries);
-            usleep(global_config.retry_delay_ms * 1000);
-        }
+        curl_easy_setopt(curl, CURLOPT_SHARE, session->share);
+    }
 
-        curl = curl_easy_init();
-        if (!curl)
-        {
-            response->error_message = strdup("Failed to initialize curl");
-            return response;
-        }
+    return curl;
+}
 
-        free(response_data.data);
-        response_data.data = NULL;
-        response_data.size = 0;
+static void
+session_release_handle(network_session_t *session, CURL *curl)
+{
+    if (!session)
+    {
+        curl_easy_cleanup(curl);
+        return;
+    }
 
-        curl_mime *mime = curl_mime_init(curl);
-        if (!mime)
+    if (session->idle_count == session->idle_capacity)
+    {
+        int capacity = session->idle_capacity == 0 ? 4 : session->idle_capacity * 2;
+        CURL **handles = realloc(session->idle_handles, capacity * sizeof(CURL *));
+        if (!handles)
         {
-            response->error_message = strdup("Failed to initialize mime form");
             curl_easy_cleanup(curl);
-            return response;
+            return;
         }
+        session->idle_handles = handles;
+        session->idle_capacity = capacity;
+    }
 
-        curl_mimepart *part = curl_mime_addpart(mime);
-        curl_mime_name(part, host->file_form_field);
-        curl_mime_filedata(part, file_path);
+    session->idle_handles[session->idle_count++] = curl;
+}
 
-        for (int i = 0; i < host->static_field_count; i++)
-        {
-            part = curl_mime_addpart(mime);
-            curl_mime_name(part, host->static_field_names[i]);
-            curl_mime_data(part, host->static_field_values[i], CURL_ZERO_TERMINATED);
-        }
+static void
+session_acquire_buffer(network_session_t *session, response_buffer_t *buffer, size_t max_size)
+{
+    if (session && session->idle_buffer_count > 0)
+    {
+        *buffer = session->idle_buffers[--session->idle_buffer_count];
+        buffer->max_size = max_size;
+        return;
+    }
+
+    response_buffer_init(buffer, max_size);
+}
+
+static void
+session_release_buffer(network_session_t *session, response_buffer_t *buffer)
+{
+    if (!session || buffer->capacity == 0 || buffer->capacity > RESPONSE_BUFFER_KEEP_MAX)
+    {
+        response_buffer_free(buffer);
+        return;
+    }
 
-        if (strcmp(host->auth_type, "none") == 0)
+    if (session->idle_buffer_count == session->idle_buffer_capacity)
+    {
+        int capacity = session->idle_buffer_capacity == 0 ? 4 : session->idle_buffer_capacity * 2;
+        response_buffer_t *buffers =
+          realloc(session->idle_buffers, capacity * sizeof(response_buffer_t));
+        if (!buffers)
         {
-            // :3
+            response_buffer_free(buffer);
+            return;
         }
-        else if (strcmp(host->auth_type, "bearer") == 0)
-        {
-            char *api_key = host->api_key;
-            if (api_key)
-            {
-                if (!host->api_key_name || strlen(host->api_key_name) == 0)
-                {
-                    response->error_message = strdup("API key name is empty or NULL");
-                    curl_easy_cleanup(curl);
-                    curl_mime_free(mime);
-                    return response;
-                }
+        session->idle_buffers = buffers;
+        session->idle_buffer_capacity = capacity;
+    }
 
-                size_t header_len = strlen(host->api_key_name) + strlen(api_key) + 10;
-                char *auth_header = malloc(header_len);
-                if (!auth_header)
-                {
-                    response->error_message = strdup("Failed to allocate memory for auth header");
-                    curl_easy_cleanup(curl);
-                    curl_mime_free(mime);
-                    return response;
-                }
+    buffer->curl = NULL;
+    session->idle_buffers[session->idle_buffer_count++] = *buffer;
+    response_buffer_init(buffer, buffer->max_size);
+}
 
-                snprintf(auth_header, header_len, "%s: Bearer %s", host->api_key_name, api_key);
-                headers = curl_slist_append(headers, auth_header);
-                free(auth_header);
-            }
-            else
-            {
-                response->error_message = strdup("API key not set");
-                curl_easy_cleanup(curl);
-                curl_mime_free(mime);
-                return response;
-            }
-        }
-        else if (strcmp(host->auth_type, "header") == 0)
-        {
-            char *api_key = host->api_key;
-            if (api_key)
-            {
-                if (!host->api_key_name || strlen(host->api_key_name) == 0)
-                {
-                    response->error_message = strdup("API key name is empty or NULL");
-                    curl_easy_cleanup(curl);
-                    curl_mime_free(mime);
-                    return response;
-                }
+bool
+network_max_response_size(const host_config_t *host, size_t *max_size)
+{
+    *max_size = DEFAULT_MAX_RESPONSE_SIZE;
+    if (!host || !host->max_response_size)
+    {
+        return true;
+    }
 
-                size_t header_len = strlen(host->api_key_name) + strlen(api_key) + 4;
-                char *auth_header = malloc(header_len);
-                if (!auth_header)
-                {
-                    response->error_message = strdup("Failed to allocate memory for auth header");
-                    curl_easy_cleanup(curl);
-                    curl_mime_free(mime);
-                    return response;
-                }
+    long long bytes = 0;
+    if (!parse_byte_size(host->max_response_size, &bytes))
+    {
+        return false;
+    }
 
-                snprintf(auth_header, header_len, "%s: %s", host->api_key_name, api_key);
-                headers = curl_slist_append(headers, auth_header);
-                free(auth_header);
-            }
-            else
-            {
-                response->error_message = strdup("API key not set");
-                curl_easy_cleanup(curl);
-                curl_mime_free(mime);
-                return response;
-            }
-        }
+    *max_size = (size_t)bytes;
+    return true;
+}
 
-        configure_curl_handle(curl, headers, &response_data, &prog_data, host->api_endpoint);
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+bool
+network_chunk_size(const host_config_t *host, curl_off_t *chunk_size)
+{
+    *chunk_size = DEFAULT_CHUNK_SIZE;
+    if (!host || !host->chunk_size)
+    {
+        return true;
+    }
 
-        prog_data.last_time = time(NULL);
+    long long bytes = 0;
+    if (!parse_byte_size(host->chunk_size, &bytes) || bytes <= 0)
+    {
+        return false;
+    }
 
-        log_info("Connecting to host: %s (attempt %d)", host->api_endpoint, retry_count + 1);
-        struct timespec start_time, end_time;
-        clock_gettime(CLOCK_MONOTONIC, &start_time);
+    *chunk_size = (curl_off_t)bytes;
+    return true;
+}
 
-        res = curl_easy_perform(curl);
+static void
+set_response_error(upload_response_t *response, const char *message)
+{
+    free(response->error_message);
+    response->error_message = strdup(message);
+}
 
-        clock_gettime(CLOCK_MONOTONIC, &end_time);
-        double time_taken_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0;
-        time_taken_ms += (end_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
-        response->request_time_ms = time_taken_ms;
+static bool
+validate_host(host_config_t *host, upload_response_t *response)
+{
+    if (!host)
+    {
+        set_response_error(response, "Host configuration is NULL");
+        return false;
+    }
 
-        fprintf(stderr, "\r\033[K");
+    if (!host->api_endpoint || strlen(host->api_endpoint) == 0)
+    {
+        set_response_error(response, "API endpoint is NULL or empty");
+        return false;
+    }
 
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->http_code);
+    if (!host->auth_type || strlen(host->auth_type) == 0)
+    {
+        set_response_error(response, "Auth type is NULL or empty");
+        return false;
+    }
 
-        if (res != CURLE_OK)
-        {
-            free(response->error_message);
-            response->error_message = strdup(curl_easy_strerror(res));
-            log_error("Upload failed: %s", response->error_message);
-        }
-        else if (response->http_code >= 200 && response->http_code < 300)
-        {
-            char *url = extract_response_value(response_data.data, host->response_url_json_path);
-            if (url)
-            {
-                response->success = true;
-                response->url = url;
-                log_info("Upload successful, URL: %s", url);
+    request_body_format_t format = request_body_format_from_string(host->request_body_format);
+    if (format == REQUEST_BODY_UNKNOWN)
+    {
+        set_response_error(response, "Unsupported request body format");
+        return false;
+    }
 
-                if (host->response_deletion_url_json_path &&
-                    strlen(host->response_deletion_url_json_path) > 0)
-                {
-                    char *deletion_url = extract_json_string(response_data.data,
-                                                             host->response_deletion_url_json_path);
-                    if (deletion_url)
-                    {
-                        response->deletion_url = deletion_url;
-                        log_info("Deletion URL extracted: %s", deletion_url);
-                    }
-                    else
-                    {
-                        log_warn("Could not extract deletion URL using path: %s",
-                                 host->response_deletion_url_json_path);
-                    }
-                }
-                curl_easy_cleanup(curl);
-                curl_mime_free(mime);
-                curl_slist_free_all(headers);
-                break;
-            }
-            else
-            {
-                free(response->error_message);
-                response->error_message = strdup("Failed to extract URL from response");
-                log_error("Failed to extract URL from response: %s", response_data.data);
-            }
-        }
-        else
-        {
-            free(response->error_message);
-            char error_buf[256];
-            snprintf(error_buf, sizeof(error_buf), "HTTP %ld", response->http_code);
-            if (response_data.data && response_data.size > 0)
-            {
-                char *msg = extract_json_string(response_data.data, "message");
-                if (!msg)
-                    msg = extract_json_string(response_data.data, "error");
-                if (!msg)
-                    msg = extract_json_string(response_data.data, "error.message");
-                if (msg)
-                {
-                    snprintf(
-                      error_buf, sizeof(error_buf), "HTTP %ld: %s", response->http_code, msg);
-                    free(msg);
-                }
-            }
-            response->error_message = strdup(error_buf);
-            log_error("Upload failed: %s", response->error_message);
-        }
+    if (format != REQUEST_BODY_BINARY && format != REQUEST_BODY_TUS && format != REQUEST_BODY_S3 &&
+        (!host->file_form_field || strlen(host->file_form_field) == 0))
+    {
+        set_response_error(response, "File form field is NULL or empty");
+        return false;
+    }
 
-        curl_easy_cleanup(curl);
-        curl_mime_free(mime);
-        curl_slist_free_all(headers);
-        headers = NULL;
+    if (upload_source_mode_from_string(host->upload_source) == UPLOAD_SOURCE_UNKNOWN)
+    {
+        set_response_error(response, "Unsupported upload source");
+        return false;
+    }
 
-        retry_count++;
-    } while (retry_count < global_config.max_retries && !response->success);
+    size_t max_response_size;
+    if (!network_max_response_size(host, &max_response_size))
+    {
+        set_response_error(response, "Invalid max response size");
+        return false;
+    }
 
-    response->retry_count = retry_count;
-    free(response_data.data);
+    curl_off_t chunk_size;
+    if (!network_chunk_size(host, &chunk_size))
+    {
+        set_response_error(response, "Invalid chunk size");
+        return false;
+    }
 
-    return response;
-}
+    if (strcmp(host->auth_type, "none") != 0 && strcmp(host->auth_type, "bearer") != 0 &&
+        strcmp(host->auth_type, "header") != 0 && strcmp(host->auth_type, "sigv4") != 0)
+    {
+        set_response_error(response, "Invalid auth type specified");
+        return false;
+    }
 
-void
-network_free_response(upload_response_t *response)
-{
-    if (response)
+    bool sigv4 = strcmp(host->auth_type, "sigv4") == 0;
+    if (format == REQUEST_BODY_S3 && !sigv4 && strcmp(host->auth_type, "none") != 0)
     {
-        free(response->url);
-        free(response->deletion_url);
-        free(response->error_message);
-        free(response);
+        set_response_error(response, "S3 hosts need the sigv4 or none auth type");
+        return false;
+    }
+
+    if (sigv4 && format != REQUEST_BODY_S3)
+    {
+        set_response_error(response, "The sigv4 auth type needs the s3 request body format");
+        return false;
+    }
+
+    if (sigv4 && (!host->api_key_name || !host->api_key))
+    {
+        set_response_error(response, "The sigv4 auth type needs an access key ID and secret key");
+        return false;
     }
+
+    return true;
 }
 
-void
-network_cleanup(void)
+static bool
+validate_upload(const char *file_path, host_config_t *host, upload_response_t *response)
 {
+    if (!file_path || strlen(file_path) == 0)
+    {
+        set_response_error(response, "File path is NULL or empty");
+        return false;
+    }
+
+    if (strlen(file_path) > PATH_MAX)
+    {
+        set_response_error(response, "File path exceeds maximum length");
+        return false;
+    }
+
+    if (!validate_host(host, response))
+    {
+        return false;
+    }
+
+    if (access(file_path, R_OK) != 0)
+    {
+        set_response_error(response, "File not found or not readable");
+        return false;
+    }
+
+    struct stat file_stat;
+    if (stat(file_path, &file_stat) != 0)
+    {
+        set_response_error(response, "Failed to get file information");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+append_auth_header(host_config_t *host, struct curl_slist **headers, upload_response_t *response)
+{
+    /* SigV4 covers the method and URL, so it is added while the request is prepared */
+    if (strcmp(host->auth_type, "none") == 0 || strcmp(host->auth_type, "sigv4") == 0)
+    {
+        return true;
+    }
+
+    bool bearer = strcmp(host->auth_type, "bearer") == 0;
+    char *api_key = host->api_key;
+    if (!api_key)
+    {
+        set_response_error(response, "API key not set");
+        return false;
+    }
+
+    if (!host->api_key_name || strlen(host->api_key_name) == 0)
+    {
+        set_response_error(response, "API key name is empty or NULL");
+        return false;
+    }
+
+    size_t header_len = strlen(host->api_key_name) + strlen(api_key) + (bearer ? 10 : 4);
+    char *auth_header = malloc(header_len);
+    if (!auth_header)
+    {
+        set_response_error(response, "Failed to allocate memory for auth header");
+        return false;
+    }
+
+    if (bearer)
+    {
+        snprintf(auth_header, header_len, "%s: Bearer %s", host->api_key_name, api_key);
+    }
+    else
+    {
+        snprintf(auth_header, header_len, "%s: %s", host->api_key_name, api_key);
+    }
+    *headers = curl_slist_append(*headers, auth_header);
+    free(auth_header);
+
+    return true;
+}
+
+static void
+transfer_release_handle(upload_transfer_t *transfer)
+{
+    if (transfer->curl)
+    {
+        session_release_handle(transfer->session, transfer->curl);
+        transfer->curl = NULL;
+    }
+    curl_mime_free(transfer->mime);
+    transfer->mime = NULL;
+    curl_slist_free_all(transfer->headers);
+    transfer->headers = NULL;
+    curl_slist_free_all(transfer->resolve);
+    transfer->resolve = NULL;
+}
+
+static bool
+transfer_open_body(upload_transfer_t *transfer, request_body_format_t format)
+{
+    upload_response_t *response = transfer->response;
+
+    if (transfer->body)
+    {
+        if (!upload_body_rewind(transfer->body))
+        {
+            log_warn("Not retrying upload of %s: stream cannot be rewound", transfer->file_path);
+            if (!response->error_message)
+            {
+                set_response_error(response, "Upload source cannot be rewound");
+            }
+            return false;
+        }
+        return true;
+    }
+
+    if (!transfer->source)
+    {
+        transfer->source = upload_source_open_file(
+          transfer->file_path, upload_source_mode_from_string(transfer->host->upload_source));
+        if (!transfer->source)
+        {
+            set_response_error(response, "Failed to open file for reading");
+            return false;
+        }
+        transfer->owns_source = true;
+    }
+
+    transfer->body = upload_body_create(format, transfer->host, transfer->source);
+    if (!transfer->body)
+    {
+        set_response_error(response, "Failed to prepare request body");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+transfer_prepare_multipart(upload_transfer_t *transfer)
+{
+    host_config_t *host = transfer->host;
+
+    transfer->mime = curl_mime_init(transfer->curl);
+    if (!transfer->mime)
+    {
+        set_response_error(transfer->response, "Failed to initialize mime form");
+        return false;
+    }
+
+    if (!transfer_open_body(transfer, REQUEST_BODY_BINARY))
+    {
+        return false;
+    }
+
+    char *filename = get_filename_from_path(transfer->file_path);
+    curl_mimepart *part = curl_mime_addpart(transfer->mime);
+    curl_mime_name(part, host->file_form_field);
+    curl_mime_filename(part, filename ? filename : transfer->file_path);
+    curl_mime_type(part, upload_body_content_type(transfer->body, transfer->file_path));
+    curl_mime_data_cb(part,
+                      upload_body_size(transfer->body),
+                      upload_body_read_callback,
+                      upload_body_seek_callback,
+                      NULL,
+                      transfer->body);
+    free(filename);
+
+    for (int i = 0; i < host->static_field_count; i++)
+    {
+        part = curl_mime_addpart(transfer->mime);
+        curl_mime_name(part, host->static_field_names[i]);
+        curl_mime_data(part, host->static_field_values[i], CURL_ZERO_TERMINATED);
+    }
+
+    return true;
+}
+
+static bool
+transfer_prepare_stream(upload_transfer_t *transfer, request_body_format_t format)
+{
+    if (!transfer_open_body(transfer, format))
+    {
+        return false;
+    }
+
+    char content_type[128];
+    snprintf(content_type,
+             sizeof(content_type),
+             "Content-Type: %s",
+             upload_body_content_type(transfer->body, transfer->file_path));
+    transfer->headers = curl_slist_append(transfer->headers, content_type);
+
+    return true;
+}
+
+static void
+transfer_set_method(upload_transfer_t *transfer)
+{
+    CURL *curl = transfer->curl;
+
+    curl_easy_setopt(curl, CURLOPT_UPLOAD_BUFFERSIZE, UPLOAD_BUFFER_SIZE);
+    const char *method = transfer->host->request_method;
+    bool is_put = method && strcasecmp(method, "PUT") == 0;
+
+    if (transfer->mime)
+    {
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, transfer->mime);
+    }
+    else
+    {
+        curl_off_t size = upload_body_size(transfer->body);
+
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_body_read_callback);
+        curl_easy_setopt(curl, CURLOPT_READDATA, transfer->body);
+        curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, upload_body_seek_callback);
+        curl_easy_setopt(curl, CURLOPT_SEEKDATA, transfer->body);
+
+        if (is_put)
+        {
+            curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+            curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, size);
+        }
+        else
+        {
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, size);
+        }
+    }
+
+    if (method && !is_put && strcasecmp(method, "POST") != 0)
+    {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+    }
+}
+
+/* Opens the file once and picks up an upload an earlier run left unfinished */
+static bool
+tus_start(upload_transfer_t *transfer)
+{
+    host_config_t *host = transfer->host;
+
+    if (!transfer_open_body(transfer, REQUEST_BODY_BINARY))
+    {
+        return false;
+    }
+
+    transfer->tus_size = upload_source_size(transfer->source);
+    if (transfer->tus_size < 0)
+    {
+        set_response_error(transfer->response, "tus uploads need a file of known size");
+        return false;
+    }
+
+    network_chunk_size(host, &transfer->tus_chunk);
+    transfer->tus_stage = TUS_STAGE_CREATE;
+
+    /* Only named files can be matched up with an upload again after a restart */
+    struct stat file_stat;
+    char resolved[PATH_MAX];
+    if (!transfer->owns_source || stat(transfer->file_path, &file_stat) != 0 ||
+        !realpath(transfer->file_path, resolved))
+    {
+        return true;
+    }
+
+    transfer->tus_key = strdup(resolved);
+    transfer->tus_mtime = (long long)file_stat.st_mtime;
+
+    long long offset = 0;
+    if (transfer->tus_key && db_tus_find(transfer->tus_key,
+                                         host->name,
+                                         transfer->tus_size,
+                                         transfer->tus_mtime,
+                                         &transfer->tus_url,
+                                         &offset))
+    {
+        transfer->tus_offset = offset;
+        transfer->tus_stage = TUS_STAGE_HEAD;
+        log_info("Resuming tus upload of %s from %s", transfer->file_path, transfer->tus_url);
+    }
+
+    return true;
+}
+
+static bool
+transfer_prepare_tus(upload_transfer_t *transfer)
+{
+    CURL *curl = transfer->curl;
+    char header[64];
+
+    if (transfer->tus_stage == TUS_STAGE_NONE && !tus_start(transfer))
+    {
+        return false;
+    }
+
+    free(transfer->tus_location);
+    transfer->tus_location = NULL;
+    transfer->tus_server_offset = -1;
+    transfer->prog_data.size = 0;
+    transfer->headers = curl_slist_append(transfer->headers, "Tus-Resumable: " TUS_VERSION);
+
+    if (transfer->tus_stage == TUS_STAGE_CREATE)
+    {
+        snprintf(header, sizeof(header), "Upload-Length: %lld", (long long)transfer->tus_size);
+        transfer->headers = curl_slist_append(transfer->headers, header);
+        transfer->headers =
+          tus_append_metadata(transfer->headers,
+                              transfer->file_path,
+                              upload_body_content_type(transfer->body, transfer->file_path));
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, "");
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)0);
+        return true;
+    }
+
+    if (transfer->tus_stage == TUS_STAGE_HEAD)
+    {
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        return true;
+    }
+
+    curl_off_t length = transfer->tus_size - transfer->tus_offset;
+    if (length > transfer->tus_chunk)
+    {
+        length = transfer->tus_chunk;
+    }
+
+    if (!upload_body_set_range(transfer->body, transfer->tus_offset, length))
+    {
+        set_response_error(transfer->response, "Upload source cannot be rewound");
+        return false;
+    }
+
+    snprintf(header, sizeof(header), "Upload-Offset: %lld", (long long)transfer->tus_offset);
+    transfer->headers = curl_slist_append(transfer->headers, header);
+    transfer->headers =
+      curl_slist_append(transfer->headers, "Content-Type: application/offset+octet-stream");
+    transfer->headers = curl_slist_append(transfer->headers, "Expect:");
+
+    curl_easy_setopt(curl, CURLOPT_UPLOAD_BUFFERSIZE, UPLOAD_BUFFER_SIZE);
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, length);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_body_read_callback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, transfer->body);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, upload_body_seek_callback);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, transfer->body);
+
+    transfer->prog_data.offset = transfer->tus_offset;
+    transfer->prog_data.size = transfer->tus_size;
+
+    return true;
+}
+
+static curl_off_t
+s3_part_length(const s3_upload_t *s3, int part)
+{
+    curl_off_t offset = (curl_off_t)(part - 1) * s3->part_size;
+    curl_off_t length = s3->size - offset;
+    return length < s3->part_size ? length : s3->part_size;
+}
+
+static void
+s3_upload_clear(s3_upload_t *s3)
+{
+    for (int i = 0; s3->etags && i < s3->part_count; i++)
+    {
+        free(s3->etags[i]);
+    }
+    free(s3->etags);
+    free(s3->object_url);
+    free(s3->upload_id);
+    free(s3->error);
+}
+
+static bool
+transfer_prepare_s3(upload_transfer_t *transfer)
+{
+    s3_upload_t *s3 = transfer->s3;
+    host_config_t *host = transfer->host;
+    CURL *curl = transfer->curl;
+    const char *method = "POST";
+    const char *payload = "";
+    char payload_hash[CONTENT_HASH_HEX_LEN + 1];
+
+    size_t url_len = strlen(s3->object_url) + (s3->upload_id ? strlen(s3->upload_id) : 0) + 64;
+    free(transfer->request_url);
+    transfer->request_url = malloc(url_len);
+    free(transfer->s3_etag);
+    transfer->s3_etag = NULL;
+    if (!transfer->request_url)
+    {
+        set_response_error(transfer->response, "Failed to allocate memory for request URL");
+        return false;
+    }
+
+    if (transfer->s3_stage == S3_STAGE_PUT || transfer->s3_stage == S3_STAGE_PART)
+    {
+        method = "PUT";
+        payload = NULL;
+        if (!transfer_open_body(transfer, REQUEST_BODY_BINARY))
+        {
+            return false;
+        }
+
+        if (transfer->s3_stage == S3_STAGE_PUT)
+        {
+            s3->size = upload_source_size(transfer->source);
+            if (s3->size < 0)
+            {
+                set_response_error(transfer->response, "S3 uploads need a file of known size");
+                return false;
+            }
+        }
+
+        curl_off_t length = s3->size;
+        if (transfer->s3_stage == S3_STAGE_PART)
+        {
+            length = s3_part_length(s3, transfer->s3_part);
+            if (!upload_body_set_range(transfer->body,
+                                       (curl_off_t)(transfer->s3_part - 1) * s3->part_size,
+                                       length))
+            {
+                set_response_error(transfer->response, "Upload source cannot be rewound");
+                return false;
+            }
+            snprintf(transfer->request_url,
+                     url_len,
+                     "%s?partNumber=%d&uploadId=%s",
+                     s3->object_url,
+                     transfer->s3_part,
+                     s3->upload_id);
+        }
+        else
+        {
+            char content_type[128];
+            snprintf(content_type,
+                     sizeof(content_type),
+                     "Content-Type: %s",
+                     upload_body_content_type(transfer->body, transfer->file_path));
+            transfer->headers = curl_slist_append(transfer->headers, content_type);
+            snprintf(transfer->request_url, url_len, "%s", s3->object_url);
+        }
+
+        transfer->headers = curl_slist_append(transfer->headers, "Expect:");
+        curl_easy_setopt(curl, CURLOPT_UPLOAD_BUFFERSIZE, UPLOAD_BUFFER_SIZE);
+        curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+        curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, length);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_body_read_callback);
+        curl_easy_setopt(curl, CURLOPT_READDATA, transfer->body);
+        curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, upload_body_seek_callback);
+        curl_easy_setopt(curl, CURLOPT_SEEKDATA, transfer->body);
+    }
+    else if (transfer->s3_stage == S3_STAGE_CREATE)
+    {
+        snprintf(transfer->request_url, url_len, "%s?uploads", s3->object_url);
+    }
+    else
+    {
+        snprintf(
+          transfer->request_url, url_len, "%s?uploadId=%s", s3->object_url, s3->upload_id);
+        if (transfer->s3_stage == S3_STAGE_COMPLETE)
+        {
+            payload = transfer->request_body;
+            transfer->headers =
+              curl_slist_append(transfer->headers, "Content-Type: application/xml");
+        }
+        else
+        {
+            method = "DELETE";
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+        }
+    }
+
+    if (payload && strcmp(method, "POST") == 0)
+    {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)strlen(payload));
+    }
+
+    /* Part bodies are streamed from the file, so only the small request bodies are hashed */
+    bool hashed = payload ? s3_payload_hash(payload, strlen(payload), payload_hash)
+                          : snprintf(payload_hash, sizeof(payload_hash), S3_UNSIGNED_PAYLOAD) > 0;
+    if (strcmp(host->auth_type, "sigv4") == 0 &&
+        (!hashed ||
+         !s3_sign(
+           &transfer->headers, host, method, transfer->request_url, payload_hash, time(NULL))))
+    {
+        set_response_error(transfer->response, "Failed to sign S3 request");
+        return false;
+    }
+
+    return true;
+}
+
+static size_t
+header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    upload_transfer_t *transfer = userdata;
+
+    if (transfer->tus_stage != TUS_STAGE_NONE)
+    {
+        tus_parse_header(
+          buffer, size * nitems, &transfer->tus_location, &transfer->tus_server_offset);
+    }
+
+    const char *etag;
+    size_t etag_len;
+    if (transfer->s3_stage == S3_STAGE_PART &&
+        response_header_value(buffer, size * nitems, "ETag", &etag, &etag_len) && etag_len > 0)
+    {
+        free(transfer->s3_etag);
+        transfer->s3_etag = strndup(etag, etag_len);
+    }
+
+    if (!transfer->got_first_byte)
+    {
+        long code = 0;
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &code);
+        if (code >= 200)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &transfer->first_byte_time);
+            transfer->got_first_byte = true;
+        }
+    }
+
+    return size * nitems;
+}
+
+static bool
+transfer_prepare(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    host_config_t *host = transfer->host;
+
+    transfer->curl = session_acquire_handle(transfer->session);
+    if (!transfer->curl)
+    {
+        set_response_error(response, "Failed to initialize curl");
+        return false;
+    }
+
+    request_body_format_t format = request_body_format_from_string(host->request_body_format);
+    if (format == REQUEST_BODY_S3)
+    {
+        if (!transfer_prepare_s3(transfer))
+        {
+            transfer_release_handle(transfer);
+            return false;
+        }
+    }
+    else if (format == REQUEST_BODY_TUS)
+    {
+        if (!transfer_prepare_tus(transfer))
+        {
+            transfer_release_handle(transfer);
+            return false;
+        }
+    }
+    else if (format == REQUEST_BODY_MULTIPART)
+    {
+        if (!transfer_prepare_multipart(transfer))
+        {
+            transfer_release_handle(transfer);
+            return false;
+        }
+    }
+    else if (!transfer_prepare_stream(transfer, format))
+    {
+        transfer_release_handle(transfer);
+        return false;
+    }
+
+    if (!append_auth_header(host, &transfer->headers, response))
+    {
+        transfer_release_handle(transfer);
+        return false;
+    }
+
+    /* Once created, a tus upload is addressed by the URL the server gave it */
+    bool tus_created =
+      transfer->tus_stage == TUS_STAGE_HEAD || transfer->tus_stage == TUS_STAGE_PATCH;
+    const char *url = tus_created ? transfer->tus_url : host->api_endpoint;
+    if (format == REQUEST_BODY_S3)
+    {
+        url = transfer->request_url;
+    }
+
+    configure_curl_handle(transfer->curl,
+                          transfer->headers,
+                          &transfer->response_buffer,
+                          transfer->show_progress ? &transfer->prog_data : NULL,
+                          url);
+    if (format != REQUEST_BODY_TUS && format != REQUEST_BODY_S3)
+    {
+        transfer_set_method(transfer);
+    }
+    curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+    curl_easy_setopt(transfer->curl, CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(transfer->curl, CURLOPT_HEADERDATA, transfer);
+    transfer->got_first_byte = false;
+    transfer->continuing = false;
+
+    if (!global_config.proxy_url)
+    {
+        transfer->resolve = netcache_resolve_list(url);
+        curl_easy_setopt(transfer->curl, CURLOPT_RESOLVE, transfer->resolve);
+    }
+
+    transfer->prog_data.last_time = time(NULL);
+
+    log_info("Connecting to host: %s (attempt %d)", host->api_endpoint, transfer->attempt + 1);
+    clock_gettime(CLOCK_MONOTONIC, &transfer->start_time);
+
+    return true;
+}
+
+static void
+record_attempt(upload_response_t *response, CURLcode res, retry_class_t retry_class, long delay_ms)
+{
+    upload_attempt_t *attempts =
+      realloc(response->attempts, (response->attempt_count + 1) * sizeof(upload_attempt_t));
+    if (!attempts)
+    {
+        log_error("Failed to allocate memory for upload attempt record");
+        return;
+    }
+
+    response->attempts = attempts;
+    upload_attempt_t *attempt = &attempts[response->attempt_count++];
+    attempt->curl_code = res;
+    attempt->http_code = response->http_code;
+    attempt->retry_class = retry_class;
+    attempt->delay_ms = delay_ms;
+    snprintf(attempt->reason,
+             sizeof(attempt->reason),
+             "%s",
+             response->success ? "OK"
+                               : (response->error_message ? response->error_message : "Unknown"));
+}
+
+static void
+set_http_error(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    response_buffer_t *response_buffer = &transfer->response_buffer;
+
+    char error_buf[256];
+    snprintf(error_buf, sizeof(error_buf), "HTTP %ld", response->http_code);
+    if (response_buffer->data && response_buffer->size > 0)
+    {
+        json_path_match_t matches[ERROR_MESSAGE_FIELD_COUNT];
+        for (size_t i = 0; i < ERROR_MESSAGE_FIELD_COUNT; i++)
+        {
+            matches[i].path = &error_message_paths[i];
+        }
+        json_path_extract(
+          response_buffer->data, response_buffer->size, matches, ERROR_MESSAGE_FIELD_COUNT);
+
+        char *msg = NULL;
+        for (size_t i = 0; i < ERROR_MESSAGE_FIELD_COUNT && !msg; i++)
+        {
+            msg = json_path_match_dup(&matches[i]);
+        }
+        if (msg)
+        {
+            snprintf(error_buf, sizeof(error_buf), "HTTP %ld: %s", response->http_code, msg);
+            free(msg);
+        }
+    }
+    set_response_error(response, error_buf);
+    log_error("Upload failed: %s", response->error_message);
+}
+
+/* Reads the file again for the content hash of an upload that did not send it in one pass, when
+ * the caller asked for it */
+static void
+transfer_rehash(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    bool wanted = transfer->options && transfer->options->hash_contents;
+    if (wanted && response->content_hash[0] == '\0' && transfer->owns_source &&
+        !content_hash_file(transfer->file_path, response->content_hash))
+    {
+        response->content_hash[0] = '\0';
+    }
+}
+
+static void
+tus_forget(upload_transfer_t *transfer)
+{
+    if (transfer->tus_key)
+    {
+        db_tus_remove(transfer->tus_key, transfer->host->name);
+    }
+}
+
+static void
+tus_finish(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+
+    response->url = strdup(transfer->tus_url);
+    response->success = response->url != NULL;
+    if (!response->success)
+    {
+        set_response_error(response, "Failed to allocate memory for upload URL");
+        return;
+    }
+
+    /* A resumed upload never read the whole file in one pass */
+    transfer_rehash(transfer);
+
+    tus_forget(transfer);
+    log_info("Upload successful, URL: %s", response->url);
+}
+
+/* Handles a 2xx or tus-specific answer to one step. Returns true when the upload continues
+ * with another request, false when it finished or failed. */
+static bool
+tus_step_complete(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    long code = response->http_code;
+
+    if ((code == 404 || code == 410) && transfer->tus_stage != TUS_STAGE_CREATE &&
+        transfer->tus_restarts < TUS_MAX_RESTARTS)
+    {
+        log_warn("tus upload of %s is gone from the server, starting over", transfer->file_path);
+        tus_forget(transfer);
+        free(transfer->tus_url);
+        transfer->tus_url = NULL;
+        transfer->tus_offset = 0;
+        transfer->tus_stage = TUS_STAGE_CREATE;
+        transfer->tus_restarts++;
+        return true;
+    }
+
+    if (code == 409 && transfer->tus_stage == TUS_STAGE_PATCH &&
+        transfer->tus_restarts < TUS_MAX_RESTARTS)
+    {
+        log_warn("tus server disagrees on the offset of %s, asking again", transfer->file_path);
+        transfer->tus_stage = TUS_STAGE_HEAD;
+        transfer->tus_restarts++;
+        return true;
+    }
+
+    if (code < 200 || code >= 300)
+    {
+        set_http_error(transfer);
+        return false;
+    }
+
+    curl_off_t server_offset = transfer->tus_server_offset;
+    if (transfer->tus_stage == TUS_STAGE_CREATE)
+    {
+        char *url = transfer->tus_location
+                      ? tus_resolve_url(transfer->host->api_endpoint, transfer->tus_location)
+                      : NULL;
+        if (!url)
+        {
+            set_response_error(response, "tus server did not return a valid upload location");
+            log_error("Upload failed: %s", response->error_message);
+            return false;
+        }
+
+        free(transfer->tus_url);
+        transfer->tus_url = url;
+        transfer->tus_offset = 0;
+        log_info("Created tus upload %s", url);
+    }
+    else if (transfer->tus_stage == TUS_STAGE_HEAD)
+    {
+        if (server_offset < 0 || server_offset > transfer->tus_size)
+        {
+            set_response_error(response, "tus server did not report a valid upload offset");
+            log_error("Upload failed: %s", response->error_message);
+            return false;
+        }
+
+        if (server_offset > transfer->tus_offset)
+        {
+            transfer->tus_restarts = 0;
+        }
+        transfer->tus_offset = server_offset;
+        log_info("tus upload of %s continues at byte %lld of %lld",
+                 transfer->file_path,
+                 (long long)server_offset,
+                 (long long)transfer->tus_size);
+    }
+    else
+    {
+        if (server_offset <= transfer->tus_offset || server_offset > transfer->tus_size)
+        {
+            set_response_error(response, "tus server did not accept the uploaded chunk");
+            log_error("Upload failed: %s", response->error_message);
+            return false;
+        }
+
+        /* Retries are counted per stalled chunk, not across the whole file */
+        transfer->tus_offset = server_offset;
+        transfer->attempt = 0;
+        transfer->tus_restarts = 0;
+    }
+
+    if (transfer->tus_key)
+    {
+        db_tus_save(transfer->tus_key,
+                    transfer->host->name,
+                    transfer->tus_size,
+                    transfer->tus_mtime,
+                    transfer->tus_url,
+                    transfer->tus_offset);
+    }
+
+    if (transfer->tus_offset >= transfer->tus_size)
+    {
+        tus_finish(transfer);
+        return false;
+    }
+
+    transfer->tus_stage = TUS_STAGE_PATCH;
+    return true;
+}
+
+/* A completion can fail after its 200 status line was sent, so its body is checked as well */
+static void
+s3_step_complete(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    response_buffer_t *buffer = &transfer->response_buffer;
+    s3_upload_t *s3 = transfer->s3;
+    long code = response->http_code;
+
+    char *error_code = s3_xml_value(buffer->data, buffer->size, "Code");
+    bool ok = code >= 200 && code < 300 && !(transfer->s3_stage == S3_STAGE_COMPLETE && error_code);
+
+    if (!ok && !error_code)
+    {
+        set_http_error(transfer);
+    }
+    else if (!ok)
+    {
+        char *message = s3_xml_value(buffer->data, buffer->size, "Message");
+        char error_buf[512];
+        snprintf(error_buf,
+                 sizeof(error_buf),
+                 "HTTP %ld: %s%s%s",
+                 code,
+                 error_code,
+                 message ? ": " : "",
+                 message ? message : "");
+        set_response_error(response, error_buf);
+        log_error("Upload failed: %s", response->error_message);
+        free(message);
+    }
+    else if (transfer->s3_stage == S3_STAGE_CREATE)
+    {
+        char *upload_id = s3_xml_value(buffer->data, buffer->size, "UploadId");
+        char *escaped = upload_id ? curl_easy_escape(NULL, upload_id, 0) : NULL;
+        free(s3->upload_id);
+        s3->upload_id = escaped ? strdup(escaped) : NULL;
+        curl_free(escaped);
+        free(upload_id);
+
+        response->success = s3->upload_id != NULL;
+        if (!response->success)
+        {
+            set_response_error(response, "S3 did not return a multipart upload ID");
+            log_error("Upload failed: %s", response->error_message);
+        }
+    }
+    else if (transfer->s3_stage == S3_STAGE_PART)
+    {
+        response->success = transfer->s3_etag != NULL;
+        if (response->success)
+        {
+            free(s3->etags[transfer->s3_part - 1]);
+            s3->etags[transfer->s3_part - 1] = transfer->s3_etag;
+            transfer->s3_etag = NULL;
+        }
+        else
+        {
+            set_response_error(response, "S3 did not return an ETag for the part");
+            log_error("Upload failed: %s", response->error_message);
+        }
+    }
+    else
+    {
+        /* A single PUT or a completed multipart upload leaves the object at its URL */
+        response->url = strdup(s3->object_url);
+        response->success = response->url != NULL;
+        response->bytes_sent = s3->size;
+        if (response->success)
+        {
+            log_info("Upload successful, URL: %s", s3->object_url);
+        }
+        else
+        {
+            set_response_error(response, "Failed to allocate memory for URL");
+        }
+    }
+
+    free(error_code);
+}
+
+static bool
+transfer_complete(upload_transfer_t *transfer, CURLcode res)
+{
+    upload_response_t *response = transfer->response;
+    host_config_t *host = transfer->host;
+    response_buffer_t *response_buffer = &transfer->response_buffer;
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double time_taken_ms = (end_time.tv_sec - transfer->start_time.tv_sec) * 1000.0;
+    time_taken_ms += (end_time.tv_nsec - transfer->start_time.tv_nsec) / 1000000.0;
+    response->request_time_ms = time_taken_ms;
+
+    if (transfer->show_progress)
+    {
+        fprintf(stderr, "\r\033[K");
+    }
+
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response->http_code);
+
+    long long since_first_byte_us = -1;
+    if (transfer->got_first_byte)
+    {
+        since_first_byte_us = (end_time.tv_sec - transfer->first_byte_time.tv_sec) * 1000000LL;
+        since_first_byte_us += (end_time.tv_nsec - transfer->first_byte_time.tv_nsec) / 1000;
+    }
+    transfer_timing_capture(transfer->curl, since_first_byte_us, &response->timing);
+
+    const long long *phase_us = response->timing.phase_us;
+    log_info("Timing for %s: dns=%lldus connect=%lldus tls=%lldus pretransfer=%lldus "
+             "ttfb=%lldus total=%lldus speed=%lldB/s http=%s ip=%s",
+             host->api_endpoint,
+             phase_us[TIMING_PHASE_DNS],
+             phase_us[TIMING_PHASE_CONNECT],
+             phase_us[TIMING_PHASE_TLS],
+             phase_us[TIMING_PHASE_PRETRANSFER],
+             phase_us[TIMING_PHASE_TTFB],
+             phase_us[TIMING_PHASE_TOTAL],
+             response->timing.upload_speed,
+             response->timing.http_version,
+             response->timing.remote_ip);
+
+    bool stale_address =
+      !global_config.proxy_url && netcache_record_transfer(transfer->curl, host->api_endpoint, res);
+
+    if (transfer->source)
+    {
+        response->bytes_sent = upload_source_bytes_read(transfer->source);
+
+        const char *digest = upload_source_digest(transfer->source);
+        snprintf(
+          response->content_hash, sizeof(response->content_hash), "%s", digest ? digest : "");
+    }
+
+    if (response_buffer_exceeded(response_buffer, res))
+    {
+        char error_buf[128];
+        snprintf(error_buf,
+                 sizeof(error_buf),
+                 "Response exceeded the maximum size of %zu bytes",
+                 response_buffer->max_size);
+        set_response_error(response, error_buf);
+        log_error("Upload failed: %s", response->error_message);
+    }
+    else if (res != CURLE_OK)
+    {
+        set_response_error(response, curl_easy_strerror(res));
+        log_error("Upload failed: %s", response->error_message);
+    }
+    else if (transfer->s3_stage != S3_STAGE_NONE)
+    {
+        s3_step_complete(transfer);
+    }
+    else if (transfer->tus_stage != TUS_STAGE_NONE)
+    {
+        if (tus_step_complete(transfer))
+        {
+            transfer_release_handle(transfer);
+            transfer->continuing = true;
+            transfer->retryable = true;
+            transfer->retry_delay_ms = 0;
+            return false;
+        }
+    }
+    else if (response->http_code >= 200 && response->http_code < 300)
+    {
+        config_compile_host_paths(host);
+
+        json_path_match_t matches[] = { { .path = &host->response_url_path },
+                                        { .path = &host->response_deletion_url_path } };
+        if (response_buffer->data)
+        {
+            json_path_extract(response_buffer->data, response_buffer->size, matches, 2);
+        }
+
+        char *url =
+          extract_response_value(response_buffer->data, host->response_url_json_path, &matches[0]);
+        if (url)
+        {
+            response->success = true;
+            response->url = url;
+            log_info("Upload successful, URL: %s", url);
+
+            if (host->response_deletion_url_json_path &&
+                strlen(host->response_deletion_url_json_path) > 0)
+            {
+                char *deletion_url = json_path_match_dup(&matches[1]);
+                if (deletion_url)
+                {
+                    response->deletion_url = deletion_url;
+                    log_info("Deletion URL extracted: %s", deletion_url);
+                }
+                else
+                {
+                    log_warn("Could not extract deletion URL using path: %s",
+                             host->response_deletion_url_json_path);
+                }
+            }
+        }
+        else
+        {
+            set_response_error(response, "Failed to extract URL from response");
+            log_error("Failed to extract URL from response: %s", response_buffer->data);
+        }
+    }
+    else
+    {
+        set_http_error(transfer);
+    }
+
+    retry_class_t retry_class = retry_classify(res, response->http_code);
+    if (retry_class == RETRY_CLASS_NONE && !response->success)
+    {
+        retry_class = RETRY_CLASS_FATAL;
+    }
+
+    long retry_after_ms = 0;
+    if (retry_class == RETRY_CLASS_RATE_LIMITED)
+    {
+        curl_off_t retry_after = 0;
+        if (curl_easy_getinfo(transfer->curl, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK &&
+            retry_after > 0)
+        {
+            retry_after_ms = (long)retry_after * 1000;
+        }
+    }
+
+    transfer_release_handle(transfer);
+    transfer->attempt++;
+    response->retry_count = transfer->attempt;
+
+    retry_policy_t policy = { .max_attempts = global_config.max_retries,
+                              .base_delay_ms = global_config.retry_delay_ms,
+                              .max_delay_ms = global_config.max_retry_delay_ms };
+
+    transfer->retryable =
+      retry_is_retryable(retry_class) && transfer->attempt < policy.max_attempts;
+    transfer->retry_delay_ms =
+      transfer->retryable && !stale_address
+        ? retry_backoff_ms(&policy, transfer->attempt, retry_after_ms)
+        : 0;
+
+    if (transfer->retry_delay_ms < 0)
+    {
+        char error_buf[512];
+        snprintf(error_buf,
+                 sizeof(error_buf),
+                 "%s (server asked to retry after %ld s, beyond the %ld s retry limit)",
+                 response->error_message ? response->error_message : "Rate limited",
+                 retry_after_ms / 1000,
+                 policy.max_delay_ms / 1000);
+        set_response_error(response, error_buf);
+        log_warn("Not retrying upload of %s: %s", transfer->file_path, error_buf);
+        transfer->retryable = false;
+        transfer->retry_delay_ms = 0;
+    }
+
+    record_attempt(response, res, retry_class, transfer->retry_delay_ms);
+
+    /* Ask the server how much of an interrupted chunk it kept before sending more */
+    if (!response->success && transfer->tus_stage == TUS_STAGE_PATCH)
+    {
+        transfer->tus_stage = TUS_STAGE_HEAD;
+    }
+
+    if (!response->success && !retry_is_retryable(retry_class))
+    {
+        log_info("Not retrying upload of %s: %s error",
+                 transfer->file_path,
+                 retry_class_name(retry_class));
+    }
+
+    return response->success;
+}
+
+static const char *
+transfer_root(const upload_transfer_t *transfer)
+{
+    return transfer->options ? transfer->options->root : NULL;
+}
+
+static upload_transfer_t *
+transfer_create(network_session_t *session,
+                const char *file_path,
+                host_config_t *host,
+                const network_upload_options_t *options,
+                int index)
+{
+    upload_transfer_t *transfer = calloc(1, sizeof(upload_transfer_t));
+    if (!transfer)
+    {
+        return NULL;
+    }
+
+    transfer->index = index;
+    transfer->host = host;
+    transfer->options = options;
+    transfer->show_progress = options && options->show_progress;
+    transfer->session = session;
+    transfer->file_path = strdup(file_path ? file_path : "");
+    transfer->response = calloc(1, sizeof(upload_response_t));
+    if (!transfer->file_path || !transfer->response)
+    {
+        free(transfer->file_path);
+        free(transfer->response);
+        free(transfer);
+        return NULL;
+    }
+
+    size_t max_response_size;
+    network_max_response_size(host, &max_response_size);
+    session_acquire_buffer(session, &transfer->response_buffer, max_response_size);
+
+    return transfer;
+}
+
+static void
+transfer_free(upload_transfer_t *transfer)
+{
+    if (!transfer)
+    {
+        return;
+    }
+
+    transfer_release_handle(transfer);
+    upload_body_free(transfer->body);
+    if (transfer->owns_source)
+    {
+        upload_source_close(transfer->source);
+    }
+    session_release_buffer(transfer->session, &transfer->response_buffer);
+    free(transfer->tus_url);
+    free(transfer->tus_key);
+    free(transfer->tus_location);
+    if (transfer->owns_s3)
+    {
+        s3_upload_clear(transfer->s3);
+        free(transfer->s3);
+    }
+    free(transfer->s3_etag);
+    free(transfer->request_url);
+    free(transfer->request_body);
+    free(transfer->file_path);
+    network_free_response(transfer->response);
+    free(transfer);
+}
+
+/* Resumes a transfer the rate limiter paused once tokens are available again. Returns how long
+ * the caller should wait before asking again, or 0 when the transfer is not held back. */
+static long
+transfer_resume_paced(upload_transfer_t *transfer)
+{
+    if (!transfer->curl || !transfer->body || !upload_body_is_paused(transfer->body))
+    {
+        return 0;
+    }
+
+    long wait_ms = rate_limit_wait_ms();
+    if (wait_ms == 0)
+    {
+        upload_body_resume(transfer->body);
+        curl_easy_pause(transfer->curl, CURLPAUSE_CONT);
+    }
+
+    return wait_ms;
+}
+
+static CURLcode
+transfer_perform(upload_transfer_t *transfer)
+{
+    if (rate_limit_get() == 0)
+    {
+        return curl_easy_perform(transfer->curl);
+    }
+
+    /* Only the loop driving a paused handle can resume it, so paced uploads run on a multi */
+    CURLM *multi = curl_multi_init();
+    if (!multi)
+    {
+        return CURLE_OUT_OF_MEMORY;
+    }
+
+    if (curl_multi_add_handle(multi, transfer->curl) != CURLM_OK)
+    {
+        curl_multi_cleanup(multi);
+        return CURLE_FAILED_INIT;
+    }
+
+    CURLcode result = CURLE_OK;
+    bool done = false;
+    while (!done)
+    {
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK)
+        {
+            result = CURLE_FAILED_INIT;
+            break;
+        }
+
+        CURLMsg *msg;
+        int queued = 0;
+        while ((msg = curl_multi_info_read(multi, &queued)))
+        {
+            if (msg->msg == CURLMSG_DONE)
+            {
+                result = msg->data.result;
+                done = true;
+            }
+        }
+
+        if (!done)
+        {
+            long timeout_ms = transfer_resume_paced(transfer);
+            curl_multi_poll(multi, NULL, 0, timeout_ms > 0 ? (int)timeout_ms : 1000, NULL);
+        }
+    }
+
+    curl_multi_remove_handle(multi, transfer->curl);
+    curl_multi_cleanup(multi);
+
+    return result;
+}
+
+static bool
+transfer_run_attempts(upload_transfer_t *transfer)
+{
+    do
+    {
+        if (transfer->attempt > 0 && !transfer->continuing)
+        {
+            log_info("Retrying upload in %ld ms (attempt %d of %d)",
+                     transfer->retry_delay_ms,
+                     transfer->attempt + 1,
+                     global_config.max_retries);
+            retry_sleep_ms(transfer->retry_delay_ms);
+        }
+
+        if (!transfer_prepare(transfer))
+        {
+            break;
+        }
+
+        transfer_complete(transfer, transfer_perform(transfer));
+    } while (!transfer->response->success && transfer->retryable);
+
+    return transfer->response->success;
+}
+
+static void
+s3_run(upload_transfer_t *transfer);
+
+static void
+transfer_execute(upload_transfer_t *transfer)
+{
+    if (request_body_format_from_string(transfer->host->request_body_format) == REQUEST_BODY_S3)
+    {
+        s3_run(transfer);
+    }
+    else
+    {
+        transfer_run_attempts(transfer);
+    }
+}
+
+static upload_response_t *
+transfer_run(upload_transfer_t *transfer, bool valid)
+{
+    transfer->show_progress = true;
+
+    if (valid)
+    {
+        transfer_execute(transfer);
+    }
+
+    upload_response_t *response = transfer->response;
+    transfer->response = NULL;
+    transfer_free(transfer);
+
+    return response;
+}
+
+upload_response_t *
+network_upload_file(network_session_t *session,
+                    const char *file_path,
+                    host_config_t *host,
+                    const network_upload_options_t *options)
+{
+    upload_transfer_t *transfer = transfer_create(session, file_path, host, options, 0);
+    if (!transfer)
+    {
+        log_error("Failed to allocate memory for upload response");
+        return NULL;
+    }
+
+    return transfer_run(transfer, validate_upload(file_path, host, transfer->response));
+}
+
+upload_response_t *
+network_upload_source(network_session_t *session,
+                      upload_source_t *source,
+                      const char *name,
+                      host_config_t *host)
+{
+    upload_transfer_t *transfer = transfer_create(session, name, host, NULL, 0);
+    if (!transfer)
+    {
+        log_error("Failed to allocate memory for upload response");
+        return NULL;
+    }
+
+    transfer->source = source;
+
+    return transfer_run(transfer, validate_host(host, transfer->response));
+}
+
+static long
+ms_until(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (deadline->tv_sec - now.tv_sec) * 1000L;
+    ms += (deadline->tv_nsec - now.tv_nsec) / 1000000L;
+    return ms > 0 ? ms : 0;
+}
+
+static bool
+finish_batch_transfer(upload_transfer_t **slots,
+                      upload_transfer_t *transfer,
+                      network_batch_done_fn done,
+                      void *userdata)
+{
+    bool keep_going = done(userdata, transfer->index, transfer->file_path, transfer->response);
+    if (transfer->slot >= 0)
+    {
+        slots[transfer->slot] = NULL;
+    }
+    transfer_free(transfer);
+    return keep_going;
+}
+
+static bool
+start_batch_transfer(CURLM *multi, upload_transfer_t *transfer)
+{
+    if (!transfer_prepare(transfer))
+    {
+        return false;
+    }
+
+    if (curl_multi_add_handle(multi, transfer->curl) != CURLM_OK)
+    {
+        set_response_error(transfer->response, "Failed to add transfer to curl multi handle");
+        transfer_release_handle(transfer);
+        return false;
+    }
+
+    return true;
+}
+
+/* Returns false, with the error set on the response, when the transfer cannot start */
+typedef bool (*transfer_setup_fn)(upload_transfer_t *transfer, void *userdata);
+
+/* Runs up to max_jobs transfers at once on one multi handle, retrying each on its own */
+static bool
+drive_transfers(network_session_t *session,
+                host_config_t *host,
+                const network_upload_options_t *options,
+                int max_jobs,
+                network_batch_next_fn next,
+                network_batch_done_fn done,
+                transfer_setup_fn setup,
+                void *userdata)
+{
+    if (max_jobs < 1)
+    {
+        max_jobs = 1;
+    }
+
+    CURLM *multi = curl_multi_init();
+    if (!multi)
+    {
+        log_error("Failed to initialize curl multi handle");
+        return false;
+    }
+
+    upload_transfer_t **slots = calloc(max_jobs, sizeof(upload_transfer_t *));
+    if (!slots)
+    {
+        log_error("Failed to allocate memory for batch transfers");
+        curl_multi_cleanup(multi);
+        return false;
+    }
+
+    bool exhausted = false;
+    bool stopped = false;
+
+    while (true)
+    {
+        for (int slot = 0; slot < max_jobs && !exhausted && !stopped; slot++)
+        {
+            if (slots[slot])
+            {
+                continue;
+            }
+
+            int index = 0;
+            const char *file_path = next(userdata, &index);
+            if (!file_path)
+            {
+                exhausted = true;
+                break;
+            }
+
+            upload_transfer_t *transfer = transfer_create(session, file_path, host, options, index);
+            if (!transfer)
+            {
+                log_error("Failed to allocate memory for upload response");
+                stopped = !done(userdata, index, file_path, NULL);
+                continue;
+            }
+
+            transfer->slot = slot;
+            slots[slot] = transfer;
+
+            if (!validate_upload(file_path, host, transfer->response) ||
+                (setup && !setup(transfer, userdata)) || !start_batch_transfer(multi, transfer))
+            {
+                stopped = !finish_batch_transfer(slots, transfer, done, userdata);
+            }
+        }
+
+        bool pending = false;
+        long timeout_ms = 1000;
+
+        for (int slot = 0; slot < max_jobs; slot++)
+        {
+            upload_transfer_t *transfer = slots[slot];
+            if (!transfer)
+            {
+                continue;
+            }
+
+            if (!transfer->curl)
+            {
+                long wait_ms = ms_until(&transfer->retry_at);
+                if (wait_ms > 0)
+                {
+                    pending = true;
+                    if (wait_ms < timeout_ms)
+                    {
+                        timeout_ms = wait_ms;
+                    }
+                    continue;
+                }
+
+                if (!transfer->continuing)
+                {
+                    log_info("Retrying upload of %s (attempt %d of %d)",
+                             transfer->file_path,
+                             transfer->attempt + 1,
+                             global_config.max_retries);
+                }
+
+                if (!start_batch_transfer(multi, transfer))
+                {
+                    if (!finish_batch_transfer(slots, transfer, done, userdata))
+                    {
+                        stopped = true;
+                    }
+                    continue;
+                }
+            }
+
+            pending = true;
+        }
+
+        if (!pending)
+        {
+            if (exhausted || stopped)
+            {
+                break;
+            }
+            continue;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg *msg;
+        int queued = 0;
+        bool completed = false;
+        while ((msg = curl_multi_info_read(multi, &queued)))
+        {
+            if (msg->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+
+            completed = true;
+
+            CURL *easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            upload_transfer_t *transfer = NULL;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&transfer);
+            curl_multi_remove_handle(multi, easy);
+
+            if (!transfer)
+            {
+                continue;
+            }
+
+            if (!transfer_complete(transfer, result) && transfer->retryable)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &transfer->retry_at);
+                transfer->retry_at.tv_sec += transfer->retry_delay_ms / 1000;
+                transfer->retry_at.tv_nsec += (transfer->retry_delay_ms % 1000) * 1000000L;
+                if (transfer->retry_at.tv_nsec >= 1000000000L)
+                {
+                    transfer->retry_at.tv_sec++;
+                    transfer->retry_at.tv_nsec -= 1000000000L;
+                }
+                continue;
+            }
+
+            if (!finish_batch_transfer(slots, transfer, done, userdata))
+            {
+                stopped = true;
+            }
+        }
+
+        if (!completed)
+        {
+            for (int slot = 0; slot < max_jobs; slot++)
+            {
+                long pace_ms = slots[slot] ? transfer_resume_paced(slots[slot]) : 0;
+                if (pace_ms > 0 && pace_ms < timeout_ms)
+                {
+                    timeout_ms = pace_ms;
+                }
+            }
+            db_batch_tick();
+            curl_multi_poll(multi, NULL, 0, (int)timeout_ms, NULL);
+        }
+    }
+
+    free(slots);
+    curl_multi_cleanup(multi);
+
+    return true;
+}
+
+/* An object store batch PUTs files up to part_size through the driver, max_jobs at a time, and
+ * uploads larger ones after that one by one, since each spreads its parts over part_concurrency
+ * connections of its own. With one job nothing else is in flight when the next file is asked
+ * for, so a large file is uploaded right then and the batch keeps its order. */
+typedef struct
+{
+    network_session_t *session;
+    host_config_t *host;
+    const network_upload_options_t *options;
+    int max_jobs;
+    network_batch_next_fn next;
+    network_batch_done_fn done;
+    void *userdata;
+    const char *root;
+    curl_off_t part_size;
+    s3_key_set_t *keys;
+    char **large_paths;
+    int *large_indices;
+    int large_count;
+    int large_capacity;
+    bool stopped;
+} s3_batch_t;
+
+static bool
+s3_batch_defer(s3_batch_t *batch, const char *file_path, int index)
+{
+    if (batch->large_count == batch->large_capacity)
+    {
+        int capacity = batch->large_capacity ? batch->large_capacity * 2 : 16;
+        char **paths = realloc(batch->large_paths, capacity * sizeof(char *));
+        if (paths)
+        {
+            batch->large_paths = paths;
+        }
+        int *indices = realloc(batch->large_indices, capacity * sizeof(int));
+        if (indices)
+        {
+            batch->large_indices = indices;
+        }
+        if (!paths || !indices)
+        {
+            return false;
+        }
+        batch->large_capacity = capacity;
+    }
+
+    char *copy = strdup(file_path);
+    if (!copy)
+    {
+        return false;
+    }
+
+    batch->large_paths[batch->large_count] = copy;
+    batch->large_indices[batch->large_count] = index;
+    batch->large_count++;
+    return true;
+}
+
+static bool
+s3_batch_done(void *userdata, int index, const char *file_path, upload_response_t *response)
+{
+    s3_batch_t *batch = userdata;
+    batch->stopped = !batch->done(batch->userdata, index, file_path, response);
+    return !batch->stopped;
+}
+
+/* Uploads a file larger than part_size in parts; returns false once the batch should stop */
+static bool
+s3_batch_upload_large(s3_batch_t *batch, const char *file_path, int index)
+{
+    upload_transfer_t *transfer =
+      transfer_create(batch->session, file_path, batch->host, batch->options, index);
+    if (!transfer)
+    {
+        log_error("Failed to allocate memory for upload response");
+        return s3_batch_done(batch, index, file_path, NULL);
+    }
+
+    if (validate_upload(file_path, batch->host, transfer->response))
+    {
+        s3_run(transfer);
+    }
+    bool keep_going = s3_batch_done(batch, index, file_path, transfer->response);
+    transfer_free(transfer);
+    return keep_going;
+}
+
+static const char *
+s3_batch_next(void *userdata, int *index)
+{
+    s3_batch_t *batch = userdata;
+    const char *file_path;
+
+    while ((file_path = batch->next(batch->userdata, index)))
+    {
+        struct stat file_stat;
+        if (stat(file_path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+            file_stat.st_size <= batch->part_size)
+        {
+            return file_path;
+        }
+
+        bool now = batch->max_jobs <= 1;
+        if (!now && !s3_batch_defer(batch, file_path, *index))
+        {
+            log_warn("Cannot defer %s; sending it with a single PUT", file_path);
+            return file_path;
+        }
+
+        /* Claimed now so the first of two files with the same key keeps it. A file that cannot
+         * claim its key goes through the driver instead, which reports why. */
+        char *key = s3_object_key(file_path, batch->root);
+        bool claimed = key && !s3_key_set_claim(batch->keys, key, file_path);
+        free(key);
+        if (!claimed)
+        {
+            if (!now)
+            {
+                free(batch->large_paths[--batch->large_count]);
+            }
+            return file_path;
+        }
+
+        if (now && !s3_batch_upload_large(batch, file_path, *index))
+        {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/* Two files of one batch must not write the same object, or the later one replaces the first */
+static bool
+s3_batch_setup(upload_transfer_t *transfer, void *userdata)
+{
+    s3_batch_t *batch = userdata;
+    char *key = s3_object_key(transfer->file_path, batch->root);
+    if (!key)
+    {
+        set_response_error(transfer->response, "Failed to build S3 object key");
+        return false;
+    }
+
+    const char *owner = s3_key_set_claim(batch->keys, key, transfer->file_path);
+    if (owner)
+    {
+        char error[PATH_MAX + 128];
+        snprintf(error, sizeof(error), "Object key '%s' is already used by %s", key, owner);
+        set_response_error(transfer->response, error);
+        free(key);
+        return false;
+    }
+
+    s3_upload_t *s3 = calloc(1, sizeof(s3_upload_t));
+    if (s3)
+    {
+        s3->file_path = transfer->file_path;
+        s3->part_size = batch->part_size;
+        s3->object_url = s3_object_url(transfer->host->api_endpoint, key);
+    }
+    free(key);
+    if (!s3 || !s3->object_url)
+    {
+        free(s3);
+        set_response_error(transfer->response, "Failed to build S3 object URL");
+        return false;
+    }
+
+    transfer->s3 = s3;
+    transfer->owns_s3 = true;
+    transfer->s3_stage = S3_STAGE_PUT;
+    return true;
+}
+
+bool
+network_upload_batch(network_session_t *session,
+                     host_config_t *host,
+                     int max_jobs,
+                     const network_upload_options_t *options,
+                     network_batch_next_fn next,
+                     network_batch_done_fn done,
+                     void *userdata)
+{
+    if (!next || !done)
+    {
+        return false;
+    }
+
+    if (request_body_format_from_string(host->request_body_format) != REQUEST_BODY_S3)
+    {
+        return drive_transfers(session, host, options, max_jobs, next, done, NULL, userdata);
+    }
+
+    s3_batch_t batch = { .session = session,
+                         .host = host,
+                         .options = options,
+                         .max_jobs = max_jobs,
+                         .next = next,
+                         .done = done,
+                         .userdata = userdata,
+                         .root = options ? options->root : NULL,
+                         .keys = s3_key_set_create() };
+    network_chunk_size(host, &batch.part_size);
+    if (!batch.keys)
+    {
+        log_error("Failed to allocate memory for S3 object keys");
+        return false;
+    }
+
+    bool started = drive_transfers(
+      session, host, options, max_jobs, s3_batch_next, s3_batch_done, s3_batch_setup, &batch);
+
+    for (int i = 0; i < batch.large_count; i++)
+    {
+        const char *file_path = batch.large_paths[i];
+        int index = batch.large_indices[i];
+        if (!started || batch.stopped)
+        {
+            free(batch.large_paths[i]);
+            continue;
+        }
+
+        s3_batch_upload_large(&batch, file_path, index);
+        free(batch.large_paths[i]);
+    }
+
+    free(batch.large_paths);
+    free(batch.large_indices);
+    s3_key_set_free(batch.keys);
+    return started;
+}
+
+static const char *
+s3_next_part(void *userdata, int *index)
+{
+    s3_upload_t *s3 = userdata;
+    if (s3->error || s3->next_part >= s3->part_count)
+    {
+        return NULL;
+    }
+
+    *index = ++s3->next_part;
+    return s3->file_path;
+}
+
+static bool
+s3_setup_part(upload_transfer_t *transfer, void *userdata)
+{
+    transfer->s3 = userdata;
+    transfer->s3_stage = S3_STAGE_PART;
+    transfer->s3_part = transfer->index;
+    return true;
+}
+
+static bool
+s3_part_done(void *userdata, int index, const char *file_path, upload_response_t *response)
+{
+    s3_upload_t *s3 = userdata;
+
+    if (!response || !response->success)
+    {
+        const char *error = response && response->error_message ? response->error_message
+                                                                 : "Upload failed";
+        log_error("Part %d of %s failed: %s", index, file_path, error);
+        if (!s3->error)
+        {
+            size_t len = strlen(error) + 32;
+            s3->error = malloc(len);
+            if (s3->error)
+            {
+                snprintf(s3->error, len, "Part %d failed: %s", index, error);
+            }
+        }
+        return false;
+    }
+
+    s3->bytes_done += s3_part_length(s3, index);
+    if (s3->progress)
+    {
+        progress_callback(s3->progress, 0, 0, s3->size, s3->bytes_done);
+    }
+    return true;
+}
+
+static bool
+s3_run_stage(upload_transfer_t *transfer, s3_stage_t stage)
+{
+    transfer->s3_stage = stage;
+    transfer->attempt = 0;
+    transfer->response->success = false;
+    return transfer_run_attempts(transfer);
+}
+
+/* Best effort, so the store does not keep the parts of an upload that will never complete */
+static void
+s3_abort(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    char *error = response->error_message;
+    response->error_message = NULL;
+
+    transfer->s3_stage = S3_STAGE_ABORT;
+    long code = 0;
+    CURLcode res = CURLE_FAILED_INIT;
+    if (transfer_prepare(transfer))
+    {
+        res = transfer_perform(transfer);
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &code);
+        transfer_release_handle(transfer);
+    }
+
+    if (res == CURLE_OK && code >= 200 && code < 300)
+    {
+        log_info("Aborted multipart upload of %s", transfer->file_path);
+    }
+    else
+    {
+        log_warn("Failed to abort multipart upload of %s", transfer->file_path);
+    }
+
+    free(response->error_message);
+    response->error_message = error;
+}
+
+static void
+s3_upload_multipart(upload_transfer_t *transfer, s3_upload_t *s3)
+{
+    upload_response_t *response = transfer->response;
+    host_config_t *host = transfer->host;
+
+    /* S3 caps an upload at 10000 parts, so very large files get larger parts */
+    if (s3->size > s3->part_size * S3_MAX_PARTS)
+    {
+        s3->part_size = (s3->size + S3_MAX_PARTS - 1) / S3_MAX_PARTS;
+    }
+    s3->part_count = (int)((s3->size + s3->part_size - 1) / s3->part_size);
+    s3->etags = calloc(s3->part_count, sizeof(char *));
+    if (!s3->etags)
+    {
+        set_response_error(response, "Failed to allocate memory for S3 parts");
+        return;
+    }
+
+    if (!s3_run_stage(transfer, S3_STAGE_CREATE))
+    {
+        return;
+    }
+
+    int concurrency = host->part_concurrency > 0 ? host->part_concurrency
+                                                 : S3_DEFAULT_PART_CONCURRENCY;
+    if (concurrency > S3_MAX_PART_CONCURRENCY)
+    {
+        concurrency = S3_MAX_PART_CONCURRENCY;
+    }
+
+    log_info("Uploading %s in %d parts of %lld bytes, %d at a time",
+             transfer->file_path,
+             s3->part_count,
+             (long long)s3->part_size,
+             concurrency);
+    s3->progress = transfer->show_progress ? &transfer->prog_data : NULL;
+    response->success = false;
+    drive_transfers(
+      transfer->session, host, NULL, concurrency, s3_next_part, s3_part_done, s3_setup_part, s3);
+
+    bool all_parts = !s3->error;
+    for (int i = 0; all_parts && i < s3->part_count; i++)
+    {
+        all_parts = s3->etags[i] != NULL;
+    }
+
+    if (all_parts)
+    {
+        transfer->request_body = s3_complete_body(s3->etags, s3->part_count);
+        if (!transfer->request_body)
+        {
+            set_response_error(response, "Failed to allocate memory for S3 completion");
+        }
+        else
+        {
+            s3_run_stage(transfer, S3_STAGE_COMPLETE);
+        }
+    }
+    else
+    {
+        set_response_error(response, s3->error ? s3->error : "Not every part was uploaded");
+    }
+
+    if (!response->success)
+    {
+        s3_abort(transfer);
+    }
+}
+
+static void
+s3_run(upload_transfer_t *transfer)
+{
+    upload_response_t *response = transfer->response;
+    host_config_t *host = transfer->host;
+    s3_upload_t s3 = { .file_path = transfer->file_path };
+
+    if (!transfer_open_body(transfer, REQUEST_BODY_BINARY))
+    {
+        return;
+    }
+
+    s3.size = upload_source_size(transfer->source);
+    network_chunk_size(host, &s3.part_size);
+    char *key = s3_object_key(transfer->file_path, transfer_root(transfer));
+    s3.object_url = key ? s3_object_url(host->api_endpoint, key) : NULL;
+    free(key);
+    transfer->s3 = &s3;
+
+    if (s3.size < 0)
+    {
+        set_response_error(response, "S3 uploads need a file of known size");
+    }
+    else if (!s3.object_url)
+    {
+        set_response_error(response, "Failed to build S3 object URL");
+    }
+    else if (s3.size <= s3.part_size)
+    {
+        s3_run_stage(transfer, S3_STAGE_PUT);
+    }
+    else if (!transfer->owns_source)
+    {
+        /* Parts are read concurrently through their own descriptors */
+        set_response_error(response, "S3 multipart uploads need a named file");
+    }
+    else
+    {
+        s3_upload_multipart(transfer, &s3);
+    }
+
+    /* Multipart uploads read the file in parts */
+    if (response->success)
+    {
+        transfer_rehash(transfer);
+    }
+
+    transfer->s3 = NULL;
+    transfer->s3_stage = S3_STAGE_NONE;
+    s3_upload_clear(&s3);
+}
+
+void
+network_free_response(upload_response_t *response)
+{
+    if (response)
+    {
+        free(response->url);
+        free(response->deletion_url);
+        free(response->error_message);
+        free(response->attempts);
+        free(response);
+    }
+}
+
+void
+network_cleanup(void)
+{
+    network_set_resident(false);
+
     if (global_config.proxy_url)
     {
         free(global_config.proxy_url);
@@ -0,0 +1,122 @@
+#include "hostman/network/ratelimit.h"
+#include "hostman/core/utils.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define RATE_LIMIT_BURST_MS 100
+#define RATE_LIMIT_MIN_BURST (16 * 1024)
+#define RATE_LIMIT_QUANTUM 1024
+
+static struct
+{
+    curl_off_t rate;
+    double burst;
+    double tokens;
+    struct timespec last_refill;
+} bucket;
+
+bool
+rate_limit_parse(const char *text, curl_off_t *bytes_per_second)
+{
+    long long bytes = 0;
+    if (!parse_byte_size(text, &bytes))
+    {
+        return false;
+    }
+
+    *bytes_per_second = (curl_off_t)bytes;
+    return true;
+}
+
+void
+rate_limit_set(curl_off_t bytes_per_second)
+{
+    bucket.rate = bytes_per_second > 0 ? bytes_per_second : 0;
+    bucket.burst = (double)bucket.rate * RATE_LIMIT_BURST_MS / 1000.0;
+    if (bucket.burst < RATE_LIMIT_MIN_BURST)
+    {
+        bucket.burst = RATE_LIMIT_MIN_BURST;
+    }
+    bucket.tokens = 0;
+    clock_gettime(CLOCK_MONOTONIC, &bucket.last_refill);
+}
+
+curl_off_t
+rate_limit_get(void)
+{
+    return bucket.rate;
+}
+
+static void
+refill(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double elapsed = (double)(now.tv_sec - bucket.last_refill.tv_sec) +
+                     (double)(now.tv_nsec - bucket.last_refill.tv_nsec) / 1e9;
+    bucket.last_refill = now;
+
+    bucket.tokens += elapsed * (double)bucket.rate;
+    if (bucket.tokens > bucket.burst)
+    {
+        bucket.tokens = bucket.burst;
+    }
+}
+
+/* Grants are never smaller than a quantum (or the whole request), so callers see either
+ * real progress or 0, which means "pause and ask again after rate_limit_wait_ms()" */
+size_t
+rate_limit_acquire(size_t want)
+{
+    if (bucket.rate == 0 || want == 0)
+    {
+        return want;
+    }
+
+    size_t minimum = want < RATE_LIMIT_QUANTUM ? want : RATE_LIMIT_QUANTUM;
+
+    refill();
+    if (bucket.tokens < (double)minimum)
+    {
+        return 0;
+    }
+
+    size_t granted = bucket.tokens < (double)want ? (size_t)bucket.tokens : want;
+    bucket.tokens -= (double)granted;
+
+    return granted;
+}
+
+long
+rate_limit_wait_ms(void)
+{
+    if (bucket.rate == 0)
+    {
+        return 0;
+    }
+
+    refill();
+    if (bucket.tokens >= RATE_LIMIT_QUANTUM)
+    {
+        return 0;
+    }
+
+    long wait = (long)((RATE_LIMIT_QUANTUM - bucket.tokens) * 1000.0 / (double)bucket.rate) + 1;
+    return wait;
+}
+
+void
+rate_limit_refund(size_t unused)
+{
+    if (bucket.rate == 0)
+    {
+        return;
+    }
+
+    bucket.tokens += (double)unused;
+    if (bucket.tokens > bucket.burst)
+    {
+        bucket.tokens = bucket.burst;
+    }
+}
@@ -0,0 +1,148 @@
+#include "hostman/network/response.h"
+#include "hostman/core/logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define RESPONSE_BUFFER_MIN_CAPACITY 4096
+
+void
+response_buffer_init(response_buffer_t *buffer, size_t max_size)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->max_size = max_size;
+}
+
+static bool
+response_buffer_reserve(response_buffer_t *buffer, size_t needed)
+{
+    if (needed < buffer->capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : RESPONSE_BUFFER_MIN_CAPACITY;
+    while (capacity <= needed)
+    {
+        capacity *= 2;
+    }
+    if (buffer->max_size && capacity > buffer->max_size + 1)
+    {
+        capacity = buffer->max_size + 1;
+    }
+
+    char *data = realloc(buffer->data, capacity);
+    if (!data)
+    {
+        log_error("Failed to allocate %zu bytes for response", capacity);
+        return false;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static size_t
+response_buffer_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t real_size = size * nmemb;
+    response_buffer_t *buffer = userp;
+
+    if (buffer->size == 0 && buffer->curl)
+    {
+        curl_off_t length = -1;
+        if (curl_easy_getinfo(buffer->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) ==
+              CURLE_OK &&
+            length > 0 && (!buffer->max_size || (size_t)length <= buffer->max_size))
+        {
+            response_buffer_reserve(buffer, (size_t)length);
+        }
+    }
+
+    if (buffer->max_size && real_size > buffer->max_size - buffer->size)
+    {
+        log_warn("Response exceeded the %zu byte limit, aborting transfer", buffer->max_size);
+        buffer->overflowed = true;
+        return 0;
+    }
+
+    if (!response_buffer_reserve(buffer, buffer->size + real_size))
+    {
+        return 0;
+    }
+
+    memcpy(buffer->data + buffer->size, contents, real_size);
+    buffer->size += real_size;
+    buffer->data[buffer->size] = '\0';
+
+    return real_size;
+}
+
+void
+response_buffer_reset(response_buffer_t *buffer)
+{
+    buffer->size = 0;
+    buffer->overflowed = false;
+    if (buffer->data)
+    {
+        buffer->data[0] = '\0';
+    }
+}
+
+void
+response_buffer_attach(response_buffer_t *buffer, CURL *curl)
+{
+    response_buffer_reset(buffer);
+    buffer->curl = curl;
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, response_buffer_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffer);
+    if (buffer->max_size)
+    {
+        curl_easy_setopt(curl, CURLOPT_MAXFILESIZE_LARGE, (curl_off_t)buffer->max_size);
+    }
+}
+
+bool
+response_buffer_exceeded(const response_buffer_t *buffer, CURLcode res)
+{
+    return buffer->overflowed || res == CURLE_FILESIZE_EXCEEDED;
+}
+
+/* Matches one raw header line from CURLOPT_HEADERFUNCTION; the value is not terminated */
+bool
+response_header_value(const char *line,
+                      size_t length,
+                      const char *name,
+                      const char **value,
+                      size_t *size)
+{
+    size_t name_len = strlen(name);
+    if (length <= name_len || strncasecmp(line, name, name_len) != 0 || line[name_len] != ':')
+    {
+        return false;
+    }
+
+    const char *start = line + name_len + 1;
+    const char *end = line + length;
+    while (start < end && (*start == ' ' || *start == '\t'))
+    {
+        start++;
+    }
+    while (end > start && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' '))
+    {
+        end--;
+    }
+
+    *value = start;
+    *size = (size_t)(end - start);
+    return true;
+}
+
+void
+response_buffer_free(response_buffer_t *buffer)
+{
+    free(buffer->data);
+    response_buffer_init(buffer, buffer->max_size);
+}
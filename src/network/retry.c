@@ -0,0 +1,137 @@
+#include "hostman/network/retry.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned int jitter_seed = 0;
+
+retry_class_t
+retry_classify(CURLcode code, long http_code)
+{
+    if (code != CURLE_OK)
+    {
+        switch (code)
+        {
+            case CURLE_COULDNT_RESOLVE_PROXY:
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_OPERATION_TIMEDOUT:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_HTTP2:
+            case CURLE_HTTP2_STREAM:
+            case CURLE_AGAIN:
+                return RETRY_CLASS_TRANSIENT;
+            default:
+                return RETRY_CLASS_FATAL;
+        }
+    }
+
+    if (http_code >= 200 && http_code < 300)
+    {
+        return RETRY_CLASS_NONE;
+    }
+
+    switch (http_code)
+    {
+        case 429:
+        case 503:
+            return RETRY_CLASS_RATE_LIMITED;
+        case 0:
+        case 408:
+        case 425:
+        case 500:
+        case 502:
+        case 504:
+            return RETRY_CLASS_TRANSIENT;
+        default:
+            return RETRY_CLASS_FATAL;
+    }
+}
+
+bool
+retry_is_retryable(retry_class_t retry_class)
+{
+    return retry_class == RETRY_CLASS_TRANSIENT || retry_class == RETRY_CLASS_RATE_LIMITED;
+}
+
+const char *
+retry_class_name(retry_class_t retry_class)
+{
+    switch (retry_class)
+    {
+        case RETRY_CLASS_NONE:
+            return "none";
+        case RETRY_CLASS_TRANSIENT:
+            return "transient";
+        case RETRY_CLASS_RATE_LIMITED:
+            return "rate-limited";
+        case RETRY_CLASS_FATAL:
+            return "fatal";
+    }
+
+    return "unknown";
+}
+
+static long
+random_below(long bound)
+{
+    if (bound <= 0)
+    {
+        return 0;
+    }
+
+    if (jitter_seed == 0)
+    {
+        jitter_seed = (unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16);
+    }
+
+    return (long)(rand_r(&jitter_seed) % bound);
+}
+
+long
+retry_backoff_ms(const retry_policy_t *policy, int attempt, long retry_after_ms)
+{
+    long max_delay = policy->max_delay_ms > 0 ? policy->max_delay_ms : policy->base_delay_ms;
+
+    /* Retrying before the server's Retry-After only earns another rejection */
+    if (retry_after_ms > 0)
+    {
+        if (retry_after_ms > max_delay)
+        {
+            return -1;
+        }
+        return retry_after_ms + random_below(retry_after_ms / 10 + 1);
+    }
+
+    long delay = policy->base_delay_ms;
+    for (int i = 1; i < attempt && delay < max_delay; i++)
+    {
+        delay *= 2;
+    }
+
+    if (delay > max_delay)
+    {
+        delay = max_delay;
+    }
+
+    return delay / 2 + random_below(delay / 2 + 1);
+}
+
+void
+retry_sleep_ms(long ms)
+{
+    if (ms <= 0)
+    {
+        return;
+    }
+
+    struct timespec delay = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+    {
+    }
+}
@@ -0,0 +1,541 @@
+#define _GNU_SOURCE
+#include "hostman/network/s3.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIGV4_ALGORITHM "AWS4-HMAC-SHA256"
+#define SIGV4_SIGNED_HEADERS "host;x-amz-content-sha256;x-amz-date"
+
+/* Returns the part of file_path below root, or NULL when it is not inside root */
+static const char *
+path_below(const char *file_path, const char *root)
+{
+    size_t root_len = strlen(root);
+    while (root_len > 0 && root[root_len - 1] == '/')
+    {
+        root_len--;
+    }
+
+    if (strncmp(file_path, root, root_len) != 0 || file_path[root_len] != '/')
+    {
+        return NULL;
+    }
+
+    const char *relative = file_path + root_len;
+    while (*relative == '/')
+    {
+        relative++;
+    }
+    return *relative ? relative : NULL;
+}
+
+/* The object key is the file's path below root, or for files outside it the path as given,
+ * relative to the working directory when it lies inside it. "." and ".." segments are resolved
+ * and leading slashes dropped, so the key never points above the bucket (or prefix). */
+char *
+s3_object_key(const char *file_path, const char *root)
+{
+    const char *relative = root ? path_below(file_path, root) : NULL;
+    char *cwd = NULL;
+    if (!relative && file_path[0] == '/' && (cwd = getcwd(NULL, 0)))
+    {
+        relative = path_below(file_path, cwd);
+    }
+
+    char *path = strdup(relative ? relative : file_path);
+    free(cwd);
+    char *key = path ? malloc(strlen(path) + 1) : NULL;
+    if (!key)
+    {
+        free(path);
+        return NULL;
+    }
+
+    size_t length = 0;
+    char *saveptr = NULL;
+    for (char *segment = strtok_r(path, "/", &saveptr); segment;
+         segment = strtok_r(NULL, "/", &saveptr))
+    {
+        if (strcmp(segment, ".") == 0)
+        {
+            continue;
+        }
+        if (strcmp(segment, "..") == 0)
+        {
+            while (length > 0 && key[length - 1] != '/')
+            {
+                length--;
+            }
+            if (length > 0)
+            {
+                length--;
+            }
+            continue;
+        }
+
+        if (length > 0)
+        {
+            key[length++] = '/';
+        }
+        size_t segment_len = strlen(segment);
+        memcpy(key + length, segment, segment_len);
+        length += segment_len;
+    }
+    key[length] = '\0';
+    free(path);
+
+    if (length == 0)
+    {
+        free(key);
+        return NULL;
+    }
+    return key;
+}
+
+/* Places the key under the bucket (and any prefix) in the endpoint. Each key segment is escaped
+ * on its own so the key keeps its slashes. */
+char *
+s3_object_url(const char *endpoint, const char *key)
+{
+    char *segments = strdup(key);
+    if (!segments)
+    {
+        return NULL;
+    }
+
+    size_t endpoint_len = strlen(endpoint);
+    while (endpoint_len > 0 && endpoint[endpoint_len - 1] == '/')
+    {
+        endpoint_len--;
+    }
+
+    /* Escaping grows a byte to at most three */
+    size_t len = endpoint_len + strlen(segments) * 3 + 2;
+    char *url = malloc(len);
+    if (!url)
+    {
+        free(segments);
+        return NULL;
+    }
+
+    size_t offset = (size_t)snprintf(url, len, "%.*s", (int)endpoint_len, endpoint);
+    char *saveptr = NULL;
+    for (char *segment = strtok_r(segments, "/", &saveptr); segment;
+         segment = strtok_r(NULL, "/", &saveptr))
+    {
+        char *escaped = curl_easy_escape(NULL, segment, 0);
+        if (!escaped)
+        {
+            free(segments);
+            free(url);
+            return NULL;
+        }
+        offset += (size_t)snprintf(url + offset, len - offset, "/%s", escaped);
+        curl_free(escaped);
+    }
+    free(segments);
+
+    return url;
+}
+
+/* Keys already claimed in a batch, each with the file that claimed it, in an open-addressed
+ * table kept at most half full */
+struct s3_key_set
+{
+    char **keys;
+    char **paths;
+    size_t capacity;
+    size_t count;
+};
+
+s3_key_set_t *
+s3_key_set_create(void)
+{
+    return calloc(1, sizeof(s3_key_set_t));
+}
+
+void
+s3_key_set_free(s3_key_set_t *set)
+{
+    if (!set)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        free(set->keys[i]);
+        free(set->paths[i]);
+    }
+    free(set->keys);
+    free(set->paths);
+    free(set);
+}
+
+static size_t
+key_slot(char **keys, size_t capacity, const char *key)
+{
+    /* FNV-1a */
+    size_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+    {
+        hash = (hash ^ *p) * 1099511628211ULL;
+    }
+
+    size_t slot = hash & (capacity - 1);
+    while (keys[slot] && strcmp(keys[slot], key) != 0)
+    {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return slot;
+}
+
+static bool
+key_set_grow(s3_key_set_t *set)
+{
+    size_t capacity = set->capacity ? set->capacity * 2 : 64;
+    char **keys = calloc(capacity, sizeof(char *));
+    char **paths = calloc(capacity, sizeof(char *));
+    if (!keys || !paths)
+    {
+        free(keys);
+        free(paths);
+        return false;
+    }
+
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (set->keys[i])
+        {
+            size_t slot = key_slot(keys, capacity, set->keys[i]);
+            keys[slot] = set->keys[i];
+            paths[slot] = set->paths[i];
+        }
+    }
+
+    free(set->keys);
+    free(set->paths);
+    set->keys = keys;
+    set->paths = paths;
+    set->capacity = capacity;
+    return true;
+}
+
+/* Claims key for file_path. Returns the file that claimed it earlier, or NULL if it was free. A
+ * key that cannot be stored is not tracked. */
+const char *
+s3_key_set_claim(s3_key_set_t *set, const char *key, const char *file_path)
+{
+    if ((set->count + 1) * 2 > set->capacity && !key_set_grow(set))
+    {
+        log_warn("Cannot track S3 object keys; duplicate keys will not be detected");
+        return NULL;
+    }
+
+    size_t slot = key_slot(set->keys, set->capacity, key);
+    if (set->keys[slot])
+    {
+        return set->paths[slot];
+    }
+
+    char *key_copy = strdup(key);
+    char *path_copy = strdup(file_path);
+    if (!key_copy || !path_copy)
+    {
+        free(key_copy);
+        free(path_copy);
+        return NULL;
+    }
+
+    set->keys[slot] = key_copy;
+    set->paths[slot] = path_copy;
+    set->count++;
+    return NULL;
+}
+
+bool
+s3_payload_hash(const char *data, size_t length, char *hex_out)
+{
+    content_hash_t *hash = content_hash_create();
+    bool ok = hash && content_hash_update(hash, data, length) && content_hash_final(hash, hex_out);
+    content_hash_free(hash);
+    return ok;
+}
+
+static bool
+hmac_sha256(const unsigned char *key,
+            size_t key_len,
+            const char *data,
+            unsigned char *out,
+            unsigned int *out_len)
+{
+    return HMAC(EVP_sha256(),
+                key,
+                (int)key_len,
+                (const unsigned char *)data,
+                strlen(data),
+                out,
+                out_len) != NULL;
+}
+
+static int
+compare_params(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Parameters are sorted and every one carries a value, so "?uploads" signs as "uploads=" */
+static char *
+canonical_query(const char *query)
+{
+    if (!query || query[0] == '\0')
+    {
+        return strdup("");
+    }
+
+    char *copy = strdup(query);
+    size_t capacity = 1;
+    for (const char *p = query; *p; p++)
+    {
+        capacity += *p == '&';
+    }
+    char **params = calloc(capacity, sizeof(char *));
+    char *result = malloc(strlen(query) + capacity + 1);
+    if (!copy || !params || !result)
+    {
+        free(copy);
+        free(params);
+        free(result);
+        return NULL;
+    }
+
+    size_t count = 0;
+    char *saveptr = NULL;
+    for (char *param = strtok_r(copy, "&", &saveptr); param && count < capacity;
+         param = strtok_r(NULL, "&", &saveptr))
+    {
+        params[count++] = param;
+    }
+    qsort(params, count, sizeof(char *), compare_params);
+
+    char *out = result;
+    for (size_t i = 0; i < count; i++)
+    {
+        bool has_value = strchr(params[i], '=') != NULL;
+        out += sprintf(out, "%s%s%s", i > 0 ? "&" : "", params[i], has_value ? "" : "=");
+    }
+    *out = '\0';
+
+    free(params);
+    free(copy);
+    return result;
+}
+
+static bool
+signature_hex(const host_config_t *host,
+              const char *date,
+              const char *string_to_sign,
+              char *hex_out)
+{
+    size_t secret_len = strlen(host->api_key) + 5;
+    unsigned char *secret = malloc(secret_len);
+    if (!secret)
+    {
+        return false;
+    }
+    snprintf((char *)secret, secret_len, "AWS4%s", host->api_key);
+
+    /* The signing key is derived by chaining HMACs over the credential scope */
+    const char *scope[] = { date, host->region ? host->region : S3_DEFAULT_REGION, "s3",
+                            "aws4_request", string_to_sign };
+    unsigned char keys[2][EVP_MAX_MD_SIZE];
+    unsigned int key_len = 0;
+    bool ok = hmac_sha256(secret, secret_len - 1, scope[0], keys[0], &key_len);
+    for (int i = 1; ok && i < 5; i++)
+    {
+        ok = hmac_sha256(keys[(i - 1) % 2], key_len, scope[i], keys[i % 2], &key_len);
+    }
+    OPENSSL_cleanse(secret, secret_len);
+    free(secret);
+
+    const unsigned char *signature = keys[0];
+    unsigned int signature_len = key_len;
+
+    for (unsigned int i = 0; ok && i < signature_len; i++)
+    {
+        snprintf(hex_out + i * 2, 3, "%02x", signature[i]);
+    }
+    OPENSSL_cleanse(keys, sizeof(keys));
+    return ok;
+}
+
+/* Adds the Host, x-amz-* and Authorization headers of an AWS Signature Version 4 request. The
+ * Host header is sent explicitly so the signed value is exactly the one on the wire. */
+bool
+s3_sign(struct curl_slist **headers,
+        const host_config_t *host,
+        const char *method,
+        const char *url,
+        const char *payload_hash,
+        time_t now)
+{
+    CURLU *parsed = curl_url();
+    char *hostname = NULL;
+    char *port = NULL;
+    char *path = NULL;
+    char *query = NULL;
+
+    if (!parsed || curl_url_set(parsed, CURLUPART_URL, url, 0) != CURLUE_OK ||
+        curl_url_get(parsed, CURLUPART_HOST, &hostname, 0) != CURLUE_OK ||
+        curl_url_get(parsed, CURLUPART_PATH, &path, 0) != CURLUE_OK)
+    {
+        log_error("Cannot sign request for invalid URL: %s", url);
+        curl_free(hostname);
+        curl_free(path);
+        curl_url_cleanup(parsed);
+        return false;
+    }
+    curl_url_get(parsed, CURLUPART_PORT, &port, 0);
+    curl_url_get(parsed, CURLUPART_QUERY, &query, 0);
+
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    char amz_date[32];
+    char date[16];
+    strftime(amz_date, sizeof(amz_date), "%Y%m%dT%H%M%SZ", &tm);
+    strftime(date, sizeof(date), "%Y%m%d", &tm);
+
+    char host_value[512];
+    snprintf(
+      host_value, sizeof(host_value), "%s%s%s", hostname, port ? ":" : "", port ? port : "");
+
+    char *query_string = canonical_query(query);
+    size_t request_len = strlen(method) + strlen(path) + strlen(host_value) +
+                         strlen(payload_hash) * 2 + (query_string ? strlen(query_string) : 0) + 256;
+    char *canonical_request = malloc(request_len);
+    bool ok = query_string && canonical_request;
+    if (ok)
+    {
+        snprintf(canonical_request,
+                 request_len,
+                 "%s\n%s\n%s\nhost:%s\nx-amz-content-sha256:%s\nx-amz-date:%s\n\n%s\n%s",
+                 method,
+                 path,
+                 query_string,
+                 host_value,
+                 payload_hash,
+                 amz_date,
+                 SIGV4_SIGNED_HEADERS,
+                 payload_hash);
+    }
+
+    const char *region = host->region ? host->region : S3_DEFAULT_REGION;
+    char request_hash[CONTENT_HASH_HEX_LEN + 1];
+    char string_to_sign[512];
+    char signature[EVP_MAX_MD_SIZE * 2 + 1];
+    ok = ok && s3_payload_hash(canonical_request, strlen(canonical_request), request_hash);
+    if (ok)
+    {
+        snprintf(string_to_sign,
+                 sizeof(string_to_sign),
+                 SIGV4_ALGORITHM "\n%s\n%s/%s/s3/aws4_request\n%s",
+                 amz_date,
+                 date,
+                 region,
+                 request_hash);
+        ok = signature_hex(host, date, string_to_sign, signature);
+    }
+
+    if (ok)
+    {
+        char header[1024];
+        snprintf(header, sizeof(header), "Host: %s", host_value);
+        *headers = curl_slist_append(*headers, header);
+        snprintf(header, sizeof(header), "x-amz-content-sha256: %s", payload_hash);
+        *headers = curl_slist_append(*headers, header);
+        snprintf(header, sizeof(header), "x-amz-date: %s", amz_date);
+        *headers = curl_slist_append(*headers, header);
+        snprintf(header,
+                 sizeof(header),
+                 "Authorization: " SIGV4_ALGORITHM " Credential=%s/%s/%s/s3/aws4_request, "
+                 "SignedHeaders=" SIGV4_SIGNED_HEADERS ", Signature=%s",
+                 host->api_key_name,
+                 date,
+                 region,
+                 signature);
+        *headers = curl_slist_append(*headers, header);
+    }
+    else
+    {
+        log_error("Failed to sign request for %s", url);
+    }
+
+    free(canonical_request);
+    free(query_string);
+    curl_free(hostname);
+    curl_free(port);
+    curl_free(path);
+    curl_free(query);
+    curl_url_cleanup(parsed);
+
+    return ok;
+}
+
+/* S3 answers with small, flat XML documents, so the first element with the tag is enough */
+char *
+s3_xml_value(const char *xml, size_t length, const char *tag)
+{
+    if (!xml)
+    {
+        return NULL;
+    }
+
+    char open[64];
+    char close[64];
+    snprintf(open, sizeof(open), "<%s>", tag);
+    snprintf(close, sizeof(close), "</%s>", tag);
+
+    const char *end = xml + length;
+    const char *start = memmem(xml, length, open, strlen(open));
+    if (!start)
+    {
+        return NULL;
+    }
+    start += strlen(open);
+
+    const char *stop = memmem(start, (size_t)(end - start), close, strlen(close));
+    return stop ? strndup(start, (size_t)(stop - start)) : NULL;
+}
+
+char *
+s3_complete_body(char **etags, int count)
+{
+    size_t len = 128;
+    for (int i = 0; i < count; i++)
+    {
+        len += strlen(etags[i]) + 80;
+    }
+
+    char *body = malloc(len);
+    if (!body)
+    {
+        return NULL;
+    }
+
+    char *out = body;
+    out += sprintf(out, "<CompleteMultipartUpload>");
+    for (int i = 0; i < count; i++)
+    {
+        out += sprintf(
+          out, "<Part><PartNumber>%d</PartNumber><ETag>%s</ETag></Part>", i + 1, etags[i]);
+    }
+    sprintf(out, "</CompleteMultipartUpload>");
+
+    return body;
+}
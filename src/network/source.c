@@ -0,0 +1,327 @@
+#include "hostman/network/source.h"
+#include "hostman/core/logging.h"
+#include "hostman/crypto/hash.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct upload_source
+{
+    int fd;
+    bool owns_fd;
+    off_t base;
+    curl_off_t size;
+    curl_off_t offset;
+    bool eof;
+    bool positional;
+    const unsigned char *map;
+    size_t map_size;
+    content_hash_t *hash;
+    char digest[CONTENT_HASH_HEX_LEN + 1];
+};
+
+upload_source_mode_t
+upload_source_mode_from_string(const char *mode)
+{
+    if (!mode || mode[0] == '\0' || strcasecmp(mode, "auto") == 0)
+    {
+        return UPLOAD_SOURCE_AUTO;
+    }
+
+    if (strcasecmp(mode, "mmap") == 0)
+    {
+        return UPLOAD_SOURCE_MMAP;
+    }
+
+    if (strcasecmp(mode, "read") == 0)
+    {
+        return UPLOAD_SOURCE_READ;
+    }
+
+    return UPLOAD_SOURCE_UNKNOWN;
+}
+
+static void
+map_file(upload_source_t *source, const char *path)
+{
+    if (source->size <= 0 || (unsigned long long)source->size > SIZE_MAX)
+    {
+        return;
+    }
+
+    void *map = mmap(NULL, (size_t)source->size, PROT_READ, MAP_PRIVATE, source->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        log_warn("Failed to map %s, falling back to pread: %s", path, strerror(errno));
+        return;
+    }
+
+    madvise(map, (size_t)source->size, MADV_SEQUENTIAL);
+    source->map = map;
+    source->map_size = (size_t)source->size;
+}
+
+upload_source_t *
+upload_source_open_file(const char *path, upload_source_mode_t mode)
+{
+    if (!path)
+    {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error("Failed to open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        log_error("Failed to stat %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    upload_source_t *source = calloc(1, sizeof(upload_source_t));
+    if (!source)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    source->fd = fd;
+    source->owns_fd = true;
+    source->hash = content_hash_create();
+    source->size = S_ISREG(file_stat.st_mode) ? (curl_off_t)file_stat.st_size : -1;
+    source->positional = S_ISREG(file_stat.st_mode);
+
+    /* pread measured as fast as mmap for large uploads, so mapping is only done on request */
+    if (mode == UPLOAD_SOURCE_MMAP)
+    {
+        map_file(source, path);
+    }
+
+    return source;
+}
+
+upload_source_t *
+upload_source_open_fd(int fd)
+{
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        log_error("Failed to stat descriptor %d: %s", fd, strerror(errno));
+        return NULL;
+    }
+
+    upload_source_t *source = calloc(1, sizeof(upload_source_t));
+    if (!source)
+    {
+        return NULL;
+    }
+
+    source->fd = fd;
+    source->size = -1;
+    source->hash = content_hash_create();
+
+    if (S_ISREG(file_stat.st_mode))
+    {
+        off_t start = lseek(fd, 0, SEEK_CUR);
+        if (start >= 0 && start <= file_stat.st_size)
+        {
+            source->base = start;
+            source->size = (curl_off_t)(file_stat.st_size - start);
+        }
+    }
+
+    return source;
+}
+
+static void
+source_consumed(upload_source_t *source, const char *buffer, size_t n)
+{
+    source->offset += n;
+    source->eof = n == 0;
+    if (source->hash && n > 0 && !content_hash_update(source->hash, buffer, n))
+    {
+        content_hash_free(source->hash);
+        source->hash = NULL;
+    }
+}
+
+static bool
+mapping_intact(upload_source_t *source)
+{
+    struct stat file_stat;
+    if (fstat(source->fd, &file_stat) == 0 && file_stat.st_size >= (off_t)source->map_size)
+    {
+        return true;
+    }
+
+    /* Touching pages past the new end of a truncated file raises SIGBUS */
+    log_warn("Upload source was truncated while mapped, switching to pread");
+    munmap((void *)source->map, source->map_size);
+    source->map = NULL;
+    source->map_size = 0;
+    return false;
+}
+
+size_t
+upload_source_read(upload_source_t *source, char *buffer, size_t size)
+{
+    if (source->map && mapping_intact(source))
+    {
+        size_t remaining = source->map_size - (size_t)source->offset;
+        size_t n = size < remaining ? size : remaining;
+
+        memcpy(buffer, source->map + source->offset, n);
+        source_consumed(source, buffer, n);
+        return n;
+    }
+
+    while (true)
+    {
+        ssize_t n = source->positional
+                      ? pread(source->fd, buffer, size, source->base + (off_t)source->offset)
+                      : read(source->fd, buffer, size);
+        if (n == 0 && size > 0 && source->size >= 0 && source->offset < source->size)
+        {
+            log_error("Upload source ended %lld bytes early; the file was truncated",
+                      (long long)(source->size - source->offset));
+            return UPLOAD_SOURCE_ERROR;
+        }
+
+        if (n >= 0)
+        {
+            source_consumed(source, buffer, (size_t)n);
+            return (size_t)n;
+        }
+
+        if (errno != EINTR)
+        {
+            log_error("Failed to read upload source: %s", strerror(errno));
+            return UPLOAD_SOURCE_ERROR;
+        }
+    }
+}
+
+bool
+upload_source_rewind(upload_source_t *source)
+{
+    if (source->offset == 0)
+    {
+        return true;
+    }
+
+    if (!source->map && !source->positional &&
+        lseek(source->fd, source->base, SEEK_SET) != source->base)
+    {
+        log_error("Upload source cannot be rewound: %s", strerror(errno));
+        return false;
+    }
+
+    source->offset = 0;
+    source->eof = false;
+    source->digest[0] = '\0';
+
+    if (source->hash && !content_hash_reset(source->hash))
+    {
+        content_hash_free(source->hash);
+        source->hash = NULL;
+    }
+
+    return true;
+}
+
+/* Reading from anywhere but the start leaves the content hash incomplete, so none is reported */
+bool
+upload_source_seek(upload_source_t *source, curl_off_t offset)
+{
+    if (offset == 0)
+    {
+        return upload_source_rewind(source);
+    }
+
+    if (offset == source->offset)
+    {
+        return true;
+    }
+
+    if ((!source->map && !source->positional) || offset < 0 ||
+        (source->size >= 0 && offset > source->size))
+    {
+        log_error("Upload source cannot seek to byte %lld", (long long)offset);
+        return false;
+    }
+
+    source->offset = offset;
+    source->eof = false;
+    source->digest[0] = '\0';
+    content_hash_free(source->hash);
+    source->hash = NULL;
+
+    return true;
+}
+
+curl_off_t
+upload_source_size(const upload_source_t *source)
+{
+    return source->size;
+}
+
+curl_off_t
+upload_source_bytes_read(const upload_source_t *source)
+{
+    return source->offset;
+}
+
+const char *
+upload_source_digest(upload_source_t *source)
+{
+    if (source->digest[0] != '\0')
+    {
+        return source->digest;
+    }
+
+    bool complete = source->eof || (source->size >= 0 && source->offset == source->size);
+    if (!source->hash || !complete)
+    {
+        return NULL;
+    }
+
+    if (!content_hash_final(source->hash, source->digest))
+    {
+        source->digest[0] = '\0';
+        return NULL;
+    }
+
+    return source->digest;
+}
+
+void
+upload_source_close(upload_source_t *source)
+{
+    if (!source)
+    {
+        return;
+    }
+
+    if (source->map)
+    {
+        munmap((void *)source->map, source->map_size);
+    }
+    if (source->owns_fd)
+    {
+        close(source->fd);
+    }
+    content_hash_free(source->hash);
+    free(source);
+}
@@ -0,0 +1,121 @@
+#include "hostman/network/timing.h"
+#include <stdio.h>
+#include <string.h>
+
+static long long
+phase_delta(curl_off_t end, curl_off_t start)
+{
+    return end > start ? (long long)(end - start) : 0;
+}
+
+void
+transfer_timing_capture(CURL *curl, long long since_first_byte_us, transfer_timing_t *timing)
+{
+    memset(timing, 0, sizeof(*timing));
+
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0;
+    curl_off_t pretransfer = 0, starttransfer = 0, total = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total) != CURLE_OK)
+    {
+        return;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+
+    /* For uploads STARTTRANSFER marks the first byte sent, not received; when
+     * the caller saw the response arrive, place it on curl's clock by
+     * counting back from the end of the transfer */
+    if (since_first_byte_us >= 0 && since_first_byte_us <= total)
+    {
+        starttransfer = total - since_first_byte_us;
+    }
+
+    /* curl reports cumulative offsets from the start of the transfer; a reused
+     * connection reports zero for the lookup, connect and handshake stages */
+    curl_off_t connected = appconnect > connect ? appconnect : connect;
+    timing->phase_us[TIMING_PHASE_DNS] = namelookup;
+    timing->phase_us[TIMING_PHASE_CONNECT] = phase_delta(connect, namelookup);
+    timing->phase_us[TIMING_PHASE_TLS] = appconnect > 0 ? phase_delta(appconnect, connect) : 0;
+    timing->phase_us[TIMING_PHASE_PRETRANSFER] = phase_delta(pretransfer, connected);
+    timing->phase_us[TIMING_PHASE_TTFB] = phase_delta(starttransfer, pretransfer);
+    timing->phase_us[TIMING_PHASE_TOTAL] = total;
+
+    curl_off_t speed = 0;
+    curl_easy_getinfo(curl, CURLINFO_SPEED_UPLOAD_T, &speed);
+    timing->upload_speed = speed;
+
+    long version = 0;
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+    const char *version_name;
+    switch (version)
+    {
+        case CURL_HTTP_VERSION_1_0:
+            version_name = "1.0";
+            break;
+        case CURL_HTTP_VERSION_1_1:
+            version_name = "1.1";
+            break;
+        case CURL_HTTP_VERSION_2_0:
+            version_name = "2";
+            break;
+        case CURL_HTTP_VERSION_3:
+            version_name = "3";
+            break;
+        default:
+            version_name = "";
+            break;
+    }
+    snprintf(timing->http_version, sizeof(timing->http_version), "%s", version_name);
+
+    char *ip = NULL;
+    curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &ip);
+    snprintf(timing->remote_ip, sizeof(timing->remote_ip), "%s", ip ? ip : "");
+
+    timing->valid = true;
+}
+
+const char *
+timing_phase_name(timing_phase_t phase)
+{
+    switch (phase)
+    {
+        case TIMING_PHASE_DNS:
+            return "DNS lookup";
+        case TIMING_PHASE_CONNECT:
+            return "TCP connect";
+        case TIMING_PHASE_TLS:
+            return "TLS handshake";
+        case TIMING_PHASE_PRETRANSFER:
+            return "Pre-transfer";
+        case TIMING_PHASE_TTFB:
+            return "First byte";
+        case TIMING_PHASE_TOTAL:
+            return "Total";
+        case TIMING_PHASE_COUNT:
+            break;
+    }
+
+    return "unknown";
+}
+
+long long
+timing_percentile(const long long *sorted, int count, int percent)
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    /* Nearest-rank: the smallest sample with at least percent% of samples at or below it */
+    int rank = (int)(((long long)percent * count + 99) / 100);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+
+    return sorted[rank - 1];
+}
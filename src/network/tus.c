@@ -0,0 +1,102 @@
+#include "hostman/network/tus.h"
+#include "hostman/core/logging.h"
+#include "hostman/core/utils.h"
+#include "hostman/network/response.h"
+#include <openssl/evp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *
+encode_metadata_value(const char *value)
+{
+    size_t len = strlen(value);
+    char *encoded = malloc(4 * ((len + 2) / 3) + 1);
+    if (encoded)
+    {
+        EVP_EncodeBlock((unsigned char *)encoded, (const unsigned char *)value, (int)len);
+    }
+    return encoded;
+}
+
+struct curl_slist *
+tus_append_metadata(struct curl_slist *headers, const char *file_path, const char *content_type)
+{
+    char *filename = get_filename_from_path(file_path);
+    char *encoded_name = encode_metadata_value(filename ? filename : file_path);
+    char *encoded_type = encode_metadata_value(content_type);
+    free(filename);
+
+    if (encoded_name && encoded_type)
+    {
+        size_t len = strlen(encoded_name) + strlen(encoded_type) + 64;
+        char *header = malloc(len);
+        if (header)
+        {
+            snprintf(header,
+                     len,
+                     "Upload-Metadata: filename %s,filetype %s",
+                     encoded_name,
+                     encoded_type);
+            headers = curl_slist_append(headers, header);
+            free(header);
+        }
+    }
+
+    free(encoded_name);
+    free(encoded_type);
+    return headers;
+}
+
+/* Called for every response header line; only Location and Upload-Offset are of interest */
+void
+tus_parse_header(const char *line, size_t length, char **location, curl_off_t *offset)
+{
+    const char *value;
+    size_t size;
+
+    if (response_header_value(line, length, "Location", &value, &size))
+    {
+        free(*location);
+        *location = strndup(value, size);
+    }
+    else if (response_header_value(line, length, "Upload-Offset", &value, &size) && size > 0 &&
+             size < 32)
+    {
+        char digits[32];
+        memcpy(digits, value, size);
+        digits[size] = '\0';
+
+        char *end = NULL;
+        long long parsed = strtoll(digits, &end, 10);
+        if (end && *end == '\0' && parsed >= 0)
+        {
+            *offset = (curl_off_t)parsed;
+        }
+    }
+}
+
+/* Servers may answer with a path relative to the creation endpoint */
+char *
+tus_resolve_url(const char *endpoint, const char *location)
+{
+    CURLU *url = curl_url();
+    if (!url)
+    {
+        return NULL;
+    }
+
+    char *resolved = NULL;
+    if (curl_url_set(url, CURLUPART_URL, endpoint, 0) != CURLUE_OK ||
+        curl_url_set(url, CURLUPART_URL, location, 0) != CURLUE_OK ||
+        curl_url_get(url, CURLUPART_URL, &resolved, 0) != CURLUE_OK)
+    {
+        log_error("Invalid tus upload location: %s", location);
+        resolved = NULL;
+    }
+    curl_url_cleanup(url);
+
+    char *copy = resolved ? strdup(resolved) : NULL;
+    curl_free(resolved);
+    return copy;
+}
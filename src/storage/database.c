@@ -1,16 +1,67 @@
 #include "hostman/storage/database.h"
+#include "hostman/core/config.h"
 #include "hostman/core/logging.h"
 #include "hostman/core/utils.h"
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 static sqlite3 *db = NULL;
-static bool has_deletion_url_column = false;
+
+/* The batch being journaled */
+static int journal_batch_id = 0;
+
+/* Whether writes are being grouped, and the grouped writes not yet committed */
+static bool batch_writes = false;
+static int batch_uncommitted = 0;
+static long long batch_opened_ms = 0;
+
+/* Batched writes that found the write lock taken, as SQL with their values inlined, in order */
+static char **deferred_writes = NULL;
+static int deferred_count = 0;
+static int deferred_capacity = 0;
+
+/* Set while the busy handler should give up after DB_BATCH_BUSY_TIMEOUT_MS */
+static bool busy_short = false;
+
+/* Statements run once per file are prepared on first use and kept until the database closes */
+typedef enum
+{
+    STMT_INSERT_UPLOAD,
+    STMT_SELECT_UPLOADS,
+    STMT_SELECT_HOST_UPLOADS,
+    STMT_SELECT_UPLOADS_AFTER,
+    STMT_SELECT_HOST_UPLOADS_AFTER,
+    STMT_SELECT_UPLOAD,
+    STMT_FIND_BY_HASH,
+    STMT_DELETE_UPLOAD,
+    STMT_QUEUE_ADD,
+    STMT_QUEUE_DEFER,
+    STMT_QUEUE_REMOVE,
+    STMT_JOURNAL_ADD,
+    STMT_JOURNAL_SET,
+    STMT_JOURNAL_LOOKUP,
+    STMT_TUS_FIND,
+    STMT_TUS_SAVE,
+    STMT_TUS_REMOVE,
+    STMT_COUNT
+} statement_id_t;
+
+static sqlite3_stmt *statements[STMT_COUNT];
+
+static const char *journal_state_names[] = { "pending", "in_flight", "done", "failed" };
+
+static const char *timing_columns[TIMING_PHASE_COUNT] = {
+    "time_dns_us",         "time_connect_us", "time_tls_us",
+    "time_pretransfer_us", "time_ttfb_us",    "time_total_us",
+};
 
 static char *
 db_get_path(void)
@@ -35,8 +86,271 @@ db_get_path(void)
     return path;
 }
 
+static sqlite3_stmt *
+cached_statement(statement_id_t id, const char *sql)
+{
+    if (!statements[id] &&
+        sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &statements[id], NULL) !=
+          SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        statements[id] = NULL;
+    }
+
+    return statements[id];
+}
+
+/* Resetting releases the statement's locks; its error, if any, stays readable via errmsg */
+static void
+release_statement(sqlite3_stmt *stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+static long long
+monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static bool
+defer_write(sqlite3_stmt *stmt)
+{
+    if (deferred_count == deferred_capacity)
+    {
+        int capacity = deferred_capacity ? deferred_capacity * 2 : 16;
+        char **grown = realloc(deferred_writes, (size_t)capacity * sizeof(char *));
+        if (!grown)
+        {
+            return false;
+        }
+        deferred_writes = grown;
+        deferred_capacity = capacity;
+    }
+
+    char *sql = sqlite3_expanded_sql(stmt);
+    if (!sql)
+    {
+        return false;
+    }
+
+    deferred_writes[deferred_count++] = sql;
+    return true;
+}
+
+static void
+discard_deferred_writes(void)
+{
+    for (int i = 0; i < deferred_count; i++)
+    {
+        sqlite3_free(deferred_writes[i]);
+    }
+    free(deferred_writes);
+    deferred_writes = NULL;
+    deferred_count = 0;
+    deferred_capacity = 0;
+}
+
+/* Opens the batch transaction and replays any deferred writes into it. Taking the write lock up
+ * front lets the busy handler wait for it; a deferred transaction upgraded from a read could
+ * fail at once. Without wait, a held lock is given up on quickly and SQLITE_BUSY returned. */
+static int
+open_batch_transaction(bool wait)
+{
+    busy_short = !wait;
+    int result = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+    busy_short = false;
+    if (result != SQLITE_OK)
+    {
+        return result;
+    }
+
+    batch_uncommitted = 0;
+    batch_opened_ms = monotonic_ms();
+
+    for (int i = 0; i < deferred_count; i++)
+    {
+        if (sqlite3_exec(db, deferred_writes[i], NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log_warn("Failed to replay deferred history write: %s", sqlite3_errmsg(db));
+        }
+        batch_uncommitted++;
+    }
+    discard_deferred_writes();
+
+    return SQLITE_OK;
+}
+
+/* With wait, gives up and drops deferred writes only after the full busy timeout */
+static bool
+flush_deferred_writes(bool wait)
+{
+    if (deferred_count > 0 && sqlite3_get_autocommit(db))
+    {
+        open_batch_transaction(wait);
+    }
+
+    if (wait && deferred_count > 0)
+    {
+        log_error("Dropped %d history writes: %s", deferred_count, sqlite3_errmsg(db));
+        discard_deferred_writes();
+        return false;
+    }
+
+    return deferred_count == 0;
+}
+
+/* While batching, writes share one transaction committed every DB_BATCH_COMMIT_ROWS writes or
+ * DB_BATCH_COMMIT_MS, so a batch costs one sync per commit instead of one per file. A write
+ * that finds the lock held by another process is deferred to a later tick rather than stalling
+ * the transfers the batch is driving. */
+static int
+write_step(sqlite3_stmt *stmt)
+{
+    if (batch_writes && sqlite3_get_autocommit(db))
+    {
+        int opened = open_batch_transaction(false);
+        if (opened == SQLITE_BUSY && defer_write(stmt))
+        {
+            release_statement(stmt);
+            return SQLITE_DONE;
+        }
+        if (opened == SQLITE_BUSY)
+        {
+            opened = open_batch_transaction(true);
+        }
+        if (opened != SQLITE_OK)
+        {
+            release_statement(stmt);
+            return SQLITE_ERROR;
+        }
+    }
+
+    int result = sqlite3_step(stmt);
+    release_statement(stmt);
+
+    if (result == SQLITE_DONE && batch_writes && !sqlite3_get_autocommit(db))
+    {
+        batch_uncommitted++;
+        if ((batch_uncommitted >= DB_BATCH_COMMIT_ROWS ||
+             monotonic_ms() - batch_opened_ms >= DB_BATCH_COMMIT_MS) &&
+            !db_batch_sync())
+        {
+            return SQLITE_ERROR;
+        }
+    }
+
+    return result;
+}
+
+/* Waits with jittered exponential backoff while another process holds the write lock */
+static int
+busy_backoff(void *userdata, int attempts)
+{
+    static long long waited_ms = 0;
+    static unsigned int seed = 0;
+    (void)userdata;
+
+    if (attempts == 0)
+    {
+        waited_ms = 0;
+    }
+    if (waited_ms >= (busy_short ? DB_BATCH_BUSY_TIMEOUT_MS : DB_BUSY_TIMEOUT_MS))
+    {
+        if (busy_short)
+        {
+            return 0;
+        }
+        log_warn("History database still locked after %lld ms", waited_ms);
+        return 0;
+    }
+    if (seed == 0)
+    {
+        seed = (unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16);
+    }
+
+    long long delay_ms = DB_BUSY_MIN_DELAY_MS << (attempts < 7 ? attempts : 7);
+    if (delay_ms > DB_BUSY_MAX_DELAY_MS)
+    {
+        delay_ms = DB_BUSY_MAX_DELAY_MS;
+    }
+    delay_ms = delay_ms / 2 + rand_r(&seed) % (delay_ms / 2 + 1);
+
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = delay_ms * 1000000L };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+    {
+    }
+    waited_ms += delay_ms;
+    return 1;
+}
+
+static long long
+configured_size(const char *key, const char *value, long long fallback)
+{
+    long long bytes = 0;
+    if (!value)
+    {
+        return fallback;
+    }
+    if (strcmp(value, "0") == 0)
+    {
+        return 0;
+    }
+    if (!parse_byte_size(value, &bytes))
+    {
+        log_warn("Ignoring invalid %s '%s'", key, value);
+        return fallback;
+    }
+    return bytes;
+}
+
+/* WAL lets readers such as list-uploads run alongside a writer, and with synchronous=NORMAL a
+ * commit only syncs at checkpoints */
+static void
+configure_connection(void)
+{
+    sqlite3_busy_handler(db, busy_backoff, NULL);
+
+    sqlite3_stmt *stmt;
+    const char *mode = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode = WAL;", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            mode = (const char *)sqlite3_column_text(stmt, 0);
+        }
+        if (!mode || strcmp(mode, "wal") != 0)
+        {
+            log_warn("History database is not in WAL mode (%s); concurrent writers may wait",
+                     mode ? mode : sqlite3_errmsg(db));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    hostman_config_t *config = config_load();
+    long long mmap_size = configured_size(
+      "db_mmap_size", config ? config->db_mmap_size : NULL, DB_DEFAULT_MMAP_SIZE);
+    long long cache_size = configured_size(
+      "db_cache_size", config ? config->db_cache_size : NULL, DB_DEFAULT_CACHE_SIZE);
+
+    /* A negative cache_size is in KiB rather than pages */
+    char sql[160];
+    snprintf(sql,
+             sizeof(sql),
+             "PRAGMA synchronous = NORMAL; PRAGMA mmap_size = %lld; PRAGMA cache_size = -%lld;",
+             mmap_size,
+             cache_size / 1024);
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_warn("Failed to tune history database: %s", sqlite3_errmsg(db));
+    }
+}
+
 static bool
-check_deletion_url_column()
+ensure_column(const char *name, const char *definition)
 {
     if (!db)
         return false;
@@ -55,7 +369,7 @@ check_deletion_url_column()
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
         const char *column_name = (const char *)sqlite3_column_text(stmt, 1);
-        if (column_name && strcmp(column_name, "deletion_url") == 0)
+        if (column_name && strcmp(column_name, name) == 0)
         {
             found = true;
             break;
@@ -66,21 +380,197 @@ check_deletion_url_column()
 
     if (!found)
     {
-        log_info("Deletion URL column not found in database schema");
-        const char *alter_sql = "ALTER TABLE uploads ADD COLUMN deletion_url TEXT;";
+        log_info("Column %s not found in database schema", name);
+
+        char alter_sql[256];
+        snprintf(alter_sql, sizeof(alter_sql), "ALTER TABLE uploads ADD COLUMN %s;", definition);
         result = sqlite3_exec(db, alter_sql, NULL, NULL, NULL);
         if (result != SQLITE_OK)
         {
-            log_warn("Failed to add deletion_url column: %s", sqlite3_errmsg(db));
+            log_warn("Failed to add %s column: %s", name, sqlite3_errmsg(db));
             return false;
         }
-        log_info("Added deletion_url column to database schema");
+        log_info("Added %s column to database schema", name);
         found = true;
     }
 
     return found;
 }
 
+/* Databases from before schema versioning may already have any of these tables and columns,
+ * so this first migration is the only one that probes the schema */
+static bool
+migrate_unversioned(void)
+{
+    const char *sql = "CREATE TABLE IF NOT EXISTS uploads ("
+                      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                      "timestamp INTEGER NOT NULL,"
+                      "host_name TEXT NOT NULL,"
+                      "local_path TEXT NOT NULL,"
+                      "remote_url TEXT UNIQUE NOT NULL,"
+                      "filename TEXT NOT NULL,"
+                      "size INTEGER NOT NULL"
+                      ");"
+                      "CREATE TABLE IF NOT EXISTS queue ("
+                      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                      "local_path TEXT NOT NULL,"
+                      "host_name TEXT NOT NULL,"
+                      "size INTEGER NOT NULL,"
+                      "attempts INTEGER NOT NULL DEFAULT 1,"
+                      "next_attempt INTEGER NOT NULL,"
+                      "last_error TEXT,"
+                      "queued_at INTEGER NOT NULL,"
+                      "UNIQUE(local_path, host_name)"
+                      ");"
+                      "CREATE TABLE IF NOT EXISTS batches ("
+                      "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+                      "host_name TEXT NOT NULL,"
+                      "created_at INTEGER NOT NULL"
+                      ");"
+                      "CREATE TABLE IF NOT EXISTS batch_files ("
+                      "batch_id INTEGER NOT NULL,"
+                      "local_path TEXT NOT NULL,"
+                      "state TEXT NOT NULL,"
+                      "remote_url TEXT,"
+                      "error TEXT,"
+                      "updated_at INTEGER NOT NULL,"
+                      "PRIMARY KEY (batch_id, local_path)"
+                      ");"
+                      "CREATE TABLE IF NOT EXISTS tus_uploads ("
+                      "local_path TEXT NOT NULL,"
+                      "host_name TEXT NOT NULL,"
+                      "size INTEGER NOT NULL,"
+                      "mtime INTEGER NOT NULL,"
+                      "upload_url TEXT NOT NULL,"
+                      "offset INTEGER NOT NULL DEFAULT 0,"
+                      "updated_at INTEGER NOT NULL,"
+                      "PRIMARY KEY (local_path, host_name)"
+                      ");";
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to create tables: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    bool ok = ensure_column("deletion_url", "deletion_url TEXT") &&
+              ensure_column("content_hash", "content_hash TEXT");
+
+    char definition[64];
+    for (int i = 0; ok && i < TIMING_PHASE_COUNT; i++)
+    {
+        snprintf(definition, sizeof(definition), "%s INTEGER", timing_columns[i]);
+        ok = ensure_column(timing_columns[i], definition);
+    }
+
+    ok = ok && ensure_column("upload_speed", "upload_speed INTEGER") &&
+         ensure_column("http_version", "http_version TEXT") &&
+         ensure_column("remote_ip", "remote_ip TEXT");
+
+    sql = "CREATE INDEX IF NOT EXISTS idx_uploads_content_hash "
+          "ON uploads(content_hash, host_name);";
+    if (ok && sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to create content hash index: %s", sqlite3_errmsg(db));
+        ok = false;
+    }
+
+    return ok;
+}
+
+/* Migration i brings the schema to version i + 1, recorded in PRAGMA user_version. Each runs
+ * either its function or its SQL, and new ones are only ever appended. */
+typedef struct
+{
+    bool (*apply)(void);
+    const char *sql;
+} migration_t;
+
+static const migration_t migrations[] = {
+    { migrate_unversioned, NULL },
+    /* Lets list-uploads seek to its (timestamp, id) cursor in order; the listed columns are
+     * still read from the table */
+    { NULL,
+      "CREATE INDEX IF NOT EXISTS idx_uploads_host_cursor "
+      "ON uploads(host_name, timestamp DESC, id DESC);"
+      "CREATE INDEX IF NOT EXISTS idx_uploads_cursor ON uploads(timestamp DESC, id DESC);" },
+};
+
+#define SCHEMA_VERSION ((int)(sizeof(migrations) / sizeof(migrations[0])))
+
+static int
+schema_version(void)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to read schema version: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    int version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+
+    return version;
+}
+
+static bool
+migrate(void)
+{
+    int version = schema_version();
+    if (version < 0)
+    {
+        return false;
+    }
+    if (version >= SCHEMA_VERSION)
+    {
+        if (version > SCHEMA_VERSION)
+        {
+            log_warn("History database schema version %d is newer than this release (%d)",
+                     version,
+                     SCHEMA_VERSION);
+        }
+        return true;
+    }
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to lock database for migration: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    /* Another process may have migrated the schema while this one waited for the lock */
+    int from = schema_version();
+    bool ok = from >= 0;
+    for (int i = from; ok && i < SCHEMA_VERSION; i++)
+    {
+        if (migrations[i].apply)
+        {
+            ok = migrations[i].apply();
+        }
+        else if (sqlite3_exec(db, migrations[i].sql, NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log_error("Failed to migrate schema: %s", sqlite3_errmsg(db));
+            ok = false;
+        }
+    }
+
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", SCHEMA_VERSION);
+    if (!ok || (from < SCHEMA_VERSION && sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) ||
+        sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to migrate history database to schema version %d", SCHEMA_VERSION);
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return false;
+    }
+
+    if (from < SCHEMA_VERSION)
+    {
+        log_info("Migrated history database from schema version %d to %d", from, SCHEMA_VERSION);
+    }
+    return true;
+}
+
 bool
 db_init(void)
 {
@@ -105,7 +595,7 @@ db_init(void)
 
     if (access(cache_dir, F_OK) != 0)
     {
-        if (mkdir(cache_dir, 0755) != 0)
+        if (mkdir(cache_dir, 0700) != 0)
         {
             log_error("Failed to create cache directory: %s", cache_dir);
             free(cache_dir);
@@ -126,30 +616,15 @@ db_init(void)
     }
 
     free(db_path);
+    configure_connection();
 
-    const char *create_table_sql = "CREATE TABLE IF NOT EXISTS uploads ("
-                                   "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                                   "timestamp INTEGER NOT NULL,"
-                                   "host_name TEXT NOT NULL,"
-                                   "local_path TEXT NOT NULL,"
-                                   "remote_url TEXT UNIQUE NOT NULL,"
-                                   "filename TEXT NOT NULL,"
-                                   "size INTEGER NOT NULL"
-                                   ");";
-
-    char *error_msg = NULL;
-    result = sqlite3_exec(db, create_table_sql, NULL, NULL, &error_msg);
-    if (result != SQLITE_OK)
+    if (!migrate())
     {
-        log_error("Failed to create table: %s", error_msg);
-        sqlite3_free(error_msg);
         sqlite3_close(db);
         db = NULL;
         return false;
     }
 
-    has_deletion_url_column = check_deletion_url_column();
-
     return true;
 }
 
@@ -159,7 +634,9 @@ db_add_upload(const char *host_name,
               const char *remote_url,
               const char *deletion_url,
               const char *filename,
-              size_t size)
+              size_t size,
+              const char *content_hash,
+              const transfer_timing_t *timing)
 {
     if (!db && !db_init())
     {
@@ -167,14 +644,14 @@ db_add_upload(const char *host_name,
     }
 
     const char *sql = "INSERT INTO uploads (timestamp, host_name, local_path, remote_url, "
-                      "deletion_url, filename, size) "
-                      "VALUES (?, ?, ?, ?, ?, ?, ?);";
+                      "deletion_url, filename, size, content_hash, time_dns_us, time_connect_us, "
+                      "time_tls_us, time_pretransfer_us, time_ttfb_us, time_total_us, "
+                      "upload_speed, http_version, remote_ip) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
 
-    sqlite3_stmt *stmt;
-    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (result != SQLITE_OK)
+    sqlite3_stmt *stmt = cached_statement(STMT_INSERT_UPLOAD, sql);
+    if (!stmt)
     {
-        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
         return false;
     }
 
@@ -187,10 +664,25 @@ db_add_upload(const char *host_name,
     sqlite3_bind_text(stmt, 5, deletion_url, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 6, filename, -1, SQLITE_STATIC);
     sqlite3_bind_int64(stmt, 7, size);
+    if (content_hash && content_hash[0] != '\0')
+    {
+        sqlite3_bind_text(stmt, 8, content_hash, -1, SQLITE_STATIC);
+    }
 
-    result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    /* Unbound parameters are NULL, so uploads without timing data leave those columns empty */
+    if (timing && timing->valid)
+    {
+        int param = 9;
+        for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+        {
+            sqlite3_bind_int64(stmt, param++, timing->phase_us[i]);
+        }
+        sqlite3_bind_int64(stmt, param++, timing->upload_speed);
+        sqlite3_bind_text(stmt, param++, timing->http_version, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, param, timing->remote_ip, -1, SQLITE_STATIC);
+    }
 
+    int result = write_step(stmt);
     if (result != SQLITE_DONE)
     {
         if (result == SQLITE_CONSTRAINT)
@@ -209,74 +701,40 @@ db_add_upload(const char *host_name,
     return true;
 }
 
-upload_record_t **
-db_get_uploads(const char *host_name, int page, int limit, int *count)
-{
-    *count = 0;
+#define UPLOAD_COLUMNS                                                                             \
+    "id, timestamp, host_name, local_path, remote_url, deletion_url, filename, size"
 
-    if (!db && !db_init())
+static upload_record_t *
+read_record(sqlite3_stmt *stmt)
+{
+    upload_record_t *record = calloc(1, sizeof(upload_record_t));
+    if (!record)
     {
         return NULL;
     }
 
-    const char *sql;
-    sqlite3_stmt *stmt;
-    int result;
-
-    if (host_name)
-    {
-        if (has_deletion_url_column)
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, deletion_url, "
-                  "filename, size "
-                  "FROM uploads WHERE host_name = ? "
-                  "ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
-        else
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, filename, size "
-                  "FROM uploads WHERE host_name = ? "
-                  "ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
-
-        result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (result != SQLITE_OK)
-        {
-            log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
-            return NULL;
-        }
-
-        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 2, limit);
-        sqlite3_bind_int(stmt, 3, (page - 1) * limit);
-    }
-    else
-    {
-        if (has_deletion_url_column)
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, deletion_url, "
-                  "filename, size "
-                  "FROM uploads ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
-        else
-        {
-            sql = "SELECT id, timestamp, host_name, local_path, remote_url, filename, size "
-                  "FROM uploads ORDER BY timestamp DESC LIMIT ? OFFSET ?;";
-        }
+    const unsigned char *deletion_url_text = sqlite3_column_text(stmt, 5);
 
-        result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-        if (result != SQLITE_OK)
-        {
-            log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
-            return NULL;
-        }
+    record->id = sqlite3_column_int(stmt, 0);
+    record->timestamp = sqlite3_column_int64(stmt, 1);
+    record->host_name = strdup((const char *)sqlite3_column_text(stmt, 2));
+    record->local_path = strdup((const char *)sqlite3_column_text(stmt, 3));
+    record->remote_url = strdup((const char *)sqlite3_column_text(stmt, 4));
+    record->deletion_url = deletion_url_text ? strdup((const char *)deletion_url_text) : NULL;
+    record->filename = strdup((const char *)sqlite3_column_text(stmt, 6));
+    record->size = sqlite3_column_int64(stmt, 7);
 
-        sqlite3_bind_int(stmt, 1, limit);
-        sqlite3_bind_int(stmt, 2, (page - 1) * limit);
-    }
+    return record;
+}
 
+/* Steps a bound statement selecting UPLOAD_COLUMNS. An empty result is an empty array rather
+ * than NULL, which is kept for errors. */
+static upload_record_t **
+collect_records(sqlite3_stmt *stmt, int *count)
+{
     upload_record_t **records = NULL;
     int capacity = 0;
+    int result;
 
     while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
     {
@@ -287,90 +745,252 @@ db_get_uploads(const char *host_name, int page, int limit, int *count)
             if (!new_records)
             {
                 log_error("Failed to allocate memory for upload records");
-                for (int i = 0; i < *count; i++)
-                {
-                    free(records[i]->host_name);
-                    free(records[i]->local_path);
-                    free(records[i]->remote_url);
-                    if (records[i]->deletion_url)
-                        free(records[i]->deletion_url);
-                    free(records[i]->filename);
-                    free(records[i]);
-                }
-                free(records);
-                sqlite3_finalize(stmt);
-                return NULL;
+                result = SQLITE_NOMEM;
+                break;
             }
             records = new_records;
         }
 
-        upload_record_t *record = malloc(sizeof(upload_record_t));
+        upload_record_t *record = read_record(stmt);
         if (!record)
         {
             log_error("Failed to allocate memory for upload record");
-            for (int i = 0; i < *count; i++)
-            {
-                free(records[i]->host_name);
-                free(records[i]->local_path);
-                free(records[i]->remote_url);
-                if (records[i]->deletion_url)
-                    free(records[i]->deletion_url);
-                free(records[i]->filename);
-                free(records[i]);
-            }
-            free(records);
-            sqlite3_finalize(stmt);
-            return NULL;
+            result = SQLITE_NOMEM;
+            break;
         }
+        records[(*count)++] = record;
+    }
 
-        int col_offset = 0;
-        record->id = sqlite3_column_int(stmt, 0);
-        record->timestamp = sqlite3_column_int64(stmt, 1);
-        record->host_name = strdup((const char *)sqlite3_column_text(stmt, 2));
-        record->local_path = strdup((const char *)sqlite3_column_text(stmt, 3));
-        record->remote_url = strdup((const char *)sqlite3_column_text(stmt, 4));
+    if (result == SQLITE_DONE && !records)
+    {
+        records = calloc(1, sizeof(upload_record_t *));
+        result = records ? SQLITE_DONE : SQLITE_NOMEM;
+    }
 
-        if (has_deletion_url_column)
+    if (result != SQLITE_DONE)
+    {
+        if (result != SQLITE_NOMEM)
         {
-            const unsigned char *deletion_url_text = sqlite3_column_text(stmt, 5);
-            record->deletion_url =
-              deletion_url_text ? strdup((const char *)deletion_url_text) : NULL;
-            col_offset = 1;
+            log_error("Error retrieving uploads: %s", sqlite3_errmsg(db));
         }
-        else
+        db_free_records(records, *count);
+        records = NULL;
+        *count = 0;
+    }
+
+    release_statement(stmt);
+    return records;
+}
+
+upload_record_t **
+db_get_uploads(const char *host_name, int page, int limit, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    sqlite3_stmt *stmt;
+
+    if (host_name)
+    {
+        stmt = cached_statement(STMT_SELECT_HOST_UPLOADS,
+                                "SELECT " UPLOAD_COLUMNS " FROM uploads WHERE host_name = ? "
+                                "ORDER BY timestamp DESC, id DESC LIMIT ? OFFSET ?;");
+        if (!stmt)
         {
-            record->deletion_url = NULL;
+            return NULL;
         }
 
-        record->filename = strdup((const char *)sqlite3_column_text(stmt, 5 + col_offset));
-        record->size = sqlite3_column_int64(stmt, 6 + col_offset);
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, limit);
+        sqlite3_bind_int(stmt, 3, (page - 1) * limit);
+    }
+    else
+    {
+        stmt = cached_statement(STMT_SELECT_UPLOADS,
+                                "SELECT " UPLOAD_COLUMNS " FROM uploads "
+                                "ORDER BY timestamp DESC, id DESC LIMIT ? OFFSET ?;");
+        if (!stmt)
+        {
+            return NULL;
+        }
 
-        records[*count] = record;
-        (*count)++;
+        sqlite3_bind_int(stmt, 1, limit);
+        sqlite3_bind_int(stmt, 2, (page - 1) * limit);
     }
 
-    sqlite3_finalize(stmt);
+    return collect_records(stmt, count);
+}
 
-    if (result != SQLITE_DONE)
+/* Each page seeks the (timestamp, id) indexes to the cursor, so deep pages cost as much as the
+ * first, and rows inserted meanwhile do not shift what a later page returns */
+upload_record_t **
+db_get_uploads_after(const char *host_name,
+                     time_t before_ts,
+                     int before_id,
+                     int limit,
+                     int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
     {
-        log_error("Error retrieving uploads: %s", sqlite3_errmsg(db));
-        for (int i = 0; i < *count; i++)
+        return NULL;
+    }
+
+    if (before_id <= 0)
+    {
+        before_ts = (time_t)INT64_MAX;
+        before_id = INT_MAX;
+    }
+
+    sqlite3_stmt *stmt;
+    int param = 1;
+
+    if (host_name)
+    {
+        stmt = cached_statement(STMT_SELECT_HOST_UPLOADS_AFTER,
+                                "SELECT " UPLOAD_COLUMNS " FROM uploads "
+                                "WHERE host_name = ? AND (timestamp, id) < (?, ?) "
+                                "ORDER BY timestamp DESC, id DESC LIMIT ?;");
+        if (!stmt)
+        {
+            return NULL;
+        }
+        sqlite3_bind_text(stmt, param++, host_name, -1, SQLITE_STATIC);
+    }
+    else
+    {
+        stmt = cached_statement(STMT_SELECT_UPLOADS_AFTER,
+                                "SELECT " UPLOAD_COLUMNS " FROM uploads "
+                                "WHERE (timestamp, id) < (?, ?) "
+                                "ORDER BY timestamp DESC, id DESC LIMIT ?;");
+        if (!stmt)
+        {
+            return NULL;
+        }
+    }
+
+    sqlite3_bind_int64(stmt, param++, before_ts);
+    sqlite3_bind_int(stmt, param++, before_id);
+    sqlite3_bind_int(stmt, param, limit);
+
+    return collect_records(stmt, count);
+}
+
+/* Probes the primary key; a missing upload is not an error and leaves *record NULL */
+static bool
+lookup_upload(int id, upload_record_t **record)
+{
+    *record = NULL;
+
+    sqlite3_stmt *stmt =
+      cached_statement(STMT_SELECT_UPLOAD, "SELECT " UPLOAD_COLUMNS " FROM uploads WHERE id = ?;");
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    bool ok = true;
+    int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW)
+    {
+        *record = read_record(stmt);
+        ok = *record != NULL;
+    }
+    else if (result != SQLITE_DONE)
+    {
+        log_error("Error looking up upload %d: %s", id, sqlite3_errmsg(db));
+        ok = false;
+    }
+
+    release_statement(stmt);
+    return ok;
+}
+
+upload_record_t *
+db_get_upload_by_id(int id)
+{
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    upload_record_t *record = NULL;
+    lookup_upload(id, &record);
+    return record;
+}
+
+/* Records are returned in the order of ids, skipping the ones that do not exist. The probes
+ * share one read transaction, so they see a single snapshot of the history. */
+upload_record_t **
+db_get_uploads_by_ids(const int *ids, int id_count, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    upload_record_t **records = calloc(id_count > 0 ? id_count : 1, sizeof(upload_record_t *));
+    if (!records)
+    {
+        log_error("Failed to allocate memory for upload records");
+        return NULL;
+    }
+
+    bool own_transaction =
+      sqlite3_get_autocommit(db) && sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+
+    bool ok = true;
+    for (int i = 0; ok && i < id_count; i++)
+    {
+        upload_record_t *record = NULL;
+        ok = lookup_upload(ids[i], &record);
+        if (record)
         {
-            free(records[i]->host_name);
-            free(records[i]->local_path);
-            free(records[i]->remote_url);
-            if (records[i]->deletion_url)
-                free(records[i]->deletion_url);
-            free(records[i]->filename);
-            free(records[i]);
+            records[(*count)++] = record;
         }
-        free(records);
+    }
+
+    if (own_transaction)
+    {
+        sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    }
+
+    if (!ok)
+    {
+        db_free_records(records, *count);
+        *count = 0;
         return NULL;
     }
 
     return records;
 }
 
+void
+db_free_record(upload_record_t *record)
+{
+    if (!record)
+    {
+        return;
+    }
+
+    free(record->host_name);
+    free(record->local_path);
+    free(record->remote_url);
+    free(record->deletion_url);
+    free(record->filename);
+    free(record->content_hash);
+    free(record);
+}
+
 void
 db_free_records(upload_record_t **records, int count)
 {
@@ -381,29 +1001,70 @@ db_free_records(upload_record_t **records, int count)
 
     for (int i = 0; i < count; i++)
     {
-        if (records[i])
+        db_free_record(records[i]);
+    }
+
+    free(records);
+}
+
+upload_record_t *
+db_find_upload_by_hash(const char *host_name, const char *content_hash)
+{
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    if (!host_name || !content_hash || content_hash[0] == '\0')
+    {
+        return NULL;
+    }
+
+    sqlite3_stmt *stmt = cached_statement(STMT_FIND_BY_HASH,
+                                          "SELECT " UPLOAD_COLUMNS " FROM uploads "
+                                          "WHERE content_hash = ? AND host_name = ? "
+                                          "ORDER BY timestamp DESC LIMIT 1;");
+    if (!stmt)
+    {
+        return NULL;
+    }
+
+    sqlite3_bind_text(stmt, 1, content_hash, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+
+    upload_record_t *record = NULL;
+    int result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW)
+    {
+        record = read_record(stmt);
+        if (record)
         {
-            free(records[i]->host_name);
-            free(records[i]->local_path);
-            free(records[i]->remote_url);
-            free(records[i]->deletion_url);
-            free(records[i]->filename);
-            free(records[i]);
+            record->content_hash = strdup(content_hash);
         }
     }
+    else if (result != SQLITE_DONE)
+    {
+        log_error("Error looking up upload by hash: %s", sqlite3_errmsg(db));
+    }
 
-    free(records);
+    release_statement(stmt);
+
+    return record;
 }
 
 bool
-db_delete_upload(int id)
+db_get_host_stats(host_upload_stats_t **stats_out, int *count)
 {
+    *stats_out = NULL;
+    *count = 0;
+
     if (!db && !db_init())
     {
         return false;
     }
 
-    const char *sql = "DELETE FROM uploads WHERE id = ?;";
+    const char *sql = "SELECT host_name, COUNT(*), SUM(size), MAX(timestamp) "
+                      "FROM uploads GROUP BY host_name ORDER BY COUNT(*) DESC, host_name;";
 
     sqlite3_stmt *stmt;
     int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
@@ -413,33 +1074,894 @@ db_delete_upload(int id)
         return false;
     }
 
-    sqlite3_bind_int(stmt, 1, id);
+    host_upload_stats_t *stats = NULL;
+    int capacity = 0;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            host_upload_stats_t *new_stats = realloc(stats, capacity * sizeof(*stats));
+            if (!new_stats)
+            {
+                log_error("Failed to allocate memory for host statistics");
+                result = SQLITE_NOMEM;
+                break;
+            }
+            stats = new_stats;
+        }
+
+        host_upload_stats_t *entry = &stats[*count];
+        entry->host_name = strdup((const char *)sqlite3_column_text(stmt, 0));
+        entry->upload_count = sqlite3_column_int(stmt, 1);
+        entry->total_bytes = sqlite3_column_int64(stmt, 2);
+        entry->last_upload = sqlite3_column_int64(stmt, 3);
+        (*count)++;
+    }
 
-    result = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
     if (result != SQLITE_DONE)
     {
-        log_error("Failed to delete upload: %s", sqlite3_errmsg(db));
+        if (result != SQLITE_NOMEM)
+        {
+            log_error("Error retrieving host statistics: %s", sqlite3_errmsg(db));
+        }
+        db_free_host_stats(stats, *count);
+        *count = 0;
         return false;
     }
 
-    int changes = sqlite3_changes(db);
-    if (changes == 0)
+    *stats_out = stats;
+    return true;
+}
+
+void
+db_free_host_stats(host_upload_stats_t *stats, int count)
+{
+    if (!stats)
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
     {
-        log_warn("No upload record found with ID: %d", id);
-        return false;
+        free(stats[i].host_name);
     }
 
-    log_info("Deleted upload record with ID: %d", id);
-    return true;
+    free(stats);
 }
 
-void
-db_close(void)
+static long long *
+get_samples(const char *host_name, const char *column, int *count)
 {
-    if (db)
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    /* Only rows recorded with timing data; column comes from a fixed list */
+    char sql[256];
+    snprintf(sql,
+             sizeof(sql),
+             "SELECT %s FROM uploads WHERE time_total_us IS NOT NULL%s ORDER BY %s;",
+             column,
+             host_name ? " AND host_name = ?" : "",
+             column);
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    if (host_name)
+    {
+        sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    }
+
+    long long *samples = NULL;
+    int capacity = 0;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            long long *new_samples = realloc(samples, capacity * sizeof(*samples));
+            if (!new_samples)
+            {
+                log_error("Failed to allocate memory for timing samples");
+                result = SQLITE_NOMEM;
+                break;
+            }
+            samples = new_samples;
+        }
+
+        samples[(*count)++] = sqlite3_column_int64(stmt, 0);
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        if (result != SQLITE_NOMEM)
+        {
+            log_error("Error retrieving timing samples: %s", sqlite3_errmsg(db));
+        }
+        free(samples);
+        *count = 0;
+        return NULL;
+    }
+
+    return samples;
+}
+
+long long *
+db_get_timing_samples(const char *host_name, timing_phase_t phase, int *count)
+{
+    if (phase < 0 || phase >= TIMING_PHASE_COUNT)
+    {
+        *count = 0;
+        return NULL;
+    }
+
+    return get_samples(host_name, timing_columns[phase], count);
+}
+
+long long *
+db_get_speed_samples(const char *host_name, int *count)
+{
+    return get_samples(host_name, "upload_speed", count);
+}
+
+/* All the uploads are deleted in one transaction, or none are */
+bool
+db_delete_uploads(const int *ids, int count)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    bool own_transaction = sqlite3_get_autocommit(db);
+    if (own_transaction && sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to begin deleting uploads: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; ok && i < count; i++)
+    {
+        sqlite3_stmt *stmt =
+          cached_statement(STMT_DELETE_UPLOAD, "DELETE FROM uploads WHERE id = ?;");
+        if (!stmt)
+        {
+            ok = false;
+            break;
+        }
+
+        sqlite3_bind_int(stmt, 1, ids[i]);
+        int result = sqlite3_step(stmt);
+        release_statement(stmt);
+
+        if (result != SQLITE_DONE)
+        {
+            log_error("Failed to delete upload %d: %s", ids[i], sqlite3_errmsg(db));
+            ok = false;
+        }
+        else if (sqlite3_changes(db) == 0)
+        {
+            log_warn("No upload record found with ID: %d", ids[i]);
+        }
+    }
+
+    if (own_transaction)
     {
+        if (ok && sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log_error("Failed to commit deleted uploads: %s", sqlite3_errmsg(db));
+            ok = false;
+        }
+        if (!ok)
+        {
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        }
+    }
+
+    if (ok)
+    {
+        log_info("Deleted %d upload record(s)", count);
+    }
+    return ok;
+}
+
+bool
+db_queue_add(const char *local_path,
+             const char *host_name,
+             size_t size,
+             time_t next_attempt,
+             const char *error)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    /* Queueing a file again counts as another failed attempt */
+    const char *sql = "INSERT INTO queue (local_path, host_name, size, next_attempt, last_error, "
+                      "queued_at) VALUES (?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(local_path, host_name) DO UPDATE SET "
+                      "size = excluded.size, attempts = attempts + 1, "
+                      "next_attempt = excluded.next_attempt, last_error = excluded.last_error;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_QUEUE_ADD, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, size);
+    sqlite3_bind_int64(stmt, 4, next_attempt);
+    sqlite3_bind_text(stmt, 5, error, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 6, time(NULL));
+
+    int result = write_step(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to queue upload: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    log_info("Queued upload of %s to %s", local_path, host_name);
+    return true;
+}
+
+queue_entry_t *
+db_queue_get(bool due_only, time_t now, int *count)
+{
+    *count = 0;
+
+    if (!db && !db_init())
+    {
+        return NULL;
+    }
+
+    /* Grouped by host so each host's entries can be drained as one concurrent batch */
+    const char *sql = due_only ? "SELECT id, local_path, host_name, size, attempts, next_attempt, "
+                                 "last_error FROM queue WHERE next_attempt <= ? "
+                                 "ORDER BY host_name, next_attempt, id;"
+                               : "SELECT id, local_path, host_name, size, attempts, next_attempt, "
+                                 "last_error FROM queue ORDER BY host_name, next_attempt, id;";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    if (due_only)
+    {
+        sqlite3_bind_int64(stmt, 1, now);
+    }
+
+    queue_entry_t *entries = NULL;
+    int capacity = 0;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            queue_entry_t *new_entries = realloc(entries, capacity * sizeof(*entries));
+            if (!new_entries)
+            {
+                log_error("Failed to allocate memory for queued uploads");
+                result = SQLITE_NOMEM;
+                break;
+            }
+            entries = new_entries;
+        }
+
+        const unsigned char *error_text = sqlite3_column_text(stmt, 6);
+
+        queue_entry_t *entry = &entries[*count];
+        entry->id = sqlite3_column_int(stmt, 0);
+        entry->local_path = strdup((const char *)sqlite3_column_text(stmt, 1));
+        entry->host_name = strdup((const char *)sqlite3_column_text(stmt, 2));
+        entry->size = sqlite3_column_int64(stmt, 3);
+        entry->attempts = sqlite3_column_int(stmt, 4);
+        entry->next_attempt = sqlite3_column_int64(stmt, 5);
+        entry->last_error = error_text ? strdup((const char *)error_text) : NULL;
+        (*count)++;
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        if (result != SQLITE_NOMEM)
+        {
+            log_error("Error retrieving queued uploads: %s", sqlite3_errmsg(db));
+        }
+        db_free_queue_entries(entries, *count);
+        *count = 0;
+        return NULL;
+    }
+
+    return entries;
+}
+
+bool
+db_queue_defer(int id, time_t next_attempt, const char *error)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "UPDATE queue SET attempts = attempts + 1, next_attempt = ?, last_error = ? "
+                      "WHERE id = ?;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_QUEUE_DEFER, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, next_attempt);
+    sqlite3_bind_text(stmt, 2, error, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, id);
+
+    int result = write_step(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to reschedule queued upload: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_queue_remove(int id)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "DELETE FROM queue WHERE id = ?;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_QUEUE_REMOVE, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, id);
+
+    int result = write_step(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to remove queued upload: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+void
+db_free_queue_entries(queue_entry_t *entries, int count)
+{
+    if (!entries)
+    {
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        free(entries[i].local_path);
+        free(entries[i].host_name);
+        free(entries[i].last_error);
+    }
+
+    free(entries);
+}
+
+bool
+db_journal_begin(const char *host_name, int *batch_id)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "INSERT INTO batches (host_name, created_at) VALUES (?, ?);";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, host_name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, time(NULL));
+
+    result = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to create batch journal: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    journal_batch_id = (int)sqlite3_last_insert_rowid(db);
+    *batch_id = journal_batch_id;
+    log_info("Journaling batch %d", journal_batch_id);
+    return true;
+}
+
+bool
+db_journal_resume(int batch_id, char **host_name)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "SELECT host_name FROM batches WHERE id = ?;";
+
+    sqlite3_stmt *stmt;
+    int result = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (result != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, batch_id);
+
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found)
+    {
+        *host_name = strdup((const char *)sqlite3_column_text(stmt, 0));
+        journal_batch_id = batch_id;
+        log_info("Resuming batch %d", batch_id);
+    }
+    sqlite3_finalize(stmt);
+
+    return found && *host_name;
+}
+
+bool
+db_journal_add(const char *local_path)
+{
+    if (!db || journal_batch_id == 0)
+    {
+        return false;
+    }
+
+    /* A path already in the journal keeps its state */
+    const char *sql = "INSERT OR IGNORE INTO batch_files (batch_id, local_path, state, updated_at) "
+                      "VALUES (?, ?, 'pending', ?);";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_JOURNAL_ADD, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, journal_batch_id);
+    sqlite3_bind_text(stmt, 2, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, time(NULL));
+
+    if (write_step(stmt) != SQLITE_DONE)
+    {
+        log_error("Failed to update batch journal: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_journal_set(const char *local_path,
+               journal_state_t state,
+               const char *remote_url,
+               const char *error)
+{
+    if (!db || journal_batch_id == 0)
+    {
+        return false;
+    }
+
+    const char *sql = "INSERT INTO batch_files (batch_id, local_path, state, remote_url, error, "
+                      "updated_at) VALUES (?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(batch_id, local_path) DO UPDATE SET "
+                      "state = excluded.state, remote_url = excluded.remote_url, "
+                      "error = excluded.error, updated_at = excluded.updated_at;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_JOURNAL_SET, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, journal_batch_id);
+    sqlite3_bind_text(stmt, 2, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, journal_state_names[state], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, remote_url, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, error, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 6, time(NULL));
+
+    if (write_step(stmt) != SQLITE_DONE)
+    {
+        log_error("Failed to update batch journal: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_journal_lookup(const char *local_path, journal_state_t *state, char **remote_url)
+{
+    if (!db || journal_batch_id == 0)
+    {
+        return false;
+    }
+
+    const char *sql = "SELECT state, remote_url FROM batch_files "
+                      "WHERE batch_id = ? AND local_path = ?;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_JOURNAL_LOOKUP, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(stmt, 1, journal_batch_id);
+    sqlite3_bind_text(stmt, 2, local_path, -1, SQLITE_STATIC);
+
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found)
+    {
+        const char *name = (const char *)sqlite3_column_text(stmt, 0);
+        const unsigned char *url = sqlite3_column_text(stmt, 1);
+
+        *state = JOURNAL_PENDING;
+        for (int i = 0; i <= JOURNAL_FAILED; i++)
+        {
+            if (name && strcmp(name, journal_state_names[i]) == 0)
+            {
+                *state = (journal_state_t)i;
+            }
+        }
+        *remote_url = url ? strdup((const char *)url) : NULL;
+    }
+    release_statement(stmt);
+
+    return found;
+}
+
+char **
+db_journal_get_unfinished(int *count)
+{
+    *count = 0;
+
+    if (!db || journal_batch_id == 0)
+    {
+        return NULL;
+    }
+
+    const char *sql = "SELECT local_path FROM batch_files "
+                      "WHERE batch_id = ? AND state != 'done' ORDER BY rowid;";
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+
+    sqlite3_bind_int(stmt, 1, journal_batch_id);
+
+    char **paths = NULL;
+    int capacity = 0;
+    int result;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            char **new_paths = realloc(paths, capacity * sizeof(char *));
+            if (!new_paths)
+            {
+                log_error("Failed to allocate memory for journaled files");
+                result = SQLITE_NOMEM;
+                break;
+            }
+            paths = new_paths;
+        }
+
+        char *path = strdup((const char *)sqlite3_column_text(stmt, 0));
+        if (!path)
+        {
+            result = SQLITE_NOMEM;
+            break;
+        }
+        paths[(*count)++] = path;
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        for (int i = 0; i < *count; i++)
+        {
+            free(paths[i]);
+        }
+        free(paths);
+        *count = 0;
+        return NULL;
+    }
+
+    return paths;
+}
+
+bool
+db_batch_begin(void)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    batch_writes = true;
+    return true;
+}
+
+bool
+db_batch_sync(void)
+{
+    if (!db)
+    {
+        return true;
+    }
+
+    flush_deferred_writes(false);
+    if (sqlite3_get_autocommit(db))
+    {
+        return deferred_count == 0;
+    }
+
+    batch_uncommitted = 0;
+    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log_error("Failed to commit batched writes: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+/* Called while a batch waits on the network, so an idle batch does not keep the write lock */
+void
+db_batch_tick(void)
+{
+    if (!db)
+    {
+        return;
+    }
+
+    if (deferred_count > 0)
+    {
+        flush_deferred_writes(false);
+    }
+    else if (!sqlite3_get_autocommit(db) && monotonic_ms() - batch_opened_ms >= DB_BATCH_COMMIT_MS)
+    {
+        db_batch_sync();
+    }
+}
+
+bool
+db_batch_end(void)
+{
+    bool ok = !db || flush_deferred_writes(true);
+    ok = db_batch_sync() && ok;
+    batch_writes = false;
+    return ok;
+}
+
+/* A batch that finished cleanly has nothing left to resume, so its journal is discarded */
+bool
+db_journal_end(bool discard)
+{
+    if (!db || journal_batch_id == 0)
+    {
+        return true;
+    }
+
+    /* Deferred journal writes replayed after the discard would bring the journal back */
+    bool ok = flush_deferred_writes(true);
+    ok = db_batch_sync() && ok;
+    if (discard)
+    {
+        char sql[128];
+        snprintf(sql,
+                 sizeof(sql),
+                 "DELETE FROM batch_files WHERE batch_id = %d;"
+                 "DELETE FROM batches WHERE id = %d;",
+                 journal_batch_id,
+                 journal_batch_id);
+        if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log_warn("Failed to remove batch journal: %s", sqlite3_errmsg(db));
+            ok = false;
+        }
+    }
+
+    journal_batch_id = 0;
+    return ok;
+}
+
+/* A file that changed since its upload was created cannot be resumed, so the row is dropped */
+bool
+db_tus_find(const char *local_path,
+            const char *host_name,
+            long long size,
+            long long mtime,
+            char **upload_url,
+            long long *offset)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "SELECT size, mtime, upload_url, offset FROM tus_uploads "
+                      "WHERE local_path = ? AND host_name = ?;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_TUS_FIND, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+
+    bool found = false;
+    bool stale = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char *url = sqlite3_column_text(stmt, 2);
+        stale = !url || sqlite3_column_int64(stmt, 0) != size ||
+                sqlite3_column_int64(stmt, 1) != mtime;
+        if (!stale)
+        {
+            *upload_url = strdup((const char *)url);
+            *offset = sqlite3_column_int64(stmt, 3);
+            found = *upload_url != NULL;
+        }
+    }
+    release_statement(stmt);
+
+    if (stale)
+    {
+        log_info("Discarding tus upload of %s: file changed since it was created", local_path);
+        db_tus_remove(local_path, host_name);
+    }
+
+    return found;
+}
+
+bool
+db_tus_save(const char *local_path,
+            const char *host_name,
+            long long size,
+            long long mtime,
+            const char *upload_url,
+            long long offset)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "INSERT INTO tus_uploads (local_path, host_name, size, mtime, upload_url, "
+                      "offset, updated_at) VALUES (?, ?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(local_path, host_name) DO UPDATE SET "
+                      "size = excluded.size, mtime = excluded.mtime, "
+                      "upload_url = excluded.upload_url, offset = excluded.offset, "
+                      "updated_at = excluded.updated_at;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_TUS_SAVE, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, size);
+    sqlite3_bind_int64(stmt, 4, mtime);
+    sqlite3_bind_text(stmt, 5, upload_url, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 6, offset);
+    sqlite3_bind_int64(stmt, 7, time(NULL));
+
+    int result = write_step(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to save tus upload state: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+db_tus_remove(const char *local_path, const char *host_name)
+{
+    if (!db && !db_init())
+    {
+        return false;
+    }
+
+    const char *sql = "DELETE FROM tus_uploads WHERE local_path = ? AND host_name = ?;";
+
+    sqlite3_stmt *stmt = cached_statement(STMT_TUS_REMOVE, sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, local_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, host_name, -1, SQLITE_STATIC);
+
+    int result = write_step(stmt);
+
+    if (result != SQLITE_DONE)
+    {
+        log_error("Failed to remove tus upload state: %s", sqlite3_errmsg(db));
+        return false;
+    }
+
+    return true;
+}
+
+void
+db_close(void)
+{
+    db_journal_end(false);
+    db_batch_end();
+    if (db)
+    {
+        for (int i = 0; i < STMT_COUNT; i++)
+        {
+            sqlite3_finalize(statements[i]);
+            statements[i] = NULL;
+        }
         sqlite3_close(db);
         db = NULL;
     }
@@ -0,0 +1,128 @@
+#!/bin/bash
+# Compares the CPU time hostman spends per GiB uploaded with upload_source "read" (pread) and
+# "mmap", for the multipart and binary body formats, against a local HTTP sink.
+#
+# Usage: tests/bench_upload_source.sh [hostman binary] [size in MiB] [runs]
+#
+# Needs python3 for the sink. Each variant is run `runs` times and the user and system CPU time
+# of the hostman process is averaged and scaled to one GiB.
+set -e
+
+HOSTMAN=${1:-build/hostman}
+SIZE_MIB=${2:-1024}
+RUNS=${3:-3}
+
+if [ ! -x "$HOSTMAN" ]; then
+  echo "hostman binary not found: $HOSTMAN" >&2
+  exit 1
+fi
+HOSTMAN=$(cd "$(dirname "$HOSTMAN")" && pwd)/$(basename "$HOSTMAN")
+
+WORK=$(mktemp -d)
+SINK_PID=
+cleanup() {
+  if [ -n "$SINK_PID" ]; then
+    kill "$SINK_PID" 2>/dev/null || true
+  fi
+  rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# Reads and discards each request body, answering with a unique URL
+cat > "$WORK/sink.py" <<'EOF'
+import http.server, itertools, json, socket, sys
+
+counter = itertools.count()
+
+class Sink(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        remaining = int(self.headers.get("Content-Length", 0))
+        while remaining > 0:
+            chunk = self.rfile.read(min(remaining, 1 << 20))
+            if not chunk:
+                break
+            remaining -= len(chunk)
+        body = json.dumps({"url": "http://sink.invalid/%d" % next(counter)}).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_PUT = do_POST
+
+    def log_message(self, *args):
+        pass
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Sink)
+with open(sys.argv[1], "w") as port_file:
+    port_file.write(str(server.server_address[1]))
+server.serve_forever()
+EOF
+
+python3 "$WORK/sink.py" "$WORK/port" &
+SINK_PID=$!
+for _ in $(seq 50); do
+  [ -s "$WORK/port" ] && break
+  sleep 0.1
+done
+PORT=$(cat "$WORK/port")
+
+export HOME="$WORK/home"
+export XDG_CONFIG_HOME="$HOME/.config"
+export XDG_CACHE_HOME="$HOME/.cache"
+export HOSTMAN_NO_DAEMON=1
+mkdir -p "$XDG_CONFIG_HOME/hostman"
+
+host() {
+  local format=$1 source=$2
+  printf '"%s-%s": {"api_endpoint": "http://127.0.0.1:%s/upload", "auth_type": "none",
+    "request_body_format": "%s", "request_method": "%s", "file_form_field": "file",
+    "response_url_json_path": "url", "upload_source": "%s"}' \
+    "$format" "$source" "$PORT" "$format" "$([ "$format" = binary ] && echo PUT || echo POST)" \
+    "$source"
+}
+
+cat > "$XDG_CONFIG_HOME/hostman/config.json" <<EOF
+{
+  "default_host": "multipart-read",
+  "log_level": "ERROR",
+  "hosts": {
+    $(host multipart read),
+    $(host multipart mmap),
+    $(host binary read),
+    $(host binary mmap)
+  }
+}
+EOF
+
+echo "Creating a ${SIZE_MIB} MiB test file"
+head -c "$((SIZE_MIB * 1024 * 1024))" /dev/urandom > "$WORK/payload.bin"
+
+# Warm the page cache so every variant reads from memory
+cat "$WORK/payload.bin" > /dev/null
+
+printf '%-18s %10s %10s %12s\n' "variant" "user s" "sys s" "cpu s/GiB"
+for format in multipart binary; do
+  for source in read mmap; do
+    user_total=0
+    sys_total=0
+    for _ in $(seq "$RUNS"); do
+      TIMEFORMAT='%U %S'
+      read -r user sys < <({ time { "$HOSTMAN" upload --quiet --no-clipboard \
+        --host "$format-$source" "$WORK/payload.bin" > /dev/null 2>&1 ||
+        touch "$WORK/failed"; }; } 2>&1)
+      if [ -e "$WORK/failed" ]; then
+        echo "Upload with $format-$source failed" >&2
+        exit 1
+      fi
+      user_total=$(awk -v a="$user_total" -v b="$user" 'BEGIN { print a + b }')
+      sys_total=$(awk -v a="$sys_total" -v b="$sys" 'BEGIN { print a + b }')
+    done
+    awk -v name="$format-$source" -v u="$user_total" -v s="$sys_total" -v n="$RUNS" \
+      -v mib="$SIZE_MIB" \
+      'BEGIN { printf "%-18s %10.3f %10.3f %12.3f\n", name, u / n, s / n, (u + s) / n * 1024 / mib }'
+  done
+done
@@ -0,0 +1,167 @@
+/* Starts several processes writing to one history database at once, half of them grouping
+ * their writes the way a batch upload does, and fails if any insert is lost.
+ *
+ * Usage: db_stress [writers] [rows per writer] */
+
+#include "hostman/core/logging.h"
+#include "hostman/storage/database.h"
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_WRITERS 8
+#define DEFAULT_ROWS 200
+
+static int
+run_writer(int writer, int rows)
+{
+    if (!db_init())
+    {
+        fprintf(stderr, "writer %d: failed to open the history database\n", writer);
+        return EXIT_FAILURE;
+    }
+
+    bool batched = writer % 2 == 0;
+    if (batched)
+    {
+        db_batch_begin();
+    }
+
+    int failed = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        char local_path[64];
+        char remote_url[96];
+        snprintf(local_path, sizeof(local_path), "/stress/%d/%d.bin", writer, i);
+        snprintf(remote_url, sizeof(remote_url), "https://stress.invalid/%d/%d", writer, i);
+
+        if (!db_add_upload(
+              "stress", local_path, remote_url, NULL, "file.bin", (size_t)i, NULL, NULL))
+        {
+            failed++;
+        }
+        if (batched)
+        {
+            db_batch_tick();
+        }
+    }
+
+    if (batched && !db_batch_end())
+    {
+        failed++;
+    }
+    db_close();
+
+    if (failed > 0)
+    {
+        fprintf(stderr, "writer %d: %d writes failed\n", writer, failed);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static long long
+count_rows(const char *path)
+{
+    const char *sql = "SELECT COUNT(*) FROM uploads WHERE host_name = 'stress';";
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    long long count = -1;
+
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            count = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    return count;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int writers = argc > 1 ? atoi(argv[1]) : DEFAULT_WRITERS;
+    int rows = argc > 2 ? atoi(argv[2]) : DEFAULT_ROWS;
+    if (writers <= 0 || rows <= 0)
+    {
+        fprintf(stderr, "Usage: %s [writers] [rows per writer]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char cache_dir[] = "/tmp/hostman-stress-XXXXXX";
+    if (!mkdtemp(cache_dir))
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    setenv("XDG_CACHE_HOME", cache_dir, 1);
+    setenv("XDG_CONFIG_HOME", cache_dir, 1);
+
+    logging_init();
+
+    /* Create the schema once so the writers only race on inserts */
+    if (!db_init())
+    {
+        fprintf(stderr, "Failed to create the history database\n");
+        return EXIT_FAILURE;
+    }
+    db_close();
+    fflush(NULL);
+
+    for (int writer = 0; writer < writers; writer++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0)
+        {
+            _exit(run_writer(writer, rows));
+        }
+    }
+
+    int failed_writers = 0;
+    int status;
+    while (wait(&status) > 0)
+    {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            failed_writers++;
+        }
+    }
+
+    char db_path[sizeof(cache_dir) + 32];
+    snprintf(db_path, sizeof(db_path), "%s/hostman/history.db", cache_dir);
+    long long expected = (long long)writers * rows;
+    long long found = count_rows(db_path);
+
+    printf("%d writers x %d rows: expected %lld, found %lld, lost %lld\n",
+           writers,
+           rows,
+           expected,
+           found,
+           expected - found);
+
+    if (found == expected && failed_writers == 0)
+    {
+        char command[sizeof(cache_dir) + 16];
+        snprintf(command, sizeof(command), "rm -rf %s", cache_dir);
+        if (system(command) != 0)
+        {
+            fprintf(stderr, "Failed to remove %s\n", cache_dir);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    fprintf(stderr, "Database kept for inspection: %s\n", db_path);
+    return EXIT_FAILURE;
+}
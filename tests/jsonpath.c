@@ -0,0 +1,218 @@
+/* Checks that the JSON path scanner finds the same string values as a cJSON walk of the same
+ * path, the way response fields were looked up before the scanner, for escaped strings, nested
+ * arrays and missing keys. Each document is checked one path at a time and with all of its paths
+ * in a single scan.
+ *
+ * Usage: jsonpath */
+
+#include "hostman/core/jsonpath.h"
+#include <cJSON.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CASE_PATHS 12
+
+typedef struct
+{
+    const char *name;
+    const char *json;
+    const char *paths[MAX_CASE_PATHS];
+} path_case_t;
+
+static const path_case_t path_cases[] = {
+    { "escaped strings",
+      "{\"quote\": \"say \\\"hi\\\"\", \"slashes\": \"a\\\\b\\/c\", "
+      "\"controls\": \"tab\\there\\nnew\\r\\b\\f\", \"latin\": \"caf\\u00e9\", "
+      "\"cjk\": \"\\u65e5\\u672c\", \"emoji\": \"\\ud83d\\ude00!\", \"plain\": \"caf\xc3\xa9\", "
+      "\"esc\\u0061ped key\": \"found\", \"url\": \"https:\\/\\/x.invalid\\/a?b=1&c=\\\"2\\\"\"}",
+      { "quote",
+        "slashes",
+        "controls",
+        "latin",
+        "cjk",
+        "emoji",
+        "plain",
+        "escaped key",
+        "url" } },
+    { "nested arrays",
+      "{\"data\": {\"files\": [{\"url\": \"https://a.invalid/0\"}, [\"skip\"], "
+      "{\"url\": \"https://a.invalid/2\", \"extra\": [[1, 2], [\"x\", [\"deep\"]]]}]}, "
+      "\"grid\": [[\"a0\", \"a1\"], [\"b0\", [\"b1-0\", \"b1-1\"]]], \"empty\": []}",
+      { "data.files[0].url",
+        "data.files[1][0]",
+        "data.files[2].url",
+        "data.files[2].extra[1][1][0]",
+        "data.files[2].extra[0][1]",
+        "data.files[3].url",
+        "grid[0][1]",
+        "grid[1][1][1]",
+        "grid[1][2]",
+        "empty[0]",
+        "data.files.url" } },
+    { "missing keys",
+      "{\"data\": {\"link\": \"https://i.invalid/x\", \"count\": 3, \"ok\": true, "
+      "\"none\": null, \"obj\": {\"url\": \"inner\"}, \"list\": [\"v\"]}}",
+      { "data.missing",
+        "missing.link",
+        "data.link.more",
+        "data.count",
+        "data.ok",
+        "data.none",
+        "data.obj",
+        "data.list",
+        "data.list[0]",
+        "data.obj.url",
+        "data[0]" } },
+    { "key matching",
+      "{\"Link\": \"first\", \"link\": \"second\", \"DATA\": {\"Url\": \"upper\"}, "
+      "\"link2\": \"other\", \"lin\": \"short\"}",
+      { "link", "LINK", "data.url", "lin", "link2", "lin2" } },
+    { "top-level array",
+      "[{\"url\": \"zero\"}, \"one\", [\"two-0\"]]",
+      { "[0].url", "[1]", "[2][0]", "[3]", "url" } },
+};
+
+/* The lookup response fields used before the scanner: cJSON_GetObjectItem per key and
+ * cJSON_GetArrayItem per index, and only a string at the end counts */
+static char *
+cjson_lookup(const char *json, const char *path)
+{
+    cJSON *root = cJSON_Parse(json);
+    if (!root)
+    {
+        return NULL;
+    }
+
+    cJSON *current = root;
+    const char *p = path;
+
+    while (*p != '\0' && current)
+    {
+        if (*p == '.')
+        {
+            p++;
+            continue;
+        }
+
+        if (*p != '[')
+        {
+            const char *key_start = p;
+            while (*p != '\0' && *p != '.' && *p != '[')
+            {
+                p++;
+            }
+
+            char key[JSON_PATH_MAX_LENGTH];
+            size_t key_len = (size_t)(p - key_start);
+            memcpy(key, key_start, key_len);
+            key[key_len] = '\0';
+            current = cJSON_GetObjectItem(current, key);
+            continue;
+        }
+
+        p++;
+        int index = 0;
+        while (isdigit((unsigned char)*p))
+        {
+            index = index * 10 + (*p - '0');
+            p++;
+        }
+        if (*p == ']')
+        {
+            p++;
+        }
+        current = cJSON_IsArray(current) ? cJSON_GetArrayItem(current, index) : NULL;
+    }
+
+    char *result = NULL;
+    if (current && cJSON_IsString(current))
+    {
+        result = strdup(current->valuestring);
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+static int
+check_value(const char *name, const char *path, const char *how, const char *got, char *expected)
+{
+    int failed = (got == NULL) != (expected == NULL) || (got && strcmp(got, expected) != 0);
+    if (failed)
+    {
+        fprintf(stderr,
+                "FAIL %s, %s (%s): expected %s, got %s\n",
+                name,
+                path,
+                how,
+                expected ? expected : "(none)",
+                got ? got : "(none)");
+    }
+    free(expected);
+    return failed;
+}
+
+static int
+check_case(const path_case_t *test, int *checks)
+{
+    json_path_t compiled[MAX_CASE_PATHS];
+    json_path_match_t matches[MAX_CASE_PATHS];
+    size_t length = strlen(test->json);
+    int count = 0;
+    int failed = 0;
+
+    while (count < MAX_CASE_PATHS && test->paths[count])
+    {
+        if (!json_path_compile(&compiled[count], test->paths[count]))
+        {
+            fprintf(stderr, "FAIL %s: cannot compile %s\n", test->name, test->paths[count]);
+            return 1;
+        }
+        matches[count].path = &compiled[count];
+        count++;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        json_path_match_t match = { .path = &compiled[i] };
+        json_path_extract(test->json, length, &match, 1);
+        char *value = json_path_match_dup(&match);
+        failed += check_value(
+          test->name, test->paths[i], "alone", value, cjson_lookup(test->json, test->paths[i]));
+        free(value);
+        (*checks)++;
+    }
+
+    if (!json_path_extract(test->json, length, matches, count))
+    {
+        fprintf(stderr, "FAIL %s: scanning all paths at once failed\n", test->name);
+        return failed + 1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        char *value = json_path_match_dup(&matches[i]);
+        failed += check_value(
+          test->name, test->paths[i], "together", value, cjson_lookup(test->json, test->paths[i]));
+        free(value);
+        (*checks)++;
+    }
+
+    return failed;
+}
+
+int
+main(void)
+{
+    int failed = 0;
+    int checks = 0;
+    size_t case_count = sizeof(path_cases) / sizeof(path_cases[0]);
+
+    for (size_t i = 0; i < case_count; i++)
+    {
+        failed += check_case(&path_cases[i], &checks);
+    }
+
+    printf("%d checks, %d failed\n", checks, failed);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
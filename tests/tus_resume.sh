@@ -0,0 +1,228 @@
+#!/bin/bash
+# Uploads to a local tus stand-in server and checks that an upload is created, that a dropped
+# chunk and an upload left unfinished by an earlier run both continue from the Upload-Offset the
+# server reports to HEAD, and that the finished upload matches the file.
+#
+# Usage: tests/tus_resume.sh [hostman binary]
+#
+# Needs python3 for the server.
+set -e
+
+HOSTMAN=${1:-build/hostman}
+
+if [ ! -x "$HOSTMAN" ]; then
+  echo "hostman binary not found: $HOSTMAN" >&2
+  exit 1
+fi
+
+WORK=$(mktemp -d)
+SERVER_PID=
+stop_server() {
+  if [ -n "$SERVER_PID" ]; then
+    kill "$SERVER_PID" 2>/dev/null || true
+    wait "$SERVER_PID" 2>/dev/null || true
+    SERVER_PID=
+  fi
+  rm -f "$SERVER_DIR/requests.log"
+}
+cleanup() {
+  stop_server
+  rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# Keeps each upload in a file named after its ID, so a restarted server still knows it. With
+# --drop-at it stores a chunk only up to that byte and closes the connection, once; with
+# --reject-at it reads the rest of that chunk without storing it and answers 400, so the client
+# gives up.
+cat > "$WORK/server.py" <<'EOF'
+import argparse, http.server, os
+
+parser = argparse.ArgumentParser()
+parser.add_argument("dir")
+parser.add_argument("--drop-at", type=int)
+parser.add_argument("--reject-at", type=int)
+parser.add_argument("--port", type=int, default=0)
+args = parser.parse_args()
+cut_at = args.drop_at or args.reject_at
+
+def path(upload_id, suffix):
+    return os.path.join(args.dir, upload_id + suffix)
+
+def log(line):
+    with open(os.path.join(args.dir, "requests.log"), "a") as log_file:
+        log_file.write(line + "\n")
+
+class Tus(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def reply(self, code, headers=()):
+        self.send_response(code)
+        self.send_header("Tus-Resumable", "1.0.0")
+        for name, value in headers:
+            self.send_header(name, value)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def upload(self):
+        upload_id = self.path.rsplit("/", 1)[-1]
+        if not upload_id.isdigit() or not os.path.exists(path(upload_id, ".len")):
+            return None, 0, 0
+        with open(path(upload_id, ".len")) as length_file:
+            length = int(length_file.read())
+        return upload_id, os.path.getsize(path(upload_id, ".bin")), length
+
+    def do_POST(self):
+        upload_id = str(len([f for f in os.listdir(args.dir) if f.endswith(".len")]) + 1)
+        with open(path(upload_id, ".len"), "w") as length_file:
+            length_file.write(self.headers["Upload-Length"])
+        open(path(upload_id, ".bin"), "wb").close()
+        log("POST")
+        self.reply(201, [("Location", "/files/" + upload_id)])
+
+    def do_HEAD(self):
+        upload_id, offset, length = self.upload()
+        log("HEAD %d" % offset)
+        if not upload_id:
+            self.reply(404)
+            return
+        self.reply(200, [("Upload-Offset", str(offset)), ("Upload-Length", str(length)),
+                         ("Cache-Control", "no-store")])
+
+    def do_PATCH(self):
+        global cut_at
+        upload_id, offset, length = self.upload()
+        if not upload_id:
+            log("PATCH %s gone" % self.headers["Upload-Offset"])
+            self.reply(404)
+            return
+        if int(self.headers["Upload-Offset"]) != offset:
+            log("PATCH %s conflict" % self.headers["Upload-Offset"])
+            self.reply(409)
+            return
+        log("PATCH %s" % self.headers["Upload-Offset"])
+
+        remaining = int(self.headers["Content-Length"])
+        if cut_at is not None and offset < cut_at < offset + remaining:
+            remaining = cut_at - offset
+            cut = True
+        else:
+            cut = False
+
+        with open(path(upload_id, ".bin"), "ab") as data:
+            while remaining > 0:
+                chunk = self.rfile.read(min(remaining, 1 << 16))
+                if not chunk:
+                    break
+                data.write(chunk)
+                remaining -= len(chunk)
+
+        if cut:
+            cut_at = None
+            log("CUT %d" % os.path.getsize(path(upload_id, ".bin")))
+            if args.reject_at is not None:
+                self.rfile.read(int(self.headers["Content-Length"]) - (args.reject_at - offset))
+                self.reply(400)
+            self.close_connection = True
+            return
+
+        self.reply(204, [("Upload-Offset", str(os.path.getsize(path(upload_id, ".bin"))))])
+
+    def log_message(self, *log_args):
+        pass
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", args.port), Tus)
+with open(os.path.join(args.dir, "port.tmp"), "w") as port_file:
+    port_file.write(str(server.server_address[1]))
+os.rename(os.path.join(args.dir, "port.tmp"), os.path.join(args.dir, "port"))
+server.serve_forever()
+EOF
+
+SERVER_DIR="$WORK/server"
+mkdir -p "$SERVER_DIR"
+
+start_server() {
+  rm -f "$SERVER_DIR/port"
+  python3 "$WORK/server.py" "$SERVER_DIR" "$@" &
+  SERVER_PID=$!
+  for _ in $(seq 50); do
+    [ -s "$SERVER_DIR/port" ] && break
+    sleep 0.1
+  done
+  if [ ! -s "$SERVER_DIR/port" ]; then
+    echo "tus server did not start" >&2
+    exit 1
+  fi
+}
+
+export HOME="$WORK/home"
+export XDG_CONFIG_HOME="$HOME/.config"
+export XDG_CACHE_HOME="$HOME/.cache"
+export HOSTMAN_NO_DAEMON=1
+mkdir -p "$XDG_CONFIG_HOME/hostman"
+
+# The port changes with every server start, so the host is written before each upload
+upload() {
+  cat > "$XDG_CONFIG_HOME/hostman/config.json" <<EOF
+{
+  "default_host": "tus",
+  "log_level": "ERROR",
+  "hosts": {
+    "tus": {"api_endpoint": "http://127.0.0.1:$(cat "$SERVER_DIR/port")/files/",
+      "auth_type": "none", "request_body_format": "tus", "chunk_size": "1M"}
+  }
+}
+EOF
+  "$HOSTMAN" upload --no-clipboard "$1" > "$WORK/upload.out" 2>&1
+}
+
+fail() {
+  echo "FAIL: $1" >&2
+  echo "--- requests ---" >&2
+  cat "$SERVER_DIR/requests.log" >&2 || true
+  echo "--- hostman ---" >&2
+  cat "$WORK/upload.out" >&2 || true
+  exit 1
+}
+
+# curl may send a dropped chunk again on a fresh connection before hostman gets to ask where
+# to continue; the server refuses those with 409, so they are left out
+expect_requests() {
+  local expected
+  expected=$(printf '%s\n' "$@")
+  if [ "$(grep -v ' conflict$' "$SERVER_DIR/requests.log")" != "$expected" ]; then
+    fail "unexpected requests; wanted:"$'\n'"$expected"
+  fi
+}
+
+expect_stored() {
+  cmp -s "$1" "$SERVER_DIR/$2.bin" || fail "upload $2 does not match $1"
+  grep -q "/files/$2" "$WORK/upload.out" || fail "upload $2 was not reported"
+}
+
+# 1 MiB chunks over 2.5 MiB, with the second chunk dropped 300000 bytes in
+head -c 2621440 /dev/urandom > "$WORK/dropped.bin"
+start_server --drop-at 1348576
+upload "$WORK/dropped.bin" || fail "upload with a dropped chunk failed"
+expect_requests "POST" "PATCH 0" "PATCH 1048576" "CUT 1348576" "HEAD 1348576" "PATCH 1348576" \
+  "PATCH 2397152"
+expect_stored "$WORK/dropped.bin" 1
+stop_server
+
+# The first run gives up at byte 1500000; the next run asks the server where to continue
+head -c 2621440 /dev/urandom > "$WORK/unfinished.bin"
+start_server --reject-at 1500000
+if upload "$WORK/unfinished.bin"; then
+  fail "upload rejected by the server succeeded"
+fi
+expect_requests "POST" "PATCH 0" "PATCH 1048576" "CUT 1500000"
+stop_server
+
+# The upload URL hostman recorded names the port, so the server comes back on the same one
+start_server --port "$(cat "$SERVER_DIR/port")"
+upload "$WORK/unfinished.bin" || fail "resumed upload failed"
+expect_requests "HEAD 1500000" "PATCH 1500000" "PATCH 2548576"
+expect_stored "$WORK/unfinished.bin" 2
+stop_server
+
+echo "tus create, resume and finish: ok"